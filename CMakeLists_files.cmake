@@ -27,24 +27,48 @@
 # find opm -name '*.c*' -printf '\t%p\n' | sort
 list (APPEND MAIN_SOURCE_FILES
 	opm/verteq/utility/exc.cpp
+	opm/verteq/utility/instrument.cpp
 	opm/verteq/utility/runlen.cpp
+	opm/verteq/utility/trace.cpp
+	opm/verteq/aquifer.cpp
+	opm/verteq/multigrid.cpp
 	opm/verteq/nav.cpp
 	opm/verteq/opmfwd.cpp
+	opm/verteq/partition.cpp
+	opm/verteq/plume.cpp
 	opm/verteq/props.cpp
+	opm/verteq/restrict.cpp
 	opm/verteq/simulator.cpp
 	opm/verteq/state.cpp
+	opm/verteq/stepping.cpp
 	opm/verteq/topsurf.cpp
+	opm/verteq/transport.cpp
+	opm/verteq/trans.cpp
 	opm/verteq/upscale.cpp
 	opm/verteq/verteq.cpp
+	opm/verteq/view.cpp
 	opm/verteq/wrapper.cpp
 	)
 
 # originally generated with the command:
 # find tests -name '*.cpp' -a ! -wholename '*/not-unit/*' -printf '\t%p\n' | sort
 list (APPEND TEST_SOURCE_FILES
+	tests/test_aquifer.cpp
+	tests/test_multigrid.cpp
 	tests/test_nav.cpp
+	tests/test_partition.cpp
+	tests/test_plume.cpp
+	tests/test_props.cpp
+	tests/test_restrict.cpp
 	tests/test_runlen.cpp
+	tests/test_stepping.cpp
 	tests/test_topsurf.cpp
+	tests/test_trace.cpp
+	tests/test_trans.cpp
+	tests/test_transport.cpp
+	tests/test_upscale.cpp
+	tests/test_verteq.cpp
+	tests/test_view.cpp
 	)
 
 # originally generated with the command:
@@ -55,19 +79,34 @@ list (APPEND TEST_DATA_FILES
 # originally generated with the command:
 # find tutorials examples -name '*.c*' -printf '\t%p\n' | sort
 list (APPEND EXAMPLE_SOURCE_FILES
+	examples/bench/bench_restrict.cpp
+	examples/bench/bench_verteq.cpp
+	examples/bench/gen_aquifer.cpp
 	)
 
 # originally generated with the command:
 # find opm -name '*.h*' -a ! -name '*-pch.hpp' -printf '\t%p\n' | sort
 list (APPEND PUBLIC_HEADER_FILES
 	opm/verteq/utility/exc.hpp
+	opm/verteq/utility/instrument.hpp
 	opm/verteq/utility/runlen.hpp
+	opm/verteq/utility/scratch.hpp
+	opm/verteq/utility/trace.hpp
 	opm/verteq/utility/visibility.h
+	opm/verteq/aquifer.hpp
+	opm/verteq/multigrid.hpp
 	opm/verteq/opmfwd.hpp
+	opm/verteq/partition.hpp
+	opm/verteq/plume.hpp
+	opm/verteq/restrict.hpp
 	opm/verteq/simulator.hpp
 	opm/verteq/state.hpp
+	opm/verteq/stepping.hpp
 	opm/verteq/topsurf.hpp
+	opm/verteq/trans.hpp
+	opm/verteq/transport.hpp
 	opm/verteq/verteq.hpp
+	opm/verteq/view.hpp
 	opm/verteq/visibility.hpp
 	opm/verteq/wrapper.hpp
 	)
@@ -3,6 +3,7 @@
 
 # defines that must be present in config.h for our headers
 set (opm-verteq_CONFIG_VAR
+	HAVE_MPI
 	)
 
 # dependencies
@@ -14,6 +15,8 @@ set (opm-verteq_DEPS
 	# various runtime library enhancements
 	"Boost 1.44.0
 		COMPONENTS date_time filesystem system iostreams unit_test_framework REQUIRED"
+	# partitioning of the top surface among processes
+	"MPI"
 	# OPM dependency
 	"opm-core"
 	)
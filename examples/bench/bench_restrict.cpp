@@ -0,0 +1,139 @@
+/* -*- mode: c++; tab-width: 2; indent-tabs-mode: t; truncate-lines: t -*- */
+/* vim: set filetype=cpp autoindent tabstop=2 shiftwidth=2 noexpandtab softtabstop=2 nowrap: */
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+
+// Compare the sparse restriction operator against the per-column loops
+// in the upscaler. Run with e.g. "bench_restrict ni=200 nj=200 nk=50"
+
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/utility/StopWatch.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/verteq/restrict.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/upscale.hpp>
+
+#include <algorithm> // max
+#include <cmath>     // abs
+#include <cstdlib>   // rand
+#include <iostream>
+#include <memory>    // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace Opm::parameter;
+using namespace std;
+
+// largest difference between two results; they should be equal up to
+// rounding since the same weights are multiplied in the same order
+static double max_diff (const vector <double>& a, const vector <double>& b) {
+	double diff = 0.;
+	for (size_t i = 0; i < a.size (); ++i) {
+		diff = max (diff, abs (a[i] - b[i]));
+	}
+	return diff;
+}
+
+static void report (const char* name, int reps, double loop, double csr,
+                    double diff) {
+	cout << name << ":\t"
+	     << "loop " << loop / reps * 1e3 << " ms, "
+	     << "csr " << csr / reps * 1e3 << " ms, "
+	     << "speedup " << loop / csr << ", "
+	     << "max.diff " << diff << endl;
+}
+
+int main (int argc, char *argv[]) try {
+	ParameterGroup param (argc, argv, false);
+	const int ni = param.getDefault <int> ("ni", 100);
+	const int nj = param.getDefault <int> ("nj", 100);
+	const int nk = param.getDefault <int> ("nk", 20);
+	const int reps = param.getDefault <int> ("repeat", 10);
+
+	// fine grid and top surface
+	UnstructuredGrid* g = create_grid_cart3d (ni, nj, nk);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const VertEqUpscaler up (*ts);
+	const int num_cells = g->number_of_cells;
+	const int num_cols = ts->number_of_cells;
+	cout << "grid: " << ni << "x" << nj << "x" << nk << ", "
+	     << num_cols << " columns" << endl;
+
+	// arbitrary fields to upscale; two values per block to emulate the
+	// saturation of each phase
+	vector <double> fine (num_cells);
+	vector <double> two (2 * num_cells);
+	for (int cell = 0; cell < num_cells; ++cell) {
+		fine[cell] = static_cast <double> (rand ()) / RAND_MAX;
+		two[2 * cell + 0] = fine[cell];
+		two[2 * cell + 1] = 1. - fine[cell];
+	}
+	vector <double> buf (ts->max_vert_res);
+	vector <double> by_loop (num_cols), by_csr (num_cols);
+	vector <double> by_loop2 (2 * num_cols), by_csr2 (2 * num_cols);
+
+	// operators are built once, outside of the timing
+	unique_ptr <Restriction> avg (Restriction::depth_avg (*ts));
+	unique_ptr <Restriction> sum (Restriction::sum (*ts));
+	time::StopWatch clock;
+
+	// depth average, the way upscaled porosity is computed
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		for (int col = 0; col < num_cols; ++col) {
+			up.gather (col, &buf[0], &fine[0], 1, 0);
+			by_loop[col] = up.dpt_avg (col, &buf[0]);
+		}
+	}
+	const double avg_loop = clock.secsSinceStart ();
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		avg->apply (&fine[0], &by_csr[0]);
+	}
+	const double avg_csr = clock.secsSinceStart ();
+	report ("dpt_avg", reps, avg_loop, avg_csr, max_diff (by_loop, by_csr));
+
+	// summing, the way source terms are upscaled
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		for (int col = 0; col < num_cols; ++col) {
+			by_loop[col] = up.sum (col, &fine[0]);
+		}
+	}
+	const double sum_loop = clock.secsSinceStart ();
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		sum->apply (&fine[0], &by_csr[0]);
+	}
+	const double sum_csr = clock.secsSinceStart ();
+	report ("sum", reps, sum_loop, sum_csr, max_diff (by_loop, by_csr));
+
+	// two interleaved fields in one pass
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		for (int col = 0; col < num_cols; ++col) {
+			for (int fld = 0; fld < 2; ++fld) {
+				up.gather (col, &buf[0], &two[0], 2, fld);
+				by_loop2[2 * col + fld] = up.dpt_avg (col, &buf[0]);
+			}
+		}
+	}
+	const double batch_loop = clock.secsSinceStart ();
+	clock.start ();
+	for (int rep = 0; rep < reps; ++rep) {
+		avg->apply_batch (2, &two[0], &by_csr2[0]);
+	}
+	const double batch_csr = clock.secsSinceStart ();
+	report ("batch", reps, batch_loop, batch_csr, max_diff (by_loop2, by_csr2));
+
+	destroy_grid (g);
+	return 0;
+}
+catch (const std::exception &e) {
+	std::cerr << "Program threw an exception: " << e.what() << "\n";
+	throw;
+}
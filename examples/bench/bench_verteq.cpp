@@ -0,0 +1,284 @@
+/* -*- mode: c++; tab-width: 2; indent-tabs-mode: t; truncate-lines: t -*- */
+/* vim: set filetype=cpp autoindent tabstop=2 shiftwidth=2 noexpandtab softtabstop=2 nowrap: */
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+
+// Time the parts of the vertical equilibrium model that are run either
+// for every case or for every timestep, on a synthetic grid. The result
+// is written as JSON, so that runs of different versions can be compared
+// by a script. Run with e.g. "bench_verteq ni=200 nj=200 nk=50 output=x.json";
+// the shape of the aquifer is controlled with the parameters of Aquifer.
+
+#include <opm/core/grid.h>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+#include <opm/core/utility/StopWatch.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/verteq/aquifer.hpp>
+#include <opm/verteq/props.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/upscale.hpp>
+#include <opm/verteq/utility/runlen.hpp>
+
+#include <algorithm> // min, max
+#include <cstdlib>   // rand, srand
+#include <fstream>
+#include <iostream>
+#include <memory>    // unique_ptr
+#include <string>
+#include <vector>
+
+using namespace Opm;
+using namespace Opm::parameter;
+using namespace std;
+
+// uniformly distributed number in [lo, hi)
+static double uniform (double lo, double hi) {
+	return lo + (hi - lo) * (static_cast <double> (rand ()) / RAND_MAX);
+}
+
+/**
+ * Fine-scale properties with the rock of a synthetic aquifer, random
+ * residual saturations in each block, and Corey-type rel.perm. curves.
+ * Brine is the first phase and CO2 the second, as in the decks we use.
+ */
+struct SyntheticProps : public IncompPropertiesInterface {
+	static const int NUM_PHASES = 2;
+	static const int DIMS = 3;
+
+	int num_cells;
+	vector <double> poro;
+	vector <double> perm;
+	vector <double> s_min; // residual saturation, for each phase
+	vector <double> s_max; // 1 - residual saturation of other phase
+	double visc[NUM_PHASES];
+	double dens[NUM_PHASES];
+
+	SyntheticProps (const Aquifer& aq, const UnstructuredGrid& g)
+		: num_cells (g.number_of_cells)
+		, s_min (g.number_of_cells * NUM_PHASES)
+		, s_max (g.number_of_cells * NUM_PHASES) {
+		aq.rock (g, poro, perm);
+		for (int cell = 0; cell < num_cells; ++cell) {
+			const double swr = uniform (.1, .2);
+			const double sgr = uniform (.05, .15);
+			s_min[cell * NUM_PHASES + 0] = swr;
+			s_min[cell * NUM_PHASES + 1] = sgr;
+			s_max[cell * NUM_PHASES + 0] = 1. - sgr;
+			s_max[cell * NUM_PHASES + 1] = 1. - swr;
+		}
+		visc[0] = 0.30 * prefix::centi * unit::Poise;
+		visc[1] = 0.05 * prefix::centi * unit::Poise;
+		dens[0] = 1000.;
+		dens[1] = 700.;
+	}
+
+	virtual int numDimensions () const { return DIMS; }
+	virtual int numCells () const { return num_cells; }
+	virtual const double* porosity () const { return &poro[0]; }
+	virtual const double* permeability () const { return &perm[0]; }
+	virtual int numPhases () const { return NUM_PHASES; }
+	virtual const double* viscosity () const { return visc; }
+	virtual const double* density () const { return dens; }
+	virtual const double* surfaceDensity () const { return dens; }
+
+	virtual void relperm (const int n, const double* s, const int* cells,
+	                      double* kr, double* dkrds) const {
+		for (int i = 0; i < n; ++i) {
+			const int c = cells[i];
+			const double swr = s_min[c * NUM_PHASES + 0];
+			const double sgr = s_min[c * NUM_PHASES + 1];
+			const double span = 1. - swr - sgr;
+			for (int p = 0; p < NUM_PHASES; ++p) {
+				// normalized saturation; quadratic curve
+				const double res = s_min[c * NUM_PHASES + p];
+				const double se = min (1., max (0., (s[i * NUM_PHASES + p] - res) / span));
+				kr[i * NUM_PHASES + p] = se * se;
+				if (dkrds) {
+					for (int q = 0; q < NUM_PHASES; ++q) {
+						dkrds[i * NUM_PHASES * NUM_PHASES + q * NUM_PHASES + p] =
+							(q == p) ? 2. * se / span : 0.;
+					}
+				}
+			}
+		}
+	}
+
+	virtual void capPress (const int n, const double*, const int*,
+	                       double* pc, double* dpcds) const {
+		fill (pc, pc + n * NUM_PHASES, 0.);
+		if (dpcds) {
+			fill (dpcds, dpcds + n * NUM_PHASES * NUM_PHASES, 0.);
+		}
+	}
+
+	virtual void satRange (const int n, const int* cells,
+	                       double* smin, double* smax) const {
+		for (int i = 0; i < n; ++i) {
+			for (int p = 0; p < NUM_PHASES; ++p) {
+				smin[i * NUM_PHASES + p] = s_min[cells[i] * NUM_PHASES + p];
+				smax[i * NUM_PHASES + p] = s_max[cells[i] * NUM_PHASES + p];
+			}
+		}
+	}
+};
+
+/**
+ * Collect timings and write them as a flat JSON object.
+ */
+struct Report {
+	vector <pair <string, double> > items;
+
+	void add (const char* name, double value) {
+		items.push_back (make_pair (string (name), value));
+	}
+
+	void write (ostream& os, int ni, int nj, int nk,
+	            int num_cols, int num_cells, int reps, int evals) const {
+		os << "{\n"
+		   << "  \"grid\": {\"ni\": " << ni << ", \"nj\": " << nj
+		   << ", \"nk\": " << nk << ", \"columns\": " << num_cols
+		   << ", \"cells\": " << num_cells << "},\n"
+		   << "  \"repeat\": " << reps << ",\n"
+		   << "  \"evaluations\": " << evals << ",\n"
+		   << "  \"seconds\": {";
+		for (size_t i = 0; i < items.size (); ++i) {
+			os << (i ? ",\n" : "\n")
+			   << "    \"" << items[i].first << "\": " << items[i].second;
+		}
+		os << "\n  }\n}\n";
+	}
+};
+
+int main (int argc, char *argv[]) try {
+	ParameterGroup param (argc, argv, false);
+	const Aquifer aq (param);
+	const int reps = param.getDefault <int> ("repeat", 5);
+	const int evals = param.getDefault <int> ("evals", 1000000);
+	const string output = param.getDefault <string> ("output", string ("-"));
+	srand (param.getDefault <int> ("seed", 1));
+
+	const double gravity[] = { 0., 0., Opm::unit::gravity };
+	UnstructuredGrid* g = aq.create_grid ();
+	const SyntheticProps fine_props (aq, *g);
+	const int num_cells = g->number_of_cells;
+	const int NP = SyntheticProps::NUM_PHASES;
+
+	Report rep;
+	time::StopWatch clock;
+
+	// construction of the top surface; this is done once for every case
+	unique_ptr <TopSurf> ts;
+	clock.start ();
+	for (int i = 0; i < reps; ++i) {
+		ts.reset (TopSurf::create (*g));
+	}
+	rep.add ("topsurf_create", clock.secsSinceStart () / reps);
+	const int num_cols = ts->number_of_cells;
+
+	// construction of the tables in the upscaled properties
+	unique_ptr <VertEqProps> props;
+	clock.start ();
+	for (int i = 0; i < reps; ++i) {
+		props.reset (VertEqProps::create (fine_props, *ts, gravity));
+	}
+	rep.add ("props_create", clock.secsSinceStart () / reps);
+
+	// some CO2 in every column, and a plume history to go with it
+	vector <double> coarse_sat (num_cols * NP);
+	vector <double> coarse_pres (num_cols, 100. * unit::barsa);
+	for (int col = 0; col < num_cols; ++col) {
+		const double sg = uniform (0., .5);
+		coarse_sat[col * NP + 0] = 1. - sg;
+		coarse_sat[col * NP + 1] = sg;
+	}
+	props->upd_res_sat (&coarse_sat[0]);
+
+	// coarse rel.perm. and cap.press. are evaluated in batches of all the
+	// columns, until the requested number of evaluations is reached
+	vector <int> cells (num_cols);
+	for (int col = 0; col < num_cols; ++col) {
+		cells[col] = col;
+	}
+	vector <double> kr (num_cols * NP);
+	vector <double> dkr (num_cols * NP * NP);
+	const double per_million = 1e6 / evals;
+	clock.start ();
+	for (int done = 0; done < evals; done += num_cols) {
+		const int n = min (num_cols, evals - done);
+		props->relperm (n, &coarse_sat[0], &cells[0], &kr[0], &dkr[0]);
+	}
+	rep.add ("relperm_per_million", clock.secsSinceStart () * per_million);
+	clock.start ();
+	for (int done = 0; done < evals; done += num_cols) {
+		const int n = min (num_cols, evals - done);
+		props->capPress (n, &coarse_sat[0], &cells[0], &kr[0], &dkr[0]);
+	}
+	rep.add ("cappress_per_million", clock.secsSinceStart () * per_million);
+
+	// table lookup on the integrated porosity, with random targets
+	const VertEqUpscaler up (*ts);
+	RunLenData <double> poro_dpt (num_cols, ts->col_cellpos);
+	vector <double> buf (ts->max_vert_res);
+	vector <double> targets (num_cols);
+	for (int col = 0; col < num_cols; ++col) {
+		up.gather (col, &buf[0], fine_props.porosity (), 1, 0);
+		up.wgt_dpt (col, &buf[0], poro_dpt);
+		targets[col] = uniform (0., 1.) * up.dpt_avg (col, &buf[0]);
+	}
+	int found = 0; // use the result so that the loop isn't eliminated
+	clock.start ();
+	for (int done = 0; done < evals; done += num_cols) {
+		const int n = min (num_cols, evals - done);
+		for (int col = 0; col < n; ++col) {
+			found += up.find (col, poro_dpt[col], targets[col]).block ();
+		}
+	}
+	rep.add ("find_per_million", clock.secsSinceStart () * per_million);
+
+	// translation of the state between the grids
+	vector <double> fine_sat (num_cells * NP);
+	vector <double> fine_pres (num_cells);
+	for (int cell = 0; cell < num_cells; ++cell) {
+		const double sg = uniform (0., .5);
+		fine_sat[cell * NP + 0] = 1. - sg;
+		fine_sat[cell * NP + 1] = sg;
+	}
+	vector <double> up_sat (num_cols * NP);
+	clock.start ();
+	for (int i = 0; i < reps; ++i) {
+		props->upscale_saturation (&fine_sat[0], &up_sat[0]);
+	}
+	rep.add ("upscale_saturation", clock.secsSinceStart () / reps);
+	clock.start ();
+	for (int i = 0; i < reps; ++i) {
+		props->downscale_saturation (&coarse_sat[0], &fine_sat[0]);
+	}
+	rep.add ("downscale_saturation", clock.secsSinceStart () / reps);
+	clock.start ();
+	for (int i = 0; i < reps; ++i) {
+		props->downscale_pressure (&coarse_sat[0], &coarse_pres[0], &fine_pres[0]);
+	}
+	rep.add ("downscale_pressure", clock.secsSinceStart () / reps);
+
+	// write to standard output unless we are told otherwise
+	if (output == "-") {
+		rep.write (cout, aq.ni, aq.nj, aq.nk, num_cols, num_cells, reps, evals);
+	}
+	else {
+		ofstream os (output.c_str ());
+		rep.write (os, aq.ni, aq.nj, aq.nk, num_cols, num_cells, reps, evals);
+	}
+	// print the sum of the lookups so that the compiler cannot skip them
+	cerr << "checksum: " << found << endl;
+
+	destroy_grid (g);
+	return 0;
+}
+catch (const std::exception &e) {
+	std::cerr << "Program threw an exception: " << e.what() << "\n";
+	throw;
+}
@@ -0,0 +1,46 @@
+/* -*- mode: c++; tab-width: 2; indent-tabs-mode: t; truncate-lines: t -*- */
+/* vim: set filetype=cpp autoindent tabstop=2 shiftwidth=2 noexpandtab softtabstop=2 nowrap: */
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+
+// Write a synthetic aquifer as a grid include file for a deck. Run with
+// e.g. "gen_aquifer shape=dome ni=1000 nj=1000 nk=100 rim=2 output=dome.grdecl";
+// see opm/verteq/aquifer.hpp for the rest of the parameters.
+
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/verteq/aquifer.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace Opm;
+using namespace Opm::parameter;
+using namespace std;
+
+int main (int argc, char *argv[]) try {
+	ParameterGroup param (argc, argv, false);
+	const Aquifer aq (param);
+	const string output = param.getDefault <string> ("output", string ("-"));
+
+	// write to standard output unless we are told otherwise
+	if (output == "-") {
+		aq.write_grdecl (cout);
+	}
+	else {
+		ofstream os (output.c_str ());
+		aq.write_grdecl (os);
+		if (!os) {
+			cerr << "Unable to write " << output << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+catch (const std::exception &e) {
+	std::cerr << "Program threw an exception: " << e.what() << "\n";
+	throw;
+}
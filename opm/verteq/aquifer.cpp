@@ -0,0 +1,425 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/aquifer.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/core/grid.h>
+#include <opm/core/grid/cornerpoint_grid.h>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <algorithm> // min, swap
+#include <cmath>     // exp, log, sqrt, cos, tan
+#include <ostream>
+#include <string>
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+// each random property is drawn from its own stream, so that changing
+// e.g. the distribution of permeability doesn't change the porosity
+const uint64_t THICK_STREAM = 1;
+const uint64_t PORO_STREAM = 2;
+const uint64_t PERM_STREAM = 3;
+
+const double PI = 3.14159265358979323846;
+
+// scramble the bits of an integer (the finalizer of SplitMix64); this
+// is a bijection, so distinct counters always give distinct outputs
+uint64_t
+mix (uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// uniformly distributed number in [0, 1), given by a counter
+double
+uniform (uint64_t seed, uint64_t stream, uint64_t index) {
+	const uint64_t bits = mix (mix (mix (seed) ^ stream) + index);
+
+	// use the upper 53 bits, which is what fits in the mantissa
+	return static_cast <double> (bits >> 11) * (1. / 9007199254740992.);
+}
+
+// normally distributed number with zero mean and unit variance, using
+// the Box-Muller transform on two consecutive counters
+double
+normal (uint64_t seed, uint64_t stream, uint64_t index) {
+	const double u1 = uniform (seed, stream, 2 * index + 0);
+	const double u2 = uniform (seed, stream, 2 * index + 1);
+	return sqrt (-2. * log (1. - u1)) * cos (2. * PI * u2);
+}
+
+/**
+ * Write a list of values for a keyword, a certain number on each line.
+ */
+struct KeywordWriter {
+	static const int PER_LINE = 6;
+
+	ostream& os;
+	int count;
+
+	KeywordWriter (ostream& out, const char* keyword)
+		: os (out)
+		, count (0) {
+		os << keyword << '\n';
+	}
+
+	template <typename T>
+	void operator () (const T& value) {
+		os << ' ' << value;
+		if (++count % PER_LINE == 0) {
+			os << '\n';
+		}
+	}
+
+	~KeywordWriter () {
+		if (count % PER_LINE != 0) {
+			os << '\n';
+		}
+		os << "/\n\n";
+	}
+};
+
+} // anonymous namespace
+
+Aquifer::Aquifer ()
+	: shape (SLOPING)
+	, ni (100)
+	, nj (100)
+	, nk (20)
+	, dx (100.)
+	, dy (100.)
+	, depth (1000.)
+	, dip (1.)
+	, thickness (2.)
+	, thickness_var (.2)
+	, rim (0)
+	, poro_median (.2)
+	, poro_sigma (.2)
+	, perm_median (500. * prefix::milli * unit::darcy)
+	, perm_sigma (1.)
+	, kv_kh (.1)
+	, seed (1) {
+}
+
+Aquifer::Aquifer (const parameter::ParameterGroup& param) {
+	// start out with the defaults, and override whatever is specified
+	const Aquifer def;
+
+	const string shape_name = param.getDefault <string> ("shape", string ("sloping"));
+	if (shape_name == "sloping") {
+		shape = SLOPING;
+	}
+	else if (shape_name == "dome") {
+		shape = DOME;
+	}
+	else if (shape_name == "anticline") {
+		shape = ANTICLINE;
+	}
+	else {
+		throw OPM_EXC ("Unknown aquifer shape \"%s\"", shape_name.c_str ());
+	}
+
+	ni = param.getDefault <int> ("ni", def.ni);
+	nj = param.getDefault <int> ("nj", def.nj);
+	nk = param.getDefault <int> ("nk", def.nk);
+	dx = param.getDefault <double> ("dx", def.dx);
+	dy = param.getDefault <double> ("dy", def.dy);
+	depth = param.getDefault <double> ("depth", def.depth);
+	dip = param.getDefault <double> ("dip", def.dip);
+	thickness = param.getDefault <double> ("thickness", def.thickness);
+	thickness_var = param.getDefault <double> ("thickness_var", def.thickness_var);
+	rim = param.getDefault <int> ("rim", def.rim);
+	poro_median = param.getDefault <double> ("poro_median", def.poro_median);
+	poro_sigma = param.getDefault <double> ("poro_sigma", def.poro_sigma);
+	perm_median = param.getDefault <double> ("perm_median",
+	                                         def.perm_median / (prefix::milli * unit::darcy))
+		* prefix::milli * unit::darcy;
+	perm_sigma = param.getDefault <double> ("perm_sigma", def.perm_sigma);
+	kv_kh = param.getDefault <double> ("kv_kh", def.kv_kh);
+	seed = static_cast <uint64_t> (param.getDefault <int> ("seed", static_cast <int> (def.seed)));
+
+	// layers must have positive thickness everywhere
+	if (!(thickness_var >= 0. && thickness_var < 1.)) {
+		throw OPM_EXC ("Thickness variation %g must be in [0, 1)", thickness_var);
+	}
+	if (2 * rim >= ni || 2 * rim >= nj) {
+		throw OPM_EXC ("Rim of %d columns leaves no active columns", rim);
+	}
+}
+
+double
+Aquifer::top (int i, int j) const {
+	const double x = i * dx;
+	const double y = j * dy;
+	const double len_x = ni * dx;
+	const double len_y = nj * dy;
+	const double slope = tan (dip * PI / 180.);
+
+	switch (shape) {
+	case SLOPING:
+		// shallowest along the left edge
+		return depth + slope * x;
+
+	case DOME: {
+		// paraboloid which has the given slope where it hits the closest
+		// edge of the aquifer
+		const double radius = .5 * min (len_x, len_y);
+		const double rx = x - .5 * len_x;
+		const double ry = y - .5 * len_y;
+		return depth + slope * (rx * rx + ry * ry) / (2. * radius);
+	}
+
+	case ANTICLINE: {
+		// parabola in the x-direction only
+		const double half = .5 * len_x;
+		const double rx = x - half;
+		return depth + slope * (rx * rx) / (2. * half);
+	}
+	}
+	throw OPM_EXC ("Invalid aquifer shape %d", static_cast <int> (shape));
+}
+
+double
+Aquifer::layer_thickness (int pillar, int k) const {
+	// each pillar gets an independent variation for each layer
+	const uint64_t num_pillars = static_cast <uint64_t> (ni + 1) * (nj + 1);
+	const double u = uniform (seed, THICK_STREAM, k * num_pillars + pillar);
+	return thickness * (1. + thickness_var * (2. * u - 1.));
+}
+
+double
+Aquifer::depth_at (int i, int j, int k) const {
+	// accumulate thicknesses of the layers above the requested one
+	const int pillar = j * (ni + 1) + i;
+	double z = top (i, j);
+	for (int layer = 0; layer < k; ++layer) {
+		z += layer_thickness (pillar, layer);
+	}
+	return z;
+}
+
+void
+Aquifer::top_surface (vector <double>& surf) const {
+	for (int j = 0; j <= nj; ++j) {
+		for (int i = 0; i <= ni; ++i) {
+			surf[j * (ni + 1) + i] = top (i, j);
+		}
+	}
+}
+
+void
+Aquifer::next_surface (int k,
+                       const vector <double>& upper,
+                       vector <double>& lower) const {
+	for (int p = 0; p < static_cast <int> (upper.size ()); ++p) {
+		lower[p] = upper[p] + layer_thickness (p, k);
+	}
+}
+
+bool
+Aquifer::active (int i, int j) const {
+	return (i >= rim) && (i < ni - rim) && (j >= rim) && (j < nj - rim);
+}
+
+double
+Aquifer::poro (int i, int j, int k) const {
+	const uint64_t cell = (static_cast <uint64_t> (k) * nj + j) * ni + i;
+	const double phi = poro_median * exp (poro_sigma * normal (seed, PORO_STREAM, cell));
+
+	// the tail of the distribution would give unphysical values
+	return min (phi, .5);
+}
+
+double
+Aquifer::perm (int i, int j, int k) const {
+	const uint64_t cell = (static_cast <uint64_t> (k) * nj + j) * ni + i;
+	return perm_median * exp (perm_sigma * normal (seed, PERM_STREAM, cell));
+}
+
+UnstructuredGrid*
+Aquifer::create_grid () const {
+	// pillars are vertical lines through the corners of the lateral mesh;
+	// depth of the end points doesn't matter (but must be different)
+	const int num_pillars = (ni + 1) * (nj + 1);
+	vector <double> coord (num_pillars * 6);
+	for (int j = 0; j <= nj; ++j) {
+		for (int i = 0; i <= ni; ++i) {
+			double* const p = &coord[(j * (ni + 1) + i) * 6];
+			p[0] = p[3] = i * dx;
+			p[1] = p[4] = j * dy;
+			p[2] = depth;
+			p[5] = depth + 1.;
+		}
+	}
+
+	// each block has its own corners, even though they are shared with
+	// the neighbours here, so we fill in each layer surface twice; once
+	// as the bottom of the layer above and once as top of the one below
+	vector <double> zcorn (8 * static_cast <size_t> (ni) * nj * nk);
+	vector <double> upper (num_pillars);
+	vector <double> lower (num_pillars);
+	top_surface (upper);
+	for (int k = 0; k < nk; ++k) {
+		next_surface (k, upper, lower);
+		for (int dk = 0; dk < 2; ++dk) {
+			const vector <double>& surf = dk ? lower : upper;
+			for (int j = 0; j < nj; ++j) {
+				for (int dj = 0; dj < 2; ++dj) {
+					for (int i = 0; i < ni; ++i) {
+						for (int di = 0; di < 2; ++di) {
+							const size_t ndx = ((static_cast <size_t> (2 * k + dk) * 2 * nj
+							                     + 2 * j + dj) * 2 * ni + 2 * i + di);
+							zcorn[ndx] = surf[(j + dj) * (ni + 1) + i + di];
+						}
+					}
+				}
+			}
+		}
+		swap (upper, lower);
+	}
+
+	// the same columns are inactive in all layers
+	vector <int> actnum (static_cast <size_t> (ni) * nj * nk);
+	for (int k = 0; k < nk; ++k) {
+		for (int j = 0; j < nj; ++j) {
+			for (int i = 0; i < ni; ++i) {
+				actnum[(static_cast <size_t> (k) * nj + j) * ni + i] = active (i, j) ? 1 : 0;
+			}
+		}
+	}
+
+	// let the corner-point processing create the topology
+	grdecl gd;
+	gd.dims[0] = ni;
+	gd.dims[1] = nj;
+	gd.dims[2] = nk;
+	gd.coord = &coord[0];
+	gd.zcorn = &zcorn[0];
+	gd.actnum = &actnum[0];
+	gd.mapaxes = 0;
+	UnstructuredGrid* g = create_grid_cornerpoint (&gd, 0.);
+	if (!g) {
+		throw OPM_EXC ("Unable to create grid for %dx%dx%d aquifer", ni, nj, nk);
+	}
+	return g;
+}
+
+void
+Aquifer::rock (const UnstructuredGrid& g,
+               vector <double>& poro_out,
+               vector <double>& perm_out) const {
+	static const int PERM_MATRIX = 3 * 3;
+	poro_out.resize (g.number_of_cells);
+	perm_out.assign (g.number_of_cells * PERM_MATRIX, 0.);
+
+	// every value is drawn from its own counter, so the cells can be
+	// filled in any order without changing the result
+#ifdef _OPENMP
+#pragma omp parallel for schedule (static)
+#endif /* _OPENMP */
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		// only active cells are in the grid, so look up where they are
+		const int glob = g.global_cell ? g.global_cell[cell] : cell;
+		const int i = glob % ni;
+		const int j = (glob / ni) % nj;
+		const int k = glob / (ni * nj);
+
+		poro_out[cell] = poro (i, j, k);
+
+		// diagonal tensor; isotropic in the horizontal plane
+		const double kh = perm (i, j, k);
+		perm_out[cell * PERM_MATRIX + 0] = kh;
+		perm_out[cell * PERM_MATRIX + 4] = kh;
+		perm_out[cell * PERM_MATRIX + 8] = kv_kh * kh;
+	}
+}
+
+void
+Aquifer::write_grdecl (ostream& os) const {
+	// enough digits that the depths are not rounded to the same value
+	const streamsize old_prec = os.precision (10);
+
+	os << "SPECGRID\n " << ni << ' ' << nj << ' ' << nk << " 1 F /\n\n";
+
+	{
+		KeywordWriter kw (os, "COORD");
+		for (int j = 0; j <= nj; ++j) {
+			for (int i = 0; i <= ni; ++i) {
+				kw (i * dx); kw (j * dy); kw (depth);
+				kw (i * dx); kw (j * dy); kw (depth + 1.);
+			}
+		}
+	}
+
+	{
+		// keep the depth of the current layer surface for each pillar, so
+		// we don't have to sum the thicknesses from the top every time
+		const int num_pillars = (ni + 1) * (nj + 1);
+		vector <double> upper (num_pillars);
+		vector <double> lower (num_pillars);
+		top_surface (upper);
+
+		KeywordWriter kw (os, "ZCORN");
+		for (int k = 0; k < nk; ++k) {
+			next_surface (k, upper, lower);
+
+			// top corners of all blocks in the layer, then the bottom ones
+			for (int dk = 0; dk < 2; ++dk) {
+				const vector <double>& surf = dk ? lower : upper;
+				for (int j = 0; j < nj; ++j) {
+					for (int dj = 0; dj < 2; ++dj) {
+						for (int i = 0; i < ni; ++i) {
+							for (int di = 0; di < 2; ++di) {
+								kw (surf[(j + dj) * (ni + 1) + i + di]);
+							}
+						}
+					}
+				}
+			}
+			swap (upper, lower);
+		}
+	}
+
+	{
+		KeywordWriter kw (os, "ACTNUM");
+		for (int k = 0; k < nk; ++k) {
+			for (int j = 0; j < nj; ++j) {
+				for (int i = 0; i < ni; ++i) {
+					kw (active (i, j) ? 1 : 0);
+				}
+			}
+		}
+	}
+
+	{
+		KeywordWriter kw (os, "PORO");
+		for (int k = 0; k < nk; ++k) {
+			for (int j = 0; j < nj; ++j) {
+				for (int i = 0; i < ni; ++i) {
+					kw (poro (i, j, k));
+				}
+			}
+		}
+	}
+
+	// permeabilities are written in milli-darcy in the deck
+	const double md = prefix::milli * unit::darcy;
+	const char* const perm_kw[] = { "PERMX", "PERMY", "PERMZ" };
+	const double perm_factor[] = { 1., 1., kv_kh };
+	for (int dim = 0; dim < 3; ++dim) {
+		KeywordWriter kw (os, perm_kw[dim]);
+		for (int k = 0; k < nk; ++k) {
+			for (int j = 0; j < nj; ++j) {
+				for (int i = 0; i < ni; ++i) {
+					kw (perm_factor[dim] * perm (i, j, k) / md);
+				}
+			}
+		}
+	}
+
+	os.precision (old_prec);
+}
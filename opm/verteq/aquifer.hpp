@@ -0,0 +1,181 @@
+#ifndef OPM_VERTEQ_AQUIFER_HPP_INCLUDED
+#define OPM_VERTEQ_AQUIFER_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <cstdint> // uint64_t
+#include <iosfwd>
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+// forward declaration
+namespace parameter {
+class ParameterGroup;
+} // namespace parameter
+
+/**
+ * Synthetic aquifer, to be used to test how the code scales.
+ *
+ * The aquifer is a corner-point grid with vertical pillars on a regular
+ * lateral mesh. The top surface is shaped as either a plane, a dome or
+ * an anticline, and the layers below it vary in thickness. Columns along
+ * the edges may be made inactive, and the porosity and permeability are
+ * lognormally distributed.
+ *
+ * All values are generated from the index of the cell (or pillar) with
+ * a counter-based random number generator, so that the same aquifer is
+ * produced regardless of the order the values are requested in, and no
+ * more memory is needed than what is to be returned.
+ *
+ * @example
+ * @code{.cpp}
+ * Aquifer aq (param);
+ * UnstructuredGrid* g = aq.create_grid ();
+ * std::vector <double> poro, perm;
+ * aq.rock (*g, poro, perm);
+ * @endcode
+ */
+struct OPM_VERTEQ_PUBLIC Aquifer {
+	/**
+	 * Shape of the top surface.
+	 */
+	enum Shape {
+		SLOPING,    // plane dipping in the x-direction
+		DOME,       // paraboloid, highest in the middle
+		ANTICLINE   // ridge along the y-direction, highest in the middle
+	};
+
+	Shape shape;
+
+	// number of blocks in each direction
+	int ni, nj, nk;
+
+	// lateral size of each block, in meters
+	double dx, dy;
+
+	// depth of the highest point of the top surface, in meters
+	double depth;
+
+	// dip of the plane, or of the flanks of the dome and anticline at
+	// their edges, in degrees
+	double dip;
+
+	// average thickness of each layer, in meters, and the maximal
+	// relative deviation from it (between 0 and 1)
+	double thickness;
+	double thickness_var;
+
+	// number of inactive columns along each of the lateral edges
+	int rim;
+
+	// median porosity and the standard deviation of its logarithm
+	double poro_median;
+	double poro_sigma;
+
+	// median horizontal permeability (in SI units) and the standard
+	// deviation of its logarithm, and the ratio of vertical permeability
+	double perm_median;
+	double perm_sigma;
+	double kv_kh;
+
+	// seed for the random number generator
+	uint64_t seed;
+
+	/**
+	 * Aquifer with default values.
+	 */
+	Aquifer ();
+
+	/**
+	 * Read the aquifer from parameters named as the fields above; the
+	 * shape is given as "sloping", "dome" or "anticline", the dip in
+	 * degrees and the permeability in milli-darcy. Fields which are not
+	 * specified get the default value.
+	 */
+	Aquifer (const parameter::ParameterGroup& param);
+
+	/**
+	 * Depth of the top surface at a pillar.
+	 *
+	 * @param i Index of the pillar in the x-direction, 0 <= i <= ni.
+	 * @param j Index of the pillar in the y-direction, 0 <= j <= nj.
+	 */
+	double top (int i, int j) const;
+
+	/**
+	 * Depth of the top of a layer at a pillar. Layer nk is the bottom of
+	 * the aquifer.
+	 */
+	double depth_at (int i, int j, int k) const;
+
+	/**
+	 * Whether a column is active or part of the inactive rim.
+	 */
+	bool active (int i, int j) const;
+
+	/**
+	 * Porosity of a block, given by its Cartesian index.
+	 */
+	double poro (int i, int j, int k) const;
+
+	/**
+	 * Horizontal permeability of a block, given by its Cartesian index.
+	 */
+	double perm (int i, int j, int k) const;
+
+	/**
+	 * Create a grid for the aquifer in memory.
+	 *
+	 * @return Grid which must be disposed with destroy_grid().
+	 */
+	UnstructuredGrid* create_grid () const;
+
+	/**
+	 * Porosity and permeability for each active cell in a grid created
+	 * from this aquifer, in the format used by IncompPropertiesInterface.
+	 * The cells are filled in parallel, but the values are the same for
+	 * any number of threads.
+	 *
+	 * @param[in]  g    Grid created with create_grid().
+	 * @param[out] poro Porosity for each cell.
+	 * @param[out] perm Full permeability tensor for each cell.
+	 */
+	void rock (const UnstructuredGrid& g,
+	           std::vector <double>& poro,
+	           std::vector <double>& perm) const;
+
+	/**
+	 * Write the aquifer as an Eclipse deck that can be included in the
+	 * GRID section; this contains the keywords SPECGRID, COORD, ZCORN,
+	 * ACTNUM, PORO, PERMX, PERMY and PERMZ.
+	 *
+	 * The values are written as they are generated, so that aquifers can
+	 * be written that are larger than what would fit in memory.
+	 */
+	void write_grdecl (std::ostream& os) const;
+
+private:
+	// thickness of layer k at a pillar (given by its flat index)
+	double layer_thickness (int pillar, int k) const;
+
+	// depth of the top surface at every pillar
+	void top_surface (std::vector <double>& surf) const;
+
+	// depth of the bottom of layer k at every pillar, given the top of it
+	void next_surface (int k,
+	                   const std::vector <double>& upper,
+	                   std::vector <double>& lower) const;
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_AQUIFER_HPP_INCLUDED */
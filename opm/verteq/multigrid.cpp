@@ -0,0 +1,462 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/multigrid.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/core/grid.h>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <algorithm> // fill, copy, swap
+#include <cmath>     // sqrt, abs
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+// levels that have fewer active cells than this are solved directly
+const int DIRECT_SIZE = 64;
+
+// number of Gauss-Seidel sweeps before and after the coarse correction
+const int NUM_SWEEPS = 2;
+
+// piecewise constant prolongation underestimates the smooth error, so
+// the coarse correction is scaled up; with values around two the number
+// of iterations hardly grows with the size of the grid
+const double OVER_CORRECTION = 1.9;
+
+/**
+ * Five-point operator on a structured layout, with work arrays for the
+ * V-cycle on this level.
+ *
+ * The layout is padded with a ring of ghost cells, so that every active
+ * cell has four neighbours in memory. Ghost cells and holes have no
+ * coefficients coupling to them, and a unit diagonal, so the smoother
+ * leaves them at zero without having to test for them.
+ */
+struct Level {
+	// number of cells in each direction, and distance between rows
+	int nx;
+	int ny;
+	int stride;
+
+	// whether each cell takes part in the system
+	vector <char> act;
+
+	// matrix coefficients; the diagonal and the coupling to each of the
+	// four neighbours
+	vector <double> diag;
+	vector <double> west;
+	vector <double> east;
+	vector <double> south;
+	vector <double> north;
+
+	// solution, right-hand side and residual on this level
+	vector <double> x;
+	vector <double> b;
+	vector <double> r;
+
+	// for the coarsest level, position of each active cell, and a dense
+	// LU-factorization of the operator on these
+	vector <int> pos;
+	vector <double> lu;
+	vector <int> piv;
+
+	Level (int nx_, int ny_)
+		: nx (nx_)
+		, ny (ny_)
+		, stride (nx_ + 2)
+		, act ((nx_ + 2) * (ny_ + 2), 0)
+		, diag ((nx_ + 2) * (ny_ + 2), 1.)
+		, west ((nx_ + 2) * (ny_ + 2), 0.)
+		, east ((nx_ + 2) * (ny_ + 2), 0.)
+		, south ((nx_ + 2) * (ny_ + 2), 0.)
+		, north ((nx_ + 2) * (ny_ + 2), 0.)
+		, x ((nx_ + 2) * (ny_ + 2), 0.)
+		, b ((nx_ + 2) * (ny_ + 2), 0.)
+		, r ((nx_ + 2) * (ny_ + 2), 0.) {
+	}
+
+	// position in the padded arrays of a structured coordinate
+	int at (int i, int j) const {
+		return (j + 1) * stride + (i + 1);
+	}
+
+	int num_active () const {
+		int cnt = 0;
+		for (size_t p = 0; p < act.size (); ++p) {
+			cnt += act[p];
+		}
+		return cnt;
+	}
+
+	// Gauss-Seidel sweep over the layout, in either direction
+	void smooth (bool forward) {
+		const int first = forward ? at (0, 0) : at (nx - 1, ny - 1);
+		const int last = forward ? at (nx - 1, ny - 1) + 1 : at (0, 0) - 1;
+		const int step = forward ? +1 : -1;
+		for (int p = first; p != last; p += step) {
+			const double s = b[p]
+				- west[p] * x[p - 1] - east[p] * x[p + 1]
+				- south[p] * x[p - stride] - north[p] * x[p + stride];
+			x[p] = s / diag[p];
+		}
+		// the sweep passes through the ghost cells at the ends of each
+		// row, but these have b = 0 and no coefficients, and stay zero
+	}
+
+	// r = b - A x
+	void residual () {
+		for (int p = at (0, 0); p <= at (nx - 1, ny - 1); ++p) {
+			r[p] = b[p] - diag[p] * x[p]
+				- west[p] * x[p - 1] - east[p] * x[p + 1]
+				- south[p] * x[p - stride] - north[p] * x[p + stride];
+		}
+	}
+
+	// factor the operator as a dense matrix
+	void factor () {
+		// number the active cells
+		pos.clear ();
+		vector <int> num (act.size (), -1);
+		for (int j = 0; j < ny; ++j) {
+			for (int i = 0; i < nx; ++i) {
+				if (act[at (i, j)]) {
+					num[at (i, j)] = static_cast <int> (pos.size ());
+					pos.push_back (at (i, j));
+				}
+			}
+		}
+
+		// assemble the dense matrix row by row
+		const int m = static_cast <int> (pos.size ());
+		lu.assign (m * m, 0.);
+		for (int row = 0; row < m; ++row) {
+			const int p = pos[row];
+			lu[row * m + row] = diag[p];
+			if (num[p - 1] >= 0) { lu[row * m + num[p - 1]] = west[p]; }
+			if (num[p + 1] >= 0) { lu[row * m + num[p + 1]] = east[p]; }
+			if (num[p - stride] >= 0) { lu[row * m + num[p - stride]] = south[p]; }
+			if (num[p + stride] >= 0) { lu[row * m + num[p + stride]] = north[p]; }
+		}
+
+		// Gaussian elimination with partial pivoting
+		piv.resize (m);
+		for (int k = 0; k < m; ++k) {
+			int best = k;
+			for (int row = k + 1; row < m; ++row) {
+				if (abs (lu[row * m + k]) > abs (lu[best * m + k])) {
+					best = row;
+				}
+			}
+			piv[k] = best;
+			if (best != k) {
+				for (int col = 0; col < m; ++col) {
+					swap (lu[k * m + col], lu[best * m + col]);
+				}
+			}
+			if (lu[k * m + k] == 0.) {
+				throw OPM_EXC ("Coarse pressure system is singular");
+			}
+			for (int row = k + 1; row < m; ++row) {
+				const double f = lu[row * m + k] /= lu[k * m + k];
+				for (int col = k + 1; col < m; ++col) {
+					lu[row * m + col] -= f * lu[k * m + col];
+				}
+			}
+		}
+	}
+
+	// solve A x = b with the dense factorization
+	void solve_direct () {
+		const int m = static_cast <int> (pos.size ());
+		vector <double> y (m);
+		for (int row = 0; row < m; ++row) {
+			y[row] = b[pos[row]];
+		}
+		for (int k = 0; k < m; ++k) {
+			swap (y[k], y[piv[k]]);
+			for (int row = k + 1; row < m; ++row) {
+				y[row] -= lu[row * m + k] * y[k];
+			}
+		}
+		for (int row = m - 1; row >= 0; --row) {
+			for (int col = row + 1; col < m; ++col) {
+				y[row] -= lu[row * m + col] * y[col];
+			}
+			y[row] /= lu[row * m + row];
+		}
+		for (int row = 0; row < m; ++row) {
+			x[pos[row]] = y[row];
+		}
+	}
+};
+
+/**
+ * Galerkin coarse operator for aggregates of 2x2 cells, A_c = P^T A P
+ * where P is piecewise constant. Couplings between cells inside an
+ * aggregate end up on the diagonal.
+ */
+void
+coarsen (const Level& f, Level& c) {
+	for (int j = 0; j < f.ny; ++j) {
+		for (int i = 0; i < f.nx; ++i) {
+			const int p = f.at (i, j);
+			if (!f.act[p]) {
+				continue;
+			}
+			const int ci = i / 2;
+			const int cj = j / 2;
+			const int q = c.at (ci, cj);
+
+			// the first active child resets the unit diagonal of the hole
+			if (!c.act[q]) {
+				c.act[q] = 1;
+				c.diag[q] = 0.;
+			}
+			c.diag[q] += f.diag[p];
+
+			// neighbours in the same aggregate, or in the adjacent one
+			if ((i - 1) / 2 == ci && i > 0) { c.diag[q] += f.west[p]; }
+			else { c.west[q] += f.west[p]; }
+			if ((i + 1) / 2 == ci) { c.diag[q] += f.east[p]; }
+			else { c.east[q] += f.east[p]; }
+			if ((j - 1) / 2 == cj && j > 0) { c.diag[q] += f.south[p]; }
+			else { c.south[q] += f.south[p]; }
+			if ((j + 1) / 2 == cj) { c.diag[q] += f.north[p]; }
+			else { c.north[q] += f.north[p]; }
+		}
+	}
+}
+
+/**
+ * Improve the solution on a level, given that the right-hand side is
+ * set and the solution is initialized.
+ */
+void
+vcycle (vector <Level>& levels, size_t lvl) {
+	Level& f = levels[lvl];
+
+	// solve exactly on the coarsest level
+	if (lvl + 1 == levels.size ()) {
+		f.solve_direct ();
+		return;
+	}
+
+	// pre-smoothing, going forward so that the cycle is symmetric
+	for (int sweep = 0; sweep < NUM_SWEEPS; ++sweep) {
+		f.smooth (true);
+	}
+
+	// restrict the residual to the next level by summing the aggregates
+	f.residual ();
+	Level& c = levels[lvl + 1];
+	fill (c.b.begin (), c.b.end (), 0.);
+	fill (c.x.begin (), c.x.end (), 0.);
+	for (int j = 0; j < f.ny; ++j) {
+		for (int i = 0; i < f.nx; ++i) {
+			c.b[c.at (i / 2, j / 2)] += f.r[f.at (i, j)];
+		}
+	}
+
+	vcycle (levels, lvl + 1);
+
+	// prolongate the correction to the active cells of the aggregates
+	for (int j = 0; j < f.ny; ++j) {
+		for (int i = 0; i < f.nx; ++i) {
+			const int p = f.at (i, j);
+			f.x[p] += OVER_CORRECTION * f.act[p] * c.x[c.at (i / 2, j / 2)];
+		}
+	}
+
+	// post-smoothing, going backwards
+	for (int sweep = 0; sweep < NUM_SWEEPS; ++sweep) {
+		f.smooth (false);
+	}
+}
+
+// z = M^{-1} r, where M is a V-cycle for the unknowns of the cells,
+// and the diagonal for the rest
+void
+precondition (vector <Level>& levels, const vector <int>& cart, int ni,
+              const vector <double>& extra_diag, int size,
+              const double* r, double* z) {
+	Level& top = levels.front ();
+	const int num_cells = static_cast <int> (cart.size ());
+	fill (top.x.begin (), top.x.end (), 0.);
+	for (int cell = 0; cell < num_cells; ++cell) {
+		top.b[top.at (cart[cell] % ni, cart[cell] / ni)] = r[cell];
+	}
+	vcycle (levels, 0);
+	for (int cell = 0; cell < num_cells; ++cell) {
+		z[cell] = top.x[top.at (cart[cell] % ni, cart[cell] / ni)];
+	}
+	for (int row = num_cells; row < size; ++row) {
+		z[row] = r[row] / extra_diag[row - num_cells];
+	}
+}
+
+// y = A x for a matrix in compressed sparse row format
+void
+matvec (int size, const int* ia, const int* ja, const double* sa,
+        const double* x, double* y) {
+	for (int row = 0; row < size; ++row) {
+		double accum = 0.;
+		for (int nz = ia[row]; nz < ia[row + 1]; ++nz) {
+			accum += sa[nz] * x[ja[nz]];
+		}
+		y[row] = accum;
+	}
+}
+
+double
+dot (int size, const double* x, const double* y) {
+	double accum = 0.;
+	for (int i = 0; i < size; ++i) {
+		accum += x[i] * y[i];
+	}
+	return accum;
+}
+
+} // anonymous namespace
+
+LinearSolverMG::LinearSolverMG (const UnstructuredGrid& g,
+                                const parameter::ParameterGroup& param)
+	: ni (g.cartdims[0])
+	, nj (g.cartdims[1])
+	, cart (g.number_of_cells)
+	, tolerance (param.getDefault <double> ("linsolver_residual_tolerance", 1e-8))
+	, max_iter (param.getDefault <int> ("linsolver_max_iterations", 200)) {
+
+	// without the Cartesian index we don't know the structure
+	if (g.dimensions != 2) {
+		throw OPM_EXC ("Expected two-dimensional grid, but got %d", g.dimensions);
+	}
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		cart[cell] = g.global_cell ? g.global_cell[cell] : cell;
+	}
+}
+
+LinearSolverMG::~LinearSolverMG () {
+}
+
+void
+LinearSolverMG::setTolerance (const double tol) {
+	tolerance = tol;
+}
+
+double
+LinearSolverMG::getTolerance () const {
+	return tolerance;
+}
+
+LinearSolverInterface::LinearSolverReport
+LinearSolverMG::solve (const int size,
+                       const int nonzeros,
+                       const int* ia,
+                       const int* ja,
+                       const double* sa,
+                       const double* rhs,
+                       double* solution) const {
+	static_cast <void> (nonzeros);
+	const int num_cells = static_cast <int> (cart.size ());
+	if (size < num_cells) {
+		throw OPM_EXC ("Expected at least %d unknowns, but got %d", num_cells, size);
+	}
+
+	// put the rows of the cells into the structured layout; couplings
+	// that are not to a lateral neighbour (wells) are left out of the
+	// preconditioner but are still part of the product below
+	vector <Level> levels;
+	levels.push_back (Level (ni, nj));
+	{
+		Level& f = levels.back ();
+		for (int cell = 0; cell < num_cells; ++cell) {
+			const int i = cart[cell] % ni;
+			const int j = cart[cell] / ni;
+			const int p = f.at (i, j);
+			f.act[p] = 1;
+			for (int nz = ia[cell]; nz < ia[cell + 1]; ++nz) {
+				const int other = ja[nz];
+				if (other == cell) {
+					f.diag[p] = sa[nz];
+				}
+				else if (other < num_cells) {
+					const int oi = cart[other] % ni;
+					const int oj = cart[other] / ni;
+					if (oj == j && oi == i - 1) { f.west[p] = sa[nz]; }
+					else if (oj == j && oi == i + 1) { f.east[p] = sa[nz]; }
+					else if (oi == i && oj == j - 1) { f.south[p] = sa[nz]; }
+					else if (oi == i && oj == j + 1) { f.north[p] = sa[nz]; }
+				}
+			}
+		}
+	}
+
+	// coarsen until the system is small enough to be solved directly
+	while (levels.back ().num_active () > DIRECT_SIZE &&
+	       (levels.back ().nx > 1 || levels.back ().ny > 1)) {
+		const Level& f = levels.back ();
+		Level c ((f.nx + 1) / 2, (f.ny + 1) / 2);
+		coarsen (f, c);
+		levels.push_back (c);
+	}
+	levels.back ().factor ();
+
+	// diagonal of the other unknowns, for the Jacobi part
+	vector <double> extra_diag (size - num_cells, 1.);
+	for (int row = num_cells; row < size; ++row) {
+		for (int nz = ia[row]; nz < ia[row + 1]; ++nz) {
+			if (ja[nz] == row) {
+				extra_diag[row - num_cells] = sa[nz];
+			}
+		}
+	}
+
+	// preconditioned conjugate gradients, starting from zero
+	LinearSolverReport rep;
+	rep.converged = false;
+	rep.iterations = 0;
+	rep.residual_reduction = 1.;
+
+	vector <double> r (rhs, rhs + size);
+	vector <double> z (size);
+	vector <double> p (size);
+	vector <double> q (size);
+	fill (solution, solution + size, 0.);
+
+	const double norm_b = sqrt (dot (size, &r[0], &r[0]));
+	if (norm_b == 0.) {
+		rep.converged = true;
+		rep.residual_reduction = 0.;
+		return rep;
+	}
+
+	precondition (levels, cart, ni, extra_diag, size, &r[0], &z[0]);
+	copy (z.begin (), z.end (), p.begin ());
+	double rho = dot (size, &r[0], &z[0]);
+
+	while (rep.iterations < max_iter) {
+		++rep.iterations;
+		matvec (size, ia, ja, sa, &p[0], &q[0]);
+		const double alpha = rho / dot (size, &p[0], &q[0]);
+		for (int k = 0; k < size; ++k) {
+			solution[k] += alpha * p[k];
+			r[k] -= alpha * q[k];
+		}
+
+		rep.residual_reduction = sqrt (dot (size, &r[0], &r[0])) / norm_b;
+		if (rep.residual_reduction < tolerance) {
+			rep.converged = true;
+			break;
+		}
+
+		precondition (levels, cart, ni, extra_diag, size, &r[0], &z[0]);
+		const double rho_new = dot (size, &r[0], &z[0]);
+		const double beta = rho_new / rho;
+		rho = rho_new;
+		for (int k = 0; k < size; ++k) {
+			p[k] = z[k] + beta * p[k];
+		}
+	}
+	return rep;
+}
@@ -0,0 +1,113 @@
+#ifndef OPM_VERTEQ_MULTIGRID_HPP_INCLUDED
+#define OPM_VERTEQ_MULTIGRID_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+#ifndef OPM_LINEARSOLVERINTERFACE_HEADER_INCLUDED
+#include <opm/core/linalg/LinearSolverInterface.hpp>
+#endif /* OPM_LINEARSOLVERINTERFACE_HEADER_INCLUDED */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+// forward declaration
+namespace parameter {
+class ParameterGroup;
+} // namespace parameter
+
+/**
+ * Linear solver for the pressure equation on a top surface grid.
+ *
+ * The top surface is logically Cartesian, so the two-point flux
+ * discretization gives a five-point stencil in the (i,j) plane. This
+ * solver maps the matrix back onto the structured layout, and uses a
+ * geometric multigrid V-cycle as a preconditioner for the conjugate
+ * gradient method. Each coarse level is formed by merging 2x2 blocks,
+ * and the coarse operators are the Galerkin products, which again are
+ * five-point stencils. Columns that are not in the grid are holes in
+ * the layout, and do not take part.
+ *
+ * Unknowns which are not cells in the grid (such as the bottom-hole
+ * pressure of wells) are preconditioned with their diagonal only.
+ *
+ * The outer iteration is preconditioned conjugate gradients, so the
+ * matrix must be symmetric and positive definite, as is the case for
+ * the incompressible pressure equation of the cells. Rows for wells
+ * are not always so; a rate-controlled well may be coupled to its cells
+ * in one direction only, and then the solver may stall or diverge
+ * without reporting why. Use a general solver for such systems.
+ *
+ * @example
+ * @code{.cpp}
+ * LinearSolverMG linsolver (ve->grid (), param);
+ * @endcode
+ */
+class OPM_VERTEQ_PUBLIC LinearSolverMG : public LinearSolverInterface {
+public:
+	/**
+	 * Setup the solver for a grid.
+	 *
+	 * @param g Grid which the matrix is assembled for. It must have the
+	 *          cartdims and global_cell fields of a two-dimensional grid,
+	 *          such as the one returned from VertEq::grid.
+	 * @param param Parameters; linsolver_residual_tolerance (default 1e-8)
+	 *              and linsolver_max_iterations (default 200) are read.
+	 */
+	LinearSolverMG (const UnstructuredGrid& g,
+	                const parameter::ParameterGroup& param);
+
+	virtual ~LinearSolverMG ();
+
+	using LinearSolverInterface::solve;
+
+	/**
+	 * Solve the linear system; the first rows must be the cells of the
+	 * grid, in order.
+	 *
+	 * @see LinearSolverInterface::solve
+	 */
+	virtual LinearSolverReport solve (const int size,
+	                                  const int nonzeros,
+	                                  const int* ia,
+	                                  const int* ja,
+	                                  const double* sa,
+	                                  const double* rhs,
+	                                  double* solution) const;
+
+	/**
+	 * Set the relative reduction of the residual norm which is the
+	 * criterion for convergence.
+	 */
+	virtual void setTolerance (const double tol);
+
+	/**
+	 * Get the relative reduction of the residual norm which is the
+	 * criterion for convergence.
+	 */
+	virtual double getTolerance () const;
+
+private:
+	// size of the structured layout
+	int ni;
+	int nj;
+
+	// Cartesian index of each cell in the grid
+	std::vector <int> cart;
+
+	// criteria to stop iterating
+	double tolerance;
+	int max_iter;
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_MULTIGRID_HPP_INCLUDED */
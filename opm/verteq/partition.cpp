@@ -0,0 +1,276 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#include <opm/verteq/partition.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/core/grid.h>
+#include <algorithm> // merge, sort, max, min
+#include <cmath>     // fabs
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+/**
+ * Order columns along one axis, using the other axis and then the index
+ * to break ties, so that the order is the same on every process.
+ */
+struct AlongAxis {
+	const double* cc;
+	int axis;
+
+	AlongAxis (const double* centroids, int dir)
+		: cc (centroids)
+		, axis (dir) {
+	}
+
+	bool operator () (int a, int b) const {
+		const double a_major = cc[2 * a + axis];
+		const double b_major = cc[2 * b + axis];
+		if (a_major != b_major) {
+			return a_major < b_major;
+		}
+		const double a_minor = cc[2 * a + 1 - axis];
+		const double b_minor = cc[2 * b + 1 - axis];
+		if (a_minor != b_minor) {
+			return a_minor < b_minor;
+		}
+		return a < b;
+	}
+};
+
+/**
+ * Assign the columns in [first, last) to the parts [part, part + num).
+ */
+void
+bisect (const UnstructuredGrid& g,
+        const double* weight,
+        vector <int>::iterator first,
+        vector <int>::iterator last,
+        int part,
+        int num,
+        vector <int>& own) {
+	// the last split is trivial
+	if (num == 1) {
+		for (vector <int>::iterator it = first; it != last; ++it) {
+			own[*it] = part;
+		}
+		return;
+	}
+
+	// find the extent of the columns, and their total weight
+	const double* cc = g.cell_centroids;
+	double lo[2] = { cc[2 * (*first) + 0], cc[2 * (*first) + 1] };
+	double hi[2] = { lo[0], lo[1] };
+	double total = 0.;
+	for (vector <int>::iterator it = first; it != last; ++it) {
+		for (int d = 0; d < 2; ++d) {
+			lo[d] = min (lo[d], cc[2 * (*it) + d]);
+			hi[d] = max (hi[d], cc[2 * (*it) + d]);
+		}
+		total += weight[*it];
+	}
+
+	// cut across the longest side, so that the parts get more square
+	const int axis = (hi[0] - lo[0] >= hi[1] - lo[1]) ? 0 : 1;
+	sort (first, last, AlongAxis (cc, axis));
+
+	// the number of parts may be odd, so the weight is not necessarily
+	// split in half; put the first parts on the left side
+	const int left = num / 2;
+	const double target = total * left / num;
+
+	// walk along the columns until we have passed the target, and then
+	// pick the closest split point of the two around it
+	const int n = static_cast <int> (last - first);
+	int split = 0;
+	double accum = 0.;
+	while (split < n && accum + weight[first[split]] <= target) {
+		accum += weight[first[split]];
+		++split;
+	}
+	if (split < n &&
+	    fabs (accum + weight[first[split]] - target) < fabs (accum - target)) {
+		++split;
+	}
+
+	// every part must get at least one column
+	split = max (left, min (n - (num - left), split));
+
+	bisect (g, weight, first, first + split, part, left, own);
+	bisect (g, weight, first + split, last, part + left, num - left, own);
+}
+
+} // anonymous namespace
+
+ColumnPartition::ColumnPartition (const TopSurf& ts, int num_parts) {
+	// the work in a column is proportional to the number of blocks in it
+	vector <double> height (ts.number_of_cells);
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		height[col] = ts.col_cellpos[col + 1] - ts.col_cellpos[col];
+	}
+	setup (ts, height.empty () ? 0 : &height[0], num_parts);
+}
+
+ColumnPartition::ColumnPartition (const UnstructuredGrid& g,
+                                  const double* weight,
+                                  int num_parts) {
+	setup (g, weight, num_parts);
+}
+
+void
+ColumnPartition::setup (const UnstructuredGrid& g,
+                        const double* weight,
+                        int num_parts) {
+	const int nc = g.number_of_cells;
+	if (num_parts < 1 || num_parts > nc) {
+		throw OPM_EXC ("Cannot divide %d columns into %d parts", nc, num_parts);
+	}
+
+	// assign an owner to each column
+	own.assign (nc, 0);
+	vector <int> order (nc);
+	for (int col = 0; col < nc; ++col) {
+		order[col] = col;
+	}
+	bisect (g, weight, order.begin (), order.end (), 0, num_parts, own);
+
+	// collect the columns of each part; they are visited in ascending
+	// order, so the lists come out sorted
+	loads.assign (num_parts, 0.);
+	owned_cols.assign (num_parts, vector <int> ());
+	halo_cols.assign (num_parts, vector <int> ());
+	local_cols.assign (num_parts, vector <int> ());
+	for (int col = 0; col < nc; ++col) {
+		loads[own[col]] += weight[col];
+		owned_cols[own[col]].push_back (col);
+	}
+
+	// a column is in the halo of every other part that it has a face to
+	for (int col = 0; col < nc; ++col) {
+		for (int pos = g.cell_facepos[col]; pos != g.cell_facepos[col + 1]; ++pos) {
+			const int face = g.cell_faces[pos];
+			const int other = g.face_cells[2 * face + 0] == col
+			                ? g.face_cells[2 * face + 1]
+			                : g.face_cells[2 * face + 0];
+			if (other >= 0 && own[other] != own[col]) {
+				vector <int>& halo = halo_cols[own[other]];
+				// we visit the columns in order, so if it is added already,
+				// then it is the last one
+				if (halo.empty () || halo.back () != col) {
+					halo.push_back (col);
+				}
+			}
+		}
+	}
+
+	// merge the two lists into the local columns of each part
+	for (int part = 0; part < num_parts; ++part) {
+		vector <int>& local = local_cols[part];
+		local.resize (owned_cols[part].size () + halo_cols[part].size ());
+		merge (owned_cols[part].begin (), owned_cols[part].end (),
+		       halo_cols[part].begin (), halo_cols[part].end (),
+		       local.begin ());
+	}
+}
+
+#if HAVE_MPI
+namespace {
+
+// tag of the messages that carry the halo
+const int HALO_TAG = 17;
+
+} // anonymous namespace
+
+HaloExchange::HaloExchange (const ColumnPartition& part, MPI_Comm comm)
+	: comm (comm) {
+	int rank, size;
+	MPI_Comm_rank (comm, &rank);
+	MPI_Comm_size (comm, &size);
+	if (size != part.num_parts ()) {
+		throw OPM_EXC ("Partition has %d parts, but there are %d processes",
+		               part.num_parts (), size);
+	}
+
+	// the halo of this process is sorted by column; group it by owner. the
+	// peer gets the same lists when it looks at what it owns in our halo,
+	// so the columns are in the same order on both sides
+	const vector <int>& halo = part.halo (rank);
+	vector <vector <int> > from (size);
+	for (size_t i = 0; i < halo.size (); ++i) {
+		from[part.owner (halo[i])].push_back (halo[i]);
+	}
+
+	// the columns we own that are in the halo of another process; the
+	// halo is symmetric, so the processes we receive from are the ones
+	// we send to
+	vector <vector <int> > to (size);
+	for (int peer = 0; peer < size; ++peer) {
+		if (!from[peer].empty ()) {
+			const vector <int>& other = part.halo (peer);
+			for (size_t i = 0; i < other.size (); ++i) {
+				if (part.owner (other[i]) == rank) {
+					to[peer].push_back (other[i]);
+				}
+			}
+		}
+	}
+
+	// store the lists consecutively
+	send_pos.push_back (0);
+	recv_pos.push_back (0);
+	for (int peer = 0; peer < size; ++peer) {
+		if (!from[peer].empty ()) {
+			peers.push_back (peer);
+			send_cols.insert (send_cols.end (), to[peer].begin (), to[peer].end ());
+			recv_cols.insert (recv_cols.end (), from[peer].begin (), from[peer].end ());
+			send_pos.push_back (static_cast <int> (send_cols.size ()));
+			recv_pos.push_back (static_cast <int> (recv_cols.size ()));
+		}
+	}
+}
+
+void
+HaloExchange::exchange (double* data, int stride) const {
+	const int num_peers = static_cast <int> (peers.size ());
+	vector <double> send_buf (send_cols.size () * stride);
+	vector <double> recv_buf (recv_cols.size () * stride);
+	vector <MPI_Request> req (2 * num_peers);
+
+	// post all the receives first, so that the messages don't have to be
+	// buffered while waiting for them
+	for (int i = 0; i < num_peers; ++i) {
+		const int count = (recv_pos[i + 1] - recv_pos[i]) * stride;
+		MPI_Irecv (&recv_buf[recv_pos[i] * stride], count, MPI_DOUBLE,
+		           peers[i], HALO_TAG, comm, &req[i]);
+	}
+
+	// pack the owned values for each peer, and send them off
+	for (size_t j = 0; j < send_cols.size (); ++j) {
+		for (int k = 0; k < stride; ++k) {
+			send_buf[j * stride + k] = data[send_cols[j] * stride + k];
+		}
+	}
+	for (int i = 0; i < num_peers; ++i) {
+		const int count = (send_pos[i + 1] - send_pos[i]) * stride;
+		MPI_Isend (&send_buf[send_pos[i] * stride], count, MPI_DOUBLE,
+		           peers[i], HALO_TAG, comm, &req[num_peers + i]);
+	}
+
+	// unpack into the halo when everything has arrived
+	if (num_peers > 0) {
+		MPI_Waitall (2 * num_peers, &req[0], MPI_STATUSES_IGNORE);
+	}
+	for (size_t j = 0; j < recv_cols.size (); ++j) {
+		for (int k = 0; k < stride; ++k) {
+			data[recv_cols[j] * stride + k] = recv_buf[j * stride + k];
+		}
+	}
+}
+#endif /* HAVE_MPI */
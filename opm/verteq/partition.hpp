@@ -0,0 +1,182 @@
+#ifndef OPM_VERTEQ_PARTITION_HPP_INCLUDED
+#define OPM_VERTEQ_PARTITION_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+#if HAVE_MPI
+#include <mpi.h>
+#endif /* HAVE_MPI */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+// forward declaration
+struct TopSurf;
+
+/**
+ * Assignment of the columns in the top surface to processes.
+ *
+ * The columns are independent of each other in the vertical direction,
+ * so all the data in the fine grid below a column can be owned by one
+ * process. The work to setup the properties and to downscale a column
+ * is proportional to the number of blocks in it, so the columns are
+ * weighted with their height.
+ *
+ * The top surface is divided by recursive coordinate bisection: the set
+ * of columns is split across its longest extent where half of the weight
+ * is on each side, and then each half is split again until there is one
+ * part for each process. This gives compact parts, so that the halo,
+ * i.e. the columns that are neighbours to the part, but owned by another
+ * process, is small.
+ *
+ * The partition only depends on the grid, so every process can compute
+ * it for itself and will get the same result.
+ *
+ * @example
+ * @code{.cpp}
+ * ColumnPartition part (*ts, num_procs);
+ * for (int i = 0; i < part.owned (rank).size (); ++i) {
+ *   ...
+ * }
+ * @endcode
+ */
+class OPM_VERTEQ_PUBLIC ColumnPartition {
+public:
+	/**
+	 * Partition the top surface, weighting each column with the number
+	 * of blocks in it.
+	 *
+	 * @param ts Top surface grid.
+	 * @param num_parts Number of parts, typically the number of processes.
+	 *                  There must be at least one column in each part.
+	 */
+	ColumnPartition (const TopSurf& ts, int num_parts);
+
+	/**
+	 * Partition a two-dimensional grid with given weights.
+	 *
+	 * @param g Grid to partition; the centroids of the cells are used as
+	 *          the coordinates of the columns.
+	 * @param weight Work associated with each cell in the grid.
+	 * @param num_parts Number of parts.
+	 */
+	ColumnPartition (const UnstructuredGrid& g,
+	                 const double* weight,
+	                 int num_parts);
+
+	/**
+	 * Number of parts that the grid has been divided into.
+	 */
+	int num_parts () const { return static_cast <int> (loads.size ()); }
+
+	/**
+	 * Part which owns a column.
+	 */
+	int owner (int col) const { return own[col]; }
+
+	/**
+	 * Sum of the weights of the columns owned by a part.
+	 */
+	double load (int part) const { return loads[part]; }
+
+	/**
+	 * Columns owned by a part, in ascending order.
+	 */
+	const std::vector <int>& owned (int part) const { return owned_cols[part]; }
+
+	/**
+	 * Columns owned by other parts, but which share a face with a column
+	 * owned by this part, in ascending order.
+	 */
+	const std::vector <int>& halo (int part) const { return halo_cols[part]; }
+
+	/**
+	 * Both the owned columns and the halo of a part, in ascending order.
+	 * This is what a process needs data for to do its share of the work.
+	 */
+	const std::vector <int>& local (int part) const { return local_cols[part]; }
+
+private:
+	// owner of each column
+	std::vector <int> own;
+
+	// weight of each part
+	std::vector <double> loads;
+
+	// lists of columns for each part
+	std::vector <std::vector <int> > owned_cols;
+	std::vector <std::vector <int> > halo_cols;
+	std::vector <std::vector <int> > local_cols;
+
+	// do the work of the constructors
+	void setup (const UnstructuredGrid& g,
+	            const double* weight,
+	            int num_parts);
+};
+
+#if HAVE_MPI
+/**
+ * Update the halo columns of an array on the top surface with the values
+ * from the processes which own them.
+ *
+ * Every process holds arrays for the entire top surface, but only the
+ * values for the columns that it owns are computed there. After each
+ * step, the values in the halo must be fetched from the neighbours.
+ *
+ * @example
+ * @code{.cpp}
+ * HaloExchange halo (part, MPI_COMM_WORLD);
+ * ...
+ * halo.exchange (&state.saturation ()[0], 2);
+ * halo.exchange (&state.pressure ()[0], 1);
+ * @endcode
+ */
+class OPM_VERTEQ_PUBLIC HaloExchange {
+public:
+	/**
+	 * Setup the communication pattern for this process.
+	 *
+	 * @param part Partition of the top surface. It must have as many
+	 *             parts as there are processes in the communicator, and
+	 *             the part of each process is given by its rank.
+	 * @param comm Communicator containing all processes.
+	 */
+	HaloExchange (const ColumnPartition& part, MPI_Comm comm);
+
+	/**
+	 * Exchange the values of the halo; this is a collective operation
+	 * which must be called by all processes at the same time.
+	 *
+	 * @param data Array with stride values for each column.
+	 * @param stride Number of values for each column, e.g. the number
+	 *               of phases for the saturation.
+	 */
+	void exchange (double* data, int stride) const;
+
+private:
+	MPI_Comm comm;
+
+	// processes that we have a common boundary with
+	std::vector <int> peers;
+
+	// columns to send to each peer, and to receive from it, stored
+	// consecutively; the first column for peer i is at position pos[i]
+	std::vector <int> send_pos;
+	std::vector <int> send_cols;
+	std::vector <int> recv_pos;
+	std::vector <int> recv_cols;
+};
+#endif /* HAVE_MPI */
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_PARTITION_HPP_INCLUDED */
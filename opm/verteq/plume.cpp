@@ -0,0 +1,149 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/plume.hpp>
+#include <opm/core/grid.h>
+#include <algorithm> // inplace_merge, sort
+#include <climits>   // INT_MAX
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+// distance of columns which are not close to the plume at all
+const int FAR = INT_MAX;
+
+} // anonymous namespace
+
+PlumeSet::PlumeSet (const UnstructuredGrid& g, int halo)
+	: g (g)
+	, everything (halo < 0)
+	, halo (halo < 0 ? g.number_of_cells : halo)
+	, dist (g.number_of_cells, halo < 0 ? 0 : FAR) {
+
+	// if we are not tracking anything, then all columns are in the set
+	// from the start and nothing will ever change
+	if (everything) {
+		active.resize (g.number_of_cells);
+		for (int col = 0; col < g.number_of_cells; ++col) {
+			active[col] = col;
+		}
+	}
+}
+
+void
+PlumeSet::reset (const double* max_sat) {
+	if (everything) {
+		return;
+	}
+
+	// every column which has seen some CO2 is in the plume
+	vector <int> front;
+	for (int col = 0; col < g.number_of_cells; ++col) {
+		if (max_sat[col] > 0. && dist[col] != 0) {
+			dist[col] = 0;
+			front.push_back (col);
+		}
+	}
+	grow (front);
+}
+
+void
+PlumeSet::update (const double* max_sat) {
+	if (everything) {
+		return;
+	}
+
+	// only the columns in the halo can have joined the plume; those
+	// that are found are added to it after the scan, since growing the
+	// set changes the list
+	vector <int> front;
+	for (size_t i = 0; i < active.size (); ++i) {
+		const int col = active[i];
+		if (max_sat[col] > 0. && dist[col] != 0) {
+			dist[col] = 0;
+			front.push_back (col);
+		}
+	}
+	grow (front);
+}
+
+bool
+PlumeSet::leaked (const double* sat, int num_phases, int phase) const {
+	if (everything) {
+		return false;
+	}
+	for (size_t i = 0; i < active.size (); ++i) {
+		const int col = active[i];
+		if (dist[col] != halo || !(sat[col * num_phases + phase] > 0.)) {
+			continue;
+		}
+		for (int pos = g.cell_facepos[col]; pos != g.cell_facepos[col + 1]; ++pos) {
+			const int face = g.cell_faces[pos];
+			const int other = g.face_cells[2 * face + 0] == col
+			                ? g.face_cells[2 * face + 1]
+			                : g.face_cells[2 * face + 0];
+			if (other >= 0 && dist[other] > halo &&
+			    sat[other * num_phases + phase] > 0.) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void
+PlumeSet::insert (int col) {
+	if (everything || dist[col] == 0) {
+		return;
+	}
+	dist[col] = 0;
+	vector <int> front (1, col);
+	grow (front);
+}
+
+void
+PlumeSet::grow (vector <int>& front) {
+	// columns which are new in the set; the ones in the front that were
+	// previously outside of the halo must be added too
+	vector <int> added;
+	for (size_t i = 0; i < front.size (); ++i) {
+		if (!binary_search (active.begin (), active.end (), front[i])) {
+			added.push_back (front[i]);
+		}
+	}
+
+	// breadth-first search from the front, one layer of columns at a
+	// time, stopping when the halo is wide enough. columns that already
+	// are closer to the plume through another path are not visited again
+	vector <int> next;
+	for (int d = 1; d <= halo && !front.empty (); ++d) {
+		next.clear ();
+		for (size_t i = 0; i < front.size (); ++i) {
+			const int col = front[i];
+			for (int pos = g.cell_facepos[col];
+			     pos != g.cell_facepos[col + 1]; ++pos) {
+				// the neighbour is the other cell of the face, if any
+				const int face = g.cell_faces[pos];
+				const int other = g.face_cells[2 * face + 0] == col
+				                ? g.face_cells[2 * face + 1]
+				                : g.face_cells[2 * face + 0];
+				if (other >= 0 && dist[other] > d) {
+					if (dist[other] > halo) {
+						added.push_back (other);
+					}
+					dist[other] = d;
+					next.push_back (other);
+				}
+			}
+		}
+		front.swap (next);
+	}
+
+	// keep the list of columns sorted, so that the columns are visited
+	// in the same order as they are stored
+	const size_t old_size = active.size ();
+	sort (added.begin (), added.end ());
+	active.insert (active.end (), added.begin (), added.end ());
+	inplace_merge (active.begin (), active.begin () + old_size, active.end ());
+}
@@ -0,0 +1,139 @@
+#ifndef OPM_VERTEQ_PLUME_HPP_INCLUDED
+#define OPM_VERTEQ_PLUME_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+/**
+ * Set of columns in the top surface where the saturation may change.
+ *
+ * The columns which have ever seen any CO2 make up the plume; besides
+ * these, only columns next to the plume can get CO2 during a timestep
+ * (when it satisfies the CFL condition). The set consists of the plume
+ * and a halo around it, a given number of faces wide. Columns outside
+ * of the set hold pure brine and do not have to be visited by the
+ * transport, the evaluation of properties or the downscaling.
+ *
+ * Since the plume is defined from the maximum saturation seen so far,
+ * the set never shrinks. An update only looks at the columns in the
+ * set. The timestep is not required to satisfy the CFL condition, so
+ * check with leaked() first whether the CO2 has gone past the halo, and
+ * if so, update the properties in every column and reset the set.
+ *
+ * @example
+ * @code{.cpp}
+ * PlumeSet plume (ts);
+ * plume.reset (props.max_sat ());
+ * ...
+ * if (plume.leaked (sat, 2, gas)) {
+ *     props.upd_res_sat (sat);
+ *     plume.reset (props.max_sat ());
+ * }
+ * else {
+ *     props.upd_res_sat (sat, plume.size (), plume.cols ());
+ *     plume.update (props.max_sat ());
+ * }
+ * @endcode
+ */
+class OPM_VERTEQ_PUBLIC PlumeSet {
+public:
+	/**
+	 * Create an empty set.
+	 *
+	 * @param g Top surface grid. This object is not adopted, but must be
+	 *          live over the lifetime of the set.
+	 * @param halo Number of columns outside of the plume (by following
+	 *             the faces) which are included in the set. If it is
+	 *             negative, all columns are always in the set.
+	 */
+	PlumeSet (const UnstructuredGrid& g, int halo = 1);
+
+	/**
+	 * Find the plume by looking at all the columns.
+	 *
+	 * @param max_sat Maximum CO2 saturation that has been seen in each
+	 *                column, as returned from VertEqProps::max_sat.
+	 */
+	void reset (const double* max_sat);
+
+	/**
+	 * Grow the set with columns in it where CO2 has arrived. Columns
+	 * outside of the set are not looked at.
+	 *
+	 * @param max_sat Maximum CO2 saturation that has been seen in each
+	 *                column, as returned from VertEqProps::max_sat. Only
+	 *                the values for the columns in the set are read.
+	 */
+	void update (const double* max_sat);
+
+	/**
+	 * Has the CO2 gone past the set in the last timestep?
+	 *
+	 * CO2 can only leave the set through the outermost columns of the
+	 * halo, and a column that CO2 has passed through has some left at the
+	 * end of an (implicit) step. Thus only the neighbours of those of the
+	 * outermost columns that have CO2 must be looked at.
+	 *
+	 * @param sat Saturation of each phase in each column, as in the
+	 *            coarse state.
+	 * @param num_phases Number of phases in each record of sat.
+	 * @param phase Index of the CO2 in each record.
+	 * @return True if there is CO2 next to the set, in which case the
+	 *         set must be found again with reset().
+	 */
+	bool leaked (const double* sat, int num_phases, int phase) const;
+
+	/**
+	 * Add a column to the plume even though there is no CO2 there yet,
+	 * e.g. because an injector is placed in it.
+	 */
+	void insert (int col);
+
+	/**
+	 * Number of columns in the set.
+	 */
+	int size () const { return static_cast <int> (active.size ()); }
+
+	/**
+	 * Indices of the columns in the set, in ascending order. The pointer
+	 * is invalidated by the next change to the set.
+	 */
+	const int* cols () const { return active.empty () ? 0 : &active[0]; }
+
+	/**
+	 * Is the column in the set?
+	 */
+	bool contains (int col) const { return dist[col] <= halo; }
+
+private:
+	const UnstructuredGrid& g;
+
+	// if every column is in the set, then the halo is as wide as the grid
+	const bool everything;
+	const int halo;
+
+	// number of faces to cross to get from the column to the plume, or
+	// more than the halo if the column is outside of the set
+	std::vector <int> dist;
+
+	// columns in the set, sorted
+	std::vector <int> active;
+
+	// extend the set from columns which have become part of the plume
+	void grow (std::vector <int>& front);
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_PLUME_HPP_INCLUDED */
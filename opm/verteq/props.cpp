@@ -2,21 +2,351 @@
 #include <opm/verteq/topsurf.hpp>
 #include <opm/verteq/upscale.hpp>
 #include <opm/verteq/utility/exc.hpp>
+#include <opm/verteq/utility/instrument.hpp>
 #include <opm/verteq/utility/runlen.hpp>
+#include <opm/verteq/utility/scratch.hpp>
 #include <opm/core/props/BlackoilPhases.hpp>
-#include <algorithm> // fill
+#include <algorithm> // binary_search, copy, fill, sort, unique
 #include <cmath> // sqrt
+#include <exception> // exception_ptr
 #include <memory> // unique_ptr
+#include <unordered_map>
 #include <vector>
 using namespace Opm;
 using namespace std;
 
+/**
+ * Keep the first exception thrown by any of the threads in a parallel
+ * loop, so that it can be rethrown once the loop is done. An exception
+ * must not escape from an OpenMP region; the program is terminated if
+ * it does.
+ */
+struct ThreadError {
+	exception_ptr error;
+
+	// call this from a catch handler
+	void store () {
+#ifdef _OPENMP
+#pragma omp critical (opm_verteq_thread_error)
+#endif /* _OPENMP */
+		if (!error) {
+			error = current_exception ();
+		}
+	}
+
+	// call this after the parallel region
+	void rethrow () const {
+		if (error) {
+			rethrow_exception (error);
+		}
+	}
+};
+
+// columns of the top surface, which the tables are organized after
+typedef rlw_int::ColumnIterator ColumnIterator;
+
+/**
+ * Buffers that hold intermediate values for a column while the tables
+ * for it are built. These are allocated once for the largest column and
+ * then reused.
+ */
+struct ColumnScratch {
+	static const int NUM_PHASES = 2;
+
+	vector <double> poro; // porosity
+	vector <double> kxx;  // abs.perm.
+	vector <double> kxy;
+	vector <double> kyy;
+	vector <double> sgr;   // residual CO2
+	vector <double> l_swr; // 1 - residual brine
+	vector <double> lkl;   // magnitude of abs.perm.; k_||
+
+	// saturations and rel.perms. of each phase, assuming maximum filling of...
+	vector <double> wat_sat; // brine; res. CO2
+	vector <double> gas_sat; // CO2; res. brine
+	vector <double> wat_mob; // k_r(S_c=S_{c,r})
+	vector <double> gas_mob; // k_r(S_c=1-S_{b,r})
+
+	// volume fractions and rel.perm. weights of a column which has no
+	// tables, because it is the same in every block
+	vector <double> res_gas;
+	vector <double> mob_mix;
+	vector <double> res_wat;
+	vector <double> prm_gas;
+	vector <double> prm_res;
+	vector <double> prm_wat;
+
+	// fine saturation and pore volume of CO2, when upscaling the state
+	vector <double> sg;
+	vector <double> pvg;
+
+	ColumnScratch (int max_vert_res)
+		: poro (max_vert_res, 0.)
+		, kxx (max_vert_res, 0.)
+		, kxy (max_vert_res, 0.)
+		, kyy (max_vert_res, 0.)
+		, sgr (max_vert_res * NUM_PHASES, 0.)
+		, l_swr (max_vert_res * NUM_PHASES, 0.)
+		, lkl (max_vert_res)
+		, wat_sat (max_vert_res * NUM_PHASES, 0.)
+		, gas_sat (max_vert_res * NUM_PHASES, 0.)
+		, wat_mob (max_vert_res * NUM_PHASES, 0.)
+		, gas_mob (max_vert_res * NUM_PHASES, 0.)
+		, res_gas (max_vert_res, 0.)
+		, mob_mix (max_vert_res, 0.)
+		, res_wat (max_vert_res, 0.)
+		, prm_gas (max_vert_res, 0.)
+		, prm_res (max_vert_res, 0.)
+		, prm_wat (max_vert_res, 0.)
+		, sg (max_vert_res, 0.)
+		, pvg (max_vert_res, 0.) {
+	}
+};
+
+namespace {
+
+/**
+ * Everything about a column that goes into its tables: the height, rock
+ * properties and saturation endpoints of each block, and the rel.perm.
+ * at those endpoints (which may differ between saturation regions even
+ * if the endpoints are the same).
+ *
+ * @param prof Receives the profile; the other vectors are scratch space
+ *             large enough for all phases of the largest column.
+ */
+void
+column_profile (const IncompPropertiesInterface& fp,
+                const TopSurf& ts,
+                const int col,
+                vector <double>& smin,
+                vector <double>& smax,
+                vector <double>& sat,
+                vector <double>& kr,
+                vector <double>& prof) {
+	// only the lateral components of the permeability are upscaled
+	static const int PERM_MATRIX_3D = 9;
+	static const int KXX_OFS_3D = 0;
+	static const int KXY_OFS_3D = 1;
+	static const int KYY_OFS_3D = 4;
+
+	const int num_phases = fp.numPhases ();
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	const int num_rows = col_cells.size (col);
+	const int* cells = col_cells[col];
+	const double* poro = fp.porosity ();
+	const double* perm = fp.permeability ();
+
+	prof.clear ();
+	for (int row = 0; row < num_rows; ++row) {
+		const int block = cells[row];
+		prof.push_back (dz[col][row]);
+		prof.push_back (poro[block]);
+		prof.push_back (perm[block * PERM_MATRIX_3D + KXX_OFS_3D]);
+		prof.push_back (perm[block * PERM_MATRIX_3D + KXY_OFS_3D]);
+		prof.push_back (perm[block * PERM_MATRIX_3D + KYY_OFS_3D]);
+	}
+
+	// saturation endpoints, and rel.perm. at each combination of one
+	// phase at its maximum and the others at their minimum (as in setup)
+	const int num_sats = num_rows * num_phases;
+	fp.satRange (num_rows, cells, &smin[0], &smax[0]);
+	prof.insert (prof.end (), smin.begin (), smin.begin () + num_sats);
+	prof.insert (prof.end (), smax.begin (), smax.begin () + num_sats);
+	for (int pick = 0; pick < num_phases; ++pick) {
+		for (int ndx = 0; ndx < num_sats; ++ndx) {
+			sat[ndx] = ndx % num_phases == pick ? smax[ndx] : smin[ndx];
+		}
+		fp.relperm (num_rows, &sat[0], cells, &kr[0], 0);
+		prof.insert (prof.end (), kr.begin (), kr.begin () + num_sats);
+	}
+}
+
+/**
+ * Hash of the bits of every value in a profile (FNV-1a). Equal values
+ * give equal hashes, except zeros of different sign, which are then
+ * just not recognized as the same.
+ */
+size_t
+hash_profile (const vector <double>& prof) {
+	const unsigned char* bytes = reinterpret_cast <const unsigned char*> (&prof[0]);
+	const size_t num_bytes = prof.size () * sizeof (double);
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < num_bytes; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return static_cast <size_t> (hash);
+}
+
+/**
+ * Whether every block in a profile from column_profile has the same
+ * properties as the top one; only the height of the blocks may differ.
+ * The volume fractions and rel.perm. weights are then the same all the
+ * way down, and their integrals are linear in depth.
+ */
+bool
+uniform_profile (const vector <double>& prof,
+                 const int num_rows,
+                 const int num_phases) {
+	// values that are stored for each block before the saturations
+	static const int NUM_ROCK = 5;
+
+	// rock properties, skipping the height which is first in each record
+	for (int row = 1; row < num_rows; ++row) {
+		for (int i = 1; i < NUM_ROCK; ++i) {
+			if (prof[row * NUM_ROCK + i] != prof[i]) {
+				return false;
+			}
+		}
+	}
+
+	// each of the sections with saturations and rel.perms. has a record
+	// with all the phases for each block
+	const int num_sats = num_rows * num_phases;
+	for (size_t sec = num_rows * NUM_ROCK; sec < prof.size (); sec += num_sats) {
+		for (int ndx = num_phases; ndx < num_sats; ++ndx) {
+			if (prof[sec + ndx] != prof[sec + ndx % num_phases]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Mark the columns in a list, or all of them if there is no list.
+ */
+vector <char>
+column_mask (const TopSurf& ts,
+             const int num_cols,
+             const int* cols) {
+	if (!cols) {
+		return vector <char> (ts.number_of_cells, 1);
+	}
+	vector <char> mask (ts.number_of_cells, 0);
+	for (int i = 0; i < num_cols; ++i) {
+		mask[cols[i]] = 1;
+	}
+	return mask;
+}
+
+/**
+ * Columns which have their own tables, by the hash of their profile.
+ */
+typedef unordered_multimap <size_t, int> owner_map;
+
+/**
+ * Find columns that will get the same tables, because everything that
+ * goes into them is the same.
+ *
+ * @param local Which columns to look at; the others are left on their
+ *              own and are never profiled.
+ * @param uniform Receives for each column whether its profile is the
+ *                same in every block, see uniform_profile.
+ * @param owners Receives the columns which have their own tables.
+ * @param keys Receives the hash of the profile of each local column.
+ * @return For each column, the first column which has the same profile
+ *         (which is the column itself if there is none before).
+ */
+vector <int>
+share_columns (const IncompPropertiesInterface& fp,
+               const TopSurf& ts,
+               const vector <char>& local,
+               vector <char>& uniform,
+               owner_map& owners,
+               vector <size_t>& keys) {
+	const int size = ts.max_vert_res * fp.numPhases ();
+	vector <double> smin (size), smax (size), sat (size), kr (size);
+	vector <double> prof, other;
+
+	vector <int> canon (ts.number_of_cells);
+	uniform.assign (ts.number_of_cells, 0);
+	keys.assign (ts.number_of_cells, 0);
+	owners.clear ();
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		canon[col] = col;
+		if (!local[col]) {
+			continue;
+		}
+		column_profile (fp, ts, col, smin, smax, sat, kr, prof);
+		const int num_rows = ts.col_cellpos[col + 1] - ts.col_cellpos[col];
+		uniform[col] = uniform_profile (prof, num_rows, fp.numPhases ());
+		keys[col] = hash_profile (prof);
+		// only the owners with the same hash are profiled again to compare
+		// with it, so that no profiles have to be kept (as in update)
+		const pair <owner_map::const_iterator, owner_map::const_iterator> same =
+			owners.equal_range (keys[col]);
+		for (owner_map::const_iterator it = same.first; it != same.second; ++it) {
+			column_profile (fp, ts, it->second, smin, smax, sat, kr, other);
+			if (other == prof) {
+				canon[col] = it->second;
+				break;
+			}
+		}
+		if (canon[col] == col) {
+			owners.insert (make_pair (keys[col], col));
+		}
+	}
+	return canon;
+}
+
+/**
+ * Starting index of each column in the tables, where only the local
+ * columns which have their own tables, and which are not uniform (and
+ * thus are evaluated without them), have any entries.
+ */
+vector <int>
+table_layout (const TopSurf& ts,
+              const vector <char>& local,
+              const vector <int>& canon,
+              const vector <char>& uniform) {
+	vector <int> pos (ts.number_of_cells + 1, 0);
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		const int num_rows = ts.col_cellpos[col + 1] - ts.col_cellpos[col];
+		const bool own = local[col] && canon[col] == col && !uniform[col];
+		pos[col + 1] = pos[col] + (own ? num_rows : 0);
+	}
+	return pos;
+}
+
+} // anonymous namespace
+
+/**
+ * Part of the implementation that is the same regardless of the order
+ * of the phases; this lets the tables of several realizations be built
+ * together even if they are not of the same instantiation.
+ */
+struct VertEqPropsBase : public VertEqProps {
+	/// Buffers of each thread, which are kept for all calls to this
+	/// object, so that the state can be transferred without allocating
+	ScratchArena <ColumnScratch> scratch;
+
+	VertEqPropsBase (int max_vert_res)
+		: scratch (max_vert_res) {
+	}
+
+	/**
+	 * Upscale rock properties and build the tables for one column.
+	 *
+	 * @param col Index of the column in the top surface.
+	 * @param buf Preallocated scratch space, large enough for any column.
+	 */
+	virtual void setup_column (const int col, ColumnScratch& buf) = 0;
+};
+
 /**
  * In this module, CO2 is referred to as the "gas" phase even though
  * it is in a supercritical state. This is just to keep an easily
  * identifiable moniker on the variables.
+ *
+ * The index of the CO2 phase is a template argument, so that the
+ * offsets into the arrays of each phase, and the signs that depend on
+ * the order, are constants in the loops over the cells. Which one of
+ * the instantiations to use is decided from the densities when the
+ * object is created.
  */
-struct VertEqPropsImpl : public VertEqProps {
+template <int GAS_PHASE>
+struct VertEqPropsImpl : public VertEqPropsBase {
 	/// Get the underlaying fluid information from here
 	const IncompPropertiesInterface& fp;
 
@@ -44,17 +374,106 @@ struct VertEqPropsImpl : public VertEqProps {
 	static const int KYX_OFS_2D = 1 * TWO_DIMS + 0; // (y, x), x = 0, y = 1
 	static const int KYY_OFS_2D = 1 * TWO_DIMS + 1; // (y, y), y = 1
 
-	// we assume this ordering of the phases in arrays. these used to be
-	// static, but they are now initialized from the phase properties
-	const int GAS; // = BlackoilPhases::Liquid;
-	const int WAT; // = BlackoilPhases::Aqua;
+	// we assume this ordering of the phases in arrays; it is given by
+	// the template argument, which is chosen from the phase properties
+	static const int GAS = GAS_PHASE; // = BlackoilPhases::Liquid;
+	static const int WAT = 1 - GAS;   // = BlackoilPhases::Aqua;
 	static const int NUM_PHASES = 2;
 	static const int NUM_PHASES_SQ = NUM_PHASES * NUM_PHASES;
 
 	/// Since Pc_ow = -Pc,wo and dS_o = -dS_w, we can query the capillary
 	/// pressure for only the first phase, and then adjust the sign to get
 	/// the rest.
-	const double phase_sign;
+	static const int PHASE_SIGN = GAS < WAT ? +1 : -1;
+
+	/// Number of tables that have an entry for each block
+	static const int NUM_TABLES = 12;
+
+	/// Values that are stored for a uniform column instead of the tables
+	enum {
+		UNI_RES_GAS,
+		UNI_MOB_MIX,
+		UNI_RES_WAT,
+		UNI_PRM_GAS,
+		UNI_PRM_RES,
+		UNI_PRM_WAT,
+		NUM_UNIFORM
+	};
+
+	/// Whether the tables of each column are set up by this object; if
+	/// the top surface is partitioned, the other columns have no entries
+	vector <char> local;
+
+	/// Whether each column has the same properties in every block. The
+	/// integrals are then linear in depth, so these columns have no
+	/// tables, and are evaluated from the values in uni_val instead.
+	vector <char> uniform;
+
+	/// Columns which have tables of their own, by the hash of the profile,
+	/// and the hash of each local column; a column which is changed later
+	/// is only compared with the owners that have the same hash
+	owner_map owners;
+	vector <size_t> keys;
+
+	/// Column whose tables are used for each column. Columns with the
+	/// same vertical profile all use the tables of the first of them;
+	/// the scalars below are still stored for each column.
+	vector <int> canon;
+
+	/// Ring of the columns in the same group as each column, i.e. which
+	/// use the same tables; a column that has no one to share with is
+	/// alone in its ring. This finds the group of a changed column
+	/// without looking at the other columns.
+	vector <int> peer_next;
+	vector <int> peer_prev;
+
+	/// Starting index of each column in the tables; the columns which use
+	/// the tables of another have no entries of their own
+	vector <int> tbl_pos;
+
+	/// Whether the tables of each column have been filled
+	vector <char> ready;
+
+	/// Volume fractions and rel.perm. weights of the uniform columns,
+	/// with NUM_UNIFORM values for each column (whether uniform or not)
+	vector <double> uni_val;
+
+	double uni (const int tc, const int what) const {
+		return uni_val[tc * NUM_UNIFORM + what];
+	}
+
+	/**
+	 * Integral of a property from the top down to an elevation, read
+	 * from its table, or computed directly if the column is uniform.
+	 *
+	 * @param tc Column that holds the tables.
+	 * @param dpt Table of the integral, from wgt_dpt.
+	 * @param what Which of the uniform values that is the same property.
+	 */
+	double integral (const int tc,
+	                 const rlw_double& dpt,
+	                 const int what,
+	                 const Elevation zeta) const {
+		return uniform[tc]
+			? up.eval_uniform (tc, uni (tc, what), zeta)
+			: up.eval (tc, dpt, zeta);
+	}
+
+	/**
+	 * Same as integral, but for the table of the property itself. Like
+	 * the table lookup, the value in the top block is interpolated from
+	 * zero.
+	 */
+	double property (const int tc,
+	                 const rlw_double& vol,
+	                 const int what,
+	                 const Elevation zeta) const {
+		if (uniform[tc]) {
+			const double val = uni (tc, what);
+			return zeta.block () == 0 ? val * zeta.fraction () : val;
+		}
+		return up.eval (tc, vol, zeta);
+	}
 
 	/// Upscaled porosity; this is \Phi in the papers
 	vector <double> upscaled_poro;   // 1/H * int_{\Zeta_B}^{\Zeta_T} \phi dz
@@ -72,6 +491,14 @@ struct VertEqPropsImpl : public VertEqProps {
 	RunLenData <double> mob_mix_dpt; // 1/H * int_{h}^{\zeta_T} \phi (1 - S_{w,r} - S_{n,r} dz
 	RunLenData <double> res_wat_dpt; // 1/H * int_{h}^{\zeta_T} \phi (1 - S_{w,r}) dz
 
+	/// Blocks with the same volume fractions merged into layers, and the
+	/// depth-fractions above at the bottom of each; these are only set if
+	/// the tables have been compressed, and are then used for the search
+	unique_ptr <ColumnLayers> layers;
+	unique_ptr <RunLenData <double> > res_gas_lyr;
+	unique_ptr <RunLenData <double> > mob_mix_lyr;
+	unique_ptr <RunLenData <double> > res_wat_lyr;
+
 	// we need to keep track of where the plume has been and deposited
 	// residual CO2. however, finding the interface is non-trivial and
 	// should only be done if we actually see a new maximum of the
@@ -92,6 +519,27 @@ struct VertEqPropsImpl : public VertEqProps {
 		}
 	}
 
+	virtual void upd_res_sat (const double* snap,
+	                          int num_cols,
+	                          const int* cols) {
+		// same as above, but only for the columns in the list
+		for (int i = 0; i < num_cols; ++i) {
+			const int col = cols[i];
+			const double cur_sat = snap[col * NUM_PHASES + GAS];
+			if (cur_sat > max_gas_sat[col]) {
+				max_gas_sat[col] = cur_sat;
+			}
+		}
+	}
+
+	virtual const double* max_sat () const {
+		return &max_gas_sat[0];
+	}
+
+	virtual void max_sat (const double* sat) {
+		copy (sat, sat + ts.number_of_cells, max_gas_sat.begin ());
+	}
+
 	/**
 	 * Find the elevation of the residual CO2 in this column based on the
 	 * maximum upscaled CO2 saturation.
@@ -112,8 +560,15 @@ struct VertEqPropsImpl : public VertEqProps {
 		// in the averaging operator stored)
 		const double max_vol = upscaled_poro[col] * max_sat;
 
-		// find the elevation which makes the integral have this value
-		const Elevation zeta_r = up.find (col, res_wat_dpt[col], max_vol);
+		// find the elevation which makes the integral have this value,
+		// in the tables of the column that this one shares them with
+		const int tc = canon[col];
+		if (uniform[tc]) {
+			return up.find_uniform (tc, uni (tc, UNI_RES_WAT), max_vol);
+		}
+		const Elevation zeta_r = layers
+			? up.find (tc, *layers, (*res_wat_lyr)[tc], max_vol)
+			: up.find (tc, res_wat_dpt[tc], max_vol);
 		return zeta_r;
 	}
 
@@ -144,12 +599,22 @@ struct VertEqPropsImpl : public VertEqProps {
 		// second is the integral int_{\zeta_R}^{\zeta_T} \phi s_{g,r} dz,
 		// representing the volume of residual CO2; the remainder becomes
 		// the mobile CO2 volume. the entire equation is multiplied by 1/H.
-		const double res_vol = up.eval (col, res_gas_dpt, res_lvl);
+		const int tc = canon[col];
+		const double res_vol = uniform[tc]
+			? up.eval_uniform (tc, uni (tc, UNI_RES_GAS), res_lvl)
+			: layers
+			? up.eval (tc, *layers, *res_gas_lyr, res_lvl)
+			: up.eval (tc, res_gas_dpt, res_lvl);
 		const double gas_vol = upscaled_poro[col] * gas_sat; // \Phi * S_g
 		const double mob_vol = gas_vol - res_vol;
 
 		// lookup to find the height that gives this mobile volume
-		const Elevation zeta_M = up.find (col, mob_mix_dpt[col], mob_vol);
+		if (uniform[tc]) {
+			return up.find_uniform (tc, uni (tc, UNI_MOB_MIX), mob_vol);
+		}
+		const Elevation zeta_M = layers
+			? up.find (tc, *layers, (*mob_mix_lyr)[tc], mob_vol)
+			: up.find (tc, mob_mix_dpt[tc], mob_vol);
 		return zeta_M;
 	}
 
@@ -184,38 +649,49 @@ struct VertEqPropsImpl : public VertEqProps {
 	// gravity in the z-direction; \nabla z \cdot \mathbf{g}
 	const double gravity;
 
+	/**
+	 * @param num_cols Number of columns in the list below.
+	 * @param cols Columns that get tables, or null for all of them.
+	 * @param deferred If true, the tables are allocated but not filled;
+	 *                 the caller must then call setup_column for each
+	 *                 column in the list before the object is used.
+	 */
 	VertEqPropsImpl (const IncompPropertiesInterface& fineProps,
 	                 const TopSurf& topSurf,
-	                 const double* grav_vec)
-		: fp (fineProps)
+	                 const double* grav_vec,
+	                 int num_cols = 0,
+	                 const int* cols = 0,
+	                 bool deferred = false)
+		: VertEqPropsBase (topSurf.max_vert_res)
+		, fp (fineProps)
 		, ts (topSurf)
 		, up (ts)
+		, local (column_mask (topSurf, num_cols, cols))
 
-		// assign which phase is which (e.g. CO2 is first, brine is second)
-		// a basic assumption of the vertical equilibrium is that the CO2 is
-		// the lightest phase and thus rise to the top of the reservoir
-		, GAS (fp.density()[0] < fp.density()[1] ? 0 : 1)
-		, WAT (1 - GAS)
-		, phase_sign (GAS < WAT ? +1. : -1.)
+		// find the columns that can share tables, before allocating them
+		, canon (share_columns (fineProps, topSurf, local, uniform, owners, keys))
+		, tbl_pos (table_layout (topSurf, local, canon, uniform))
+		, ready (ts.number_of_cells, 0)
+		, uni_val (ts.number_of_cells * NUM_UNIFORM, 0.)
 
 		// allocate memory for intermediate integrals
-		, res_gas_vol (ts.number_of_cells, ts.col_cellpos)
-		, mob_mix_vol (ts.number_of_cells, ts.col_cellpos)
-		, res_wat_vol (ts.number_of_cells, ts.col_cellpos)
-		, res_gas_dpt (ts.number_of_cells, ts.col_cellpos)
-		, mob_mix_dpt (ts.number_of_cells, ts.col_cellpos)
-		, res_wat_dpt (ts.number_of_cells, ts.col_cellpos)
+		, res_gas_vol (ts.number_of_cells, &tbl_pos[0])
+		, mob_mix_vol (ts.number_of_cells, &tbl_pos[0])
+		, res_wat_vol (ts.number_of_cells, &tbl_pos[0])
+		, res_gas_dpt (ts.number_of_cells, &tbl_pos[0])
+		, mob_mix_dpt (ts.number_of_cells, &tbl_pos[0])
+		, res_wat_dpt (ts.number_of_cells, &tbl_pos[0])
 
 		// assume that there is no initial plume; first notification will
 		// trigger an update of all columns where there actually is CO2
 		, max_gas_sat (ts.number_of_cells, 0.)
 
-		, prm_gas (ts.number_of_cells, ts.col_cellpos)
-		, prm_gas_int (ts.number_of_cells, ts.col_cellpos)
-		, prm_res (ts.number_of_cells, ts.col_cellpos)
-		, prm_res_int (ts.number_of_cells, ts.col_cellpos)
-		, prm_wat (ts.number_of_cells, ts.col_cellpos)
-		, prm_wat_int (ts.number_of_cells, ts.col_cellpos)
+		, prm_gas (ts.number_of_cells, &tbl_pos[0])
+		, prm_gas_int (ts.number_of_cells, &tbl_pos[0])
+		, prm_res (ts.number_of_cells, &tbl_pos[0])
+		, prm_res_int (ts.number_of_cells, &tbl_pos[0])
+		, prm_wat (ts.number_of_cells, &tbl_pos[0])
+		, prm_wat_int (ts.number_of_cells, &tbl_pos[0])
 		, gravity (grav_vec[THREE_DIMS - 1])	{
 
 		// check that we only have two phases
@@ -227,144 +703,488 @@ struct VertEqPropsImpl : public VertEqProps {
 		upscaled_poro.resize (ts.number_of_cells);
 		upscaled_absperm.resize (ts.number_of_cells * PERM_MATRIX_2D);
 
-		// buffers that holds intermediate values for each column;
-		// pre-allocate to avoid doing that inside the loop
-		vector <double> poro (ts.max_vert_res, 0.); // porosity
-		vector <double> kxx (ts.max_vert_res, 0.);  // abs.perm.
-		vector <double> kxy (ts.max_vert_res, 0.);
-		vector <double> kyy (ts.max_vert_res, 0.);
-		vector <double> sgr   (ts.max_vert_res * NUM_PHASES, 0.); // residual CO2
-		vector <double> l_swr (ts.max_vert_res * NUM_PHASES, 0.); // 1 - residual brine
-		vector <double> lkl (ts.max_vert_res); // magnitude of abs.perm.; k_||
-
-		// saturations and rel.perms. of each phase, assuming maximum filling of...
-		vector <double> wat_sat (ts.max_vert_res * NUM_PHASES, 0.); // brine; res. CO2
-		vector <double> gas_sat (ts.max_vert_res * NUM_PHASES, 0.); // CO2; res. brine
-		vector <double> wat_mob (ts.max_vert_res * NUM_PHASES, 0.); // k_r(S_c=S_{c,r})
-		vector <double> gas_mob (ts.max_vert_res * NUM_PHASES, 0.); // k_r(S_c=1-S_{b,r})
+		// link the columns that share tables into rings
+		peer_next.resize (ts.number_of_cells);
+		peer_prev.resize (ts.number_of_cells);
+		for (int col = 0; col < ts.number_of_cells; ++col) {
+			peer_next[col] = peer_prev[col] = col;
+		}
+		for (int col = 0; col < ts.number_of_cells; ++col) {
+			if (canon[col] != col) {
+				join_group (col, canon[col]);
+			}
+		}
 
-		// pointer to all porosities in the fine grid
-		const double* fine_poro = fp.porosity ();
-		const double* fine_perm = fp.permeability ();
+		// fill the tables unless the caller wants to do that himself
+		// (in a different order than column by column)
+		if (!deferred) {
+			setup_all ();
+		}
+	}
 
-		// upscale each column separately
+	/**
+	 * Fill the tables of all the columns.
+	 */
+	void setup_all () {
+		// upscale each column separately; the columns are independent
+		// so they are shared among the threads, if there are any
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const ColumnIterator first = col_cells.columns ().begin ();
+		const ColumnIterator last = col_cells.columns ().end ();
+		ThreadError err;
+		scratch.reserve ();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+		{
+			// buffers that holds intermediate values for each column
+			ColumnScratch& buf = scratch.local ();
+
+			// the columns which have tables of their own are done first, so
+			// that the ones sharing those only have to copy the scalars
+			for (int pass = 0; pass < 2; ++pass) {
+#ifdef _OPENMP
+#pragma omp for schedule (dynamic, 16)
+#endif /* _OPENMP */
+				for (ColumnIterator it = first; it < last; ++it) {
+					const int col = (*it).index ();
+					const bool owner = canon[col] == col;
+					if (!local[col]) {
+						continue;
+					}
+					try {
+						if (pass == 0 && owner) {
+							setup_column (col, buf);
+						}
+						else if (pass == 1 && !owner) {
+							share_column (col);
+						}
+					}
+					catch (...) {
+						err.store ();
+					}
+				}
+			}
+		}
+		err.rethrow ();
+	}
+
+	/**
+	 * Copy the upscaled rock properties of a column which shares the
+	 * tables of another; that one must be setup already.
+	 */
+	void share_column (const int col) {
+		const int tc = canon[col];
+		upscaled_poro[col] = upscaled_poro[tc];
+		copy (&upscaled_absperm[PERM_MATRIX_2D * tc],
+		      &upscaled_absperm[PERM_MATRIX_2D * (tc + 1)],
+		      &upscaled_absperm[PERM_MATRIX_2D * col]);
+	}
+
+	/**
+	 * Move the tables to a new layout, keeping the entries of the columns
+	 * that still have them.
+	 *
+	 * @param new_pos Starting index of each column in the new tables.
+	 * @param src Column whose current entries are moved to each column,
+	 *            or -1 if it gets new ones (to be filled by the caller).
+	 */
+	void relayout (vector <int>& new_pos, const vector <int>& src) {
+		// allocate all the new tables before replacing any of the old
+		vector <unique_ptr <RunLenData <double> > > fresh;
+		for (int i = 0; i < NUM_TABLES; ++i) {
+			fresh.push_back (unique_ptr <RunLenData <double> > (
+				new RunLenData <double> (ts.number_of_cells, &new_pos[0])));
+		}
+		RunLenData <double>* tables[NUM_TABLES] = {
+			&res_gas_vol, &mob_mix_vol, &res_wat_vol,
+			&res_gas_dpt, &mob_mix_dpt, &res_wat_dpt,
+			&prm_gas, &prm_gas_int, &prm_res,
+			&prm_res_int, &prm_wat, &prm_wat_int
+		};
 		for (int col = 0; col < ts.number_of_cells; ++col) {
-			// retrieve the fine porosities for this column only
-			up.gather (col, &poro[0], fine_poro, 1, 0);
-
-			// compute the depth-averaged value and store
-			upscaled_poro[col] = up.dpt_avg (col, &poro[0]);
-
-			// retrieve the fine abs. perm. for this column only
-			up.gather (col, &kxx[0], fine_perm, PERM_MATRIX_3D, KXX_OFS_3D);
-			up.gather (col, &kxy[0], fine_perm, PERM_MATRIX_3D, KXY_OFS_3D);
-			up.gather (col, &kyy[0], fine_perm, PERM_MATRIX_3D, KYY_OFS_3D);
-
-			// compute upscaled values for each dimension separately
-			const double up_kxx = up.dpt_avg (col, &kxx[0]);
-			const double up_kxy = up.dpt_avg (col, &kxy[0]);
-			const double up_kyy = up.dpt_avg (col, &kyy[0]);
-
-			// store back into the interleaved format required by the 2D
-			// simulator code (fetching a tensor at the time, probably)
-			// notice that we take advantage of the tensor being symmetric
-			// at the third line below
-			upscaled_absperm[PERM_MATRIX_2D * col + KXX_OFS_2D] = up_kxx;
-			upscaled_absperm[PERM_MATRIX_2D * col + KXY_OFS_2D] = up_kxy;
-			upscaled_absperm[PERM_MATRIX_2D * col + KYX_OFS_2D] = up_kxy;
-			upscaled_absperm[PERM_MATRIX_2D * col + KYY_OFS_2D] = up_kyy;
-
-			// contract each fine perm. to a scalar, used for weight later
-			for (int row = 0; row < up.num_rows (col); ++row) {
-				lkl[row] = magnitude (kxx[row], kxy[row], kyy[row]);
+			const int num = new_pos[col + 1] - new_pos[col];
+			if (num > 0 && src[col] >= 0) {
+				for (int i = 0; i < NUM_TABLES; ++i) {
+					const double* from = (*tables[i])[src[col]];
+					copy (from, from + num, (*fresh[i])[col]);
+				}
 			}
+		}
+		for (int i = 0; i < NUM_TABLES; ++i) {
+			tables[i]->swap (*fresh[i]);
+		}
 
-			// we only need the relative weight, so get the depth-averaged
-			// total weight, which we'll use to scale the weights below
-			const double tot_lkl = up.dpt_avg (col, &lkl[0]); // 1/K^{-1}
+		// swapping keeps the buffers, so the tables still refer to them
+		tbl_pos.swap (new_pos);
+	}
 
-			// query the fine properties for the residual saturations;
-			// notice that we implicitly get the brine saturation as the maximum
-			// allowable co2 saturation; now we've got the values we need, but
-			// only every other item (due to that both phases are stored)
-			const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
-			fp.satRange (col_cells.size (col), col_cells[col], &sgr[0], &l_swr[0]);
-
-			// cache pointers to this particular column to avoid recomputing
-			// the starting point for each and every item
-			double* res_gas_col = res_gas_vol[col];
-			double* mob_mix_col = mob_mix_vol[col];
-			double* res_wat_col = res_wat_vol[col];
-
-			for (int row = 0; row < col_cells.size (col); ++row) {
-				// multiply with num_phases because the saturations for *both*
-				// phases are store consequtively (as a record); we only need
-				// the residuals framed as co2 saturations
-				const double sgr_ = sgr[row * NUM_PHASES + GAS];
-				const double l_swr_ = l_swr[row * NUM_PHASES + GAS];
-
-				// portions of the block that are filled with: residual co2,
-				// mobile fluid and residual brine, respectively
-				res_gas_col[row] = poro[row] * sgr_;            // \phi*S_{n,r}
-				mob_mix_col[row] = poro[row] * (l_swr_ - sgr_); // \phi*(1-S_{w,r}-S_{n_r})
-				res_wat_col[row] = poro[row] * l_swr_;          // \phi*(1-S_{w,r}
+	virtual size_t table_bytes () const {
+		return NUM_TABLES * tbl_pos[ts.number_of_cells] * sizeof (double)
+		     + (canon.size () + peer_next.size () + peer_prev.size ()
+		        + tbl_pos.size ()) * sizeof (int)
+		     + (local.size () + uniform.size ()) * sizeof (char)
+		     + keys.size () * sizeof (size_t)
+		     + owners.size () * sizeof (owner_map::value_type)
+		     + uni_val.size () * sizeof (double);
+	}
+
+	virtual size_t shared_bytes () const {
+		// what the tables would take with an entry for every local block
+		size_t num_blocks = 0;
+		for (int col = 0; col < ts.number_of_cells; ++col) {
+			if (local[col]) {
+				num_blocks += ts.col_cellpos[col + 1] - ts.col_cellpos[col];
+			}
+		}
+		const size_t unshared = NUM_TABLES * sizeof (double) * num_blocks;
+		const size_t used = table_bytes ();
+		return unshared > used ? unshared - used : 0;
+	}
+
+	virtual void setup_column (const int col, ColumnScratch& buf) {
+		// columns with the same profile as another get the same values,
+		// so only fill the tables of that one (if not done already)
+		const int tc = canon[col];
+		if (tc != col) {
+			if (!ready[tc]) {
+				setup_column (tc, buf);
 			}
+			share_column (col);
+			return;
+		}
+
+		// short-hand names for the buffers
+		vector <double>& poro = buf.poro;
+		vector <double>& kxx = buf.kxx;
+		vector <double>& kxy = buf.kxy;
+		vector <double>& kyy = buf.kyy;
+		vector <double>& sgr = buf.sgr;
+		vector <double>& l_swr = buf.l_swr;
+		vector <double>& lkl = buf.lkl;
+		vector <double>& wat_sat = buf.wat_sat;
+		vector <double>& gas_sat = buf.gas_sat;
+		vector <double>& wat_mob = buf.wat_mob;
+		vector <double>& gas_mob = buf.gas_mob;
+
+		// pointer to all porosities in the fine grid
+		const double* fine_poro = fp.porosity ();
+		const double* fine_perm = fp.permeability ();
+
+		// retrieve the fine porosities for this column only
+		up.gather (col, &poro[0], fine_poro, 1, 0);
+
+		// compute the depth-averaged value and store
+		upscaled_poro[col] = up.dpt_avg (col, &poro[0]);
+
+		// retrieve the fine abs. perm. for this column only
+		up.gather (col, &kxx[0], fine_perm, PERM_MATRIX_3D, KXX_OFS_3D);
+		up.gather (col, &kxy[0], fine_perm, PERM_MATRIX_3D, KXY_OFS_3D);
+		up.gather (col, &kyy[0], fine_perm, PERM_MATRIX_3D, KYY_OFS_3D);
+
+		// compute upscaled values for each dimension separately
+		const double up_kxx = up.dpt_avg (col, &kxx[0]);
+		const double up_kxy = up.dpt_avg (col, &kxy[0]);
+		const double up_kyy = up.dpt_avg (col, &kyy[0]);
+
+		// store back into the interleaved format required by the 2D
+		// simulator code (fetching a tensor at the time, probably)
+		// notice that we take advantage of the tensor being symmetric
+		// at the third line below
+		upscaled_absperm[PERM_MATRIX_2D * col + KXX_OFS_2D] = up_kxx;
+		upscaled_absperm[PERM_MATRIX_2D * col + KXY_OFS_2D] = up_kxy;
+		upscaled_absperm[PERM_MATRIX_2D * col + KYX_OFS_2D] = up_kxy;
+		upscaled_absperm[PERM_MATRIX_2D * col + KYY_OFS_2D] = up_kyy;
+
+		// contract each fine perm. to a scalar, used for weight later
+		for (int row = 0; row < up.num_rows (col); ++row) {
+			lkl[row] = magnitude (kxx[row], kxy[row], kyy[row]);
+		}
+
+		// we only need the relative weight, so get the depth-averaged
+		// total weight, which we'll use to scale the weights below
+		const double tot_lkl = up.dpt_avg (col, &lkl[0]); // 1/K^{-1}
 
-			// weight the relative depth factor (how close are we towards a
-			// completely filled column) with the volume portions. this call
-			// to up.wgt_dpt is the same as 1/H int_{h}^{\Zeta_T} ... dz
+		// query the fine properties for the residual saturations;
+		// notice that we implicitly get the brine saturation as the maximum
+		// allowable co2 saturation; now we've got the values we need, but
+		// only every other item (due to that both phases are stored)
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		fp.satRange (col_cells.size (col), col_cells[col], &sgr[0], &l_swr[0]);
+
+		// cache pointers to this particular column to avoid recomputing
+		// the starting point for each and every item. a uniform column has
+		// no tables, so its values are put in the buffers instead, and only
+		// those of the top block are kept
+		const bool uni_col = uniform[col] != 0;
+		double* res_gas_col = uni_col ? &buf.res_gas[0] : res_gas_vol[col];
+		double* mob_mix_col = uni_col ? &buf.mob_mix[0] : mob_mix_vol[col];
+		double* res_wat_col = uni_col ? &buf.res_wat[0] : res_wat_vol[col];
+
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			// multiply with num_phases because the saturations for *both*
+			// phases are store consequtively (as a record); we only need
+			// the residuals framed as co2 saturations
+			const double sgr_ = sgr[row * NUM_PHASES + GAS];
+			const double l_swr_ = l_swr[row * NUM_PHASES + GAS];
+
+			// portions of the block that are filled with: residual co2,
+			// mobile fluid and residual brine, respectively
+			res_gas_col[row] = poro[row] * sgr_;            // \phi*S_{n,r}
+			mob_mix_col[row] = poro[row] * (l_swr_ - sgr_); // \phi*(1-S_{w,r}-S_{n_r})
+			res_wat_col[row] = poro[row] * l_swr_;          // \phi*(1-S_{w,r}
+		}
+
+		// weight the relative depth factor (how close are we towards a
+		// completely filled column) with the volume portions. this call
+		// to up.wgt_dpt is the same as 1/H int_{h}^{\Zeta_T} ... dz
+		if (!uni_col) {
 			up.wgt_dpt (col, &res_gas_col[0], res_gas_dpt);
 			up.wgt_dpt (col, &mob_mix_col[0], mob_mix_dpt);
 			up.wgt_dpt (col, &res_wat_col[0], res_wat_dpt);
+		}
 
-			// now, when we queried the saturation ranges, we got back the min.
-			// and max. sat., and when there is min. of one, then there should
-			// be max. of the other; however, these data are in different arrays!
-			// cross-pick such that we get (min CO2, max brine), (max CO2, min brine)
-			// instead of (min CO2, min brine), (max CO2, max brine). this code
-			// has no other effect than to satisfy the ordering of items required
-			// for the relperm() call
-			for (int row = 0; row < col_cells.size (col); ++row) {
-				wat_sat[row * NUM_PHASES + GAS] = sgr[row * NUM_PHASES + GAS];
-				wat_sat[row * NUM_PHASES + WAT] = l_swr[row * NUM_PHASES + WAT];
-				gas_sat[row * NUM_PHASES + GAS] = l_swr[row * NUM_PHASES + GAS];
-				gas_sat[row * NUM_PHASES + WAT] = sgr[row * NUM_PHASES + WAT];
-			}
+		// now, when we queried the saturation ranges, we got back the min.
+		// and max. sat., and when there is min. of one, then there should
+		// be max. of the other; however, these data are in different arrays!
+		// cross-pick such that we get (min CO2, max brine), (max CO2, min brine)
+		// instead of (min CO2, min brine), (max CO2, max brine). this code
+		// has no other effect than to satisfy the ordering of items required
+		// for the relperm() call
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			wat_sat[row * NUM_PHASES + GAS] = sgr[row * NUM_PHASES + GAS];
+			wat_sat[row * NUM_PHASES + WAT] = l_swr[row * NUM_PHASES + WAT];
+			gas_sat[row * NUM_PHASES + GAS] = l_swr[row * NUM_PHASES + GAS];
+			gas_sat[row * NUM_PHASES + WAT] = sgr[row * NUM_PHASES + WAT];
+		}
 
-			// get rel.perm. for those cases where one phase is (maximally) mobile
-			// and the other one is immobile (at residual saturation); we get back
-			// rel.perm. for both phases, although only one of them is of interest
-			// for us (the other one should be zero). we have no interest in the
-			// derivative of the fine-scale rel.perm.
-			fp.relperm (col_cells.size (col), &wat_sat[0], col_cells[col], &wat_mob[0], 0);
-			fp.relperm (col_cells.size (col), &gas_sat[0], col_cells[col], &gas_mob[0], 0);
-
-			// cache the pointers here to avoid indexing in the loop
-			double* prm_gas_col = prm_gas[col];
-			double* prm_res_col = prm_res[col];
-			double* prm_wat_col = prm_wat[col];
-
-			for (int row = 0; row < up.num_rows (col); ++row) {
-				// rel.perm. for CO2 when having maximal sat. (only residual brine); this
-				// is the rel.perm. for the CO2 that is in the plume
-				const double kr_plume = gas_mob[row * NUM_PHASES + GAS];
-
-				// rel.perm. of brine, when residual CO2
-				const double kr_brine = wat_mob[row + NUM_PHASES + WAT];
-
-				// upscaled rel. perm. change for this block; we'll use this to weight
-				// the depth fractions when we integrate to get the upscaled rel. perm.
-				const double k_factor = lkl[row] / tot_lkl;
-				prm_gas_col[row] = k_factor * kr_plume;
-				prm_wat_col[row] = k_factor * kr_brine;
-				prm_res_col[row] = k_factor * (1 - kr_brine);
-			}
+		// get rel.perm. for those cases where one phase is (maximally) mobile
+		// and the other one is immobile (at residual saturation); we get back
+		// rel.perm. for both phases, although only one of them is of interest
+		// for us (the other one should be zero). we have no interest in the
+		// derivative of the fine-scale rel.perm.
+		fp.relperm (col_cells.size (col), &wat_sat[0], col_cells[col], &wat_mob[0], 0);
+		fp.relperm (col_cells.size (col), &gas_sat[0], col_cells[col], &gas_mob[0], 0);
+
+		// cache the pointers here to avoid indexing in the loop
+		double* prm_gas_col = uni_col ? &buf.prm_gas[0] : prm_gas[col];
+		double* prm_res_col = uni_col ? &buf.prm_res[0] : prm_res[col];
+		double* prm_wat_col = uni_col ? &buf.prm_wat[0] : prm_wat[col];
+
+		for (int row = 0; row < up.num_rows (col); ++row) {
+			// rel.perm. for CO2 when having maximal sat. (only residual brine); this
+			// is the rel.perm. for the CO2 that is in the plume
+			const double kr_plume = gas_mob[row * NUM_PHASES + GAS];
+
+			// rel.perm. of brine, when residual CO2
+			const double kr_brine = wat_mob[row * NUM_PHASES + WAT];
+
+			// upscaled rel. perm. change for this block; we'll use this to weight
+			// the depth fractions when we integrate to get the upscaled rel. perm.
+			const double k_factor = lkl[row] / tot_lkl;
+			prm_gas_col[row] = k_factor * kr_plume;
+			prm_wat_col[row] = k_factor * kr_brine;
+			prm_res_col[row] = k_factor * (1 - kr_brine);
+		}
 
-			// integrate the derivate to get the upscaled rel. perm.
+		// integrate the derivate to get the upscaled rel. perm.; for a
+		// uniform column the integrals are just the values times the depth
+		if (uni_col) {
+			double* val = &uni_val[col * NUM_UNIFORM];
+			val[UNI_RES_GAS] = res_gas_col[0];
+			val[UNI_MOB_MIX] = mob_mix_col[0];
+			val[UNI_RES_WAT] = res_wat_col[0];
+			val[UNI_PRM_GAS] = prm_gas_col[0];
+			val[UNI_PRM_RES] = prm_res_col[0];
+			val[UNI_PRM_WAT] = prm_wat_col[0];
+		}
+		else {
 			up.wgt_dpt (col, prm_gas_col, prm_gas_int);
 			up.wgt_dpt (col, prm_wat_col, prm_wat_int);
 			up.wgt_dpt (col, prm_res_col, prm_res_int);
 		}
+		ready[col] = 1;
+	}
+
+	/**
+	 * Remove a column from the list of owners.
+	 */
+	void erase_owner (const int col) {
+		const pair <owner_map::iterator, owner_map::iterator> same =
+			owners.equal_range (keys[col]);
+		for (owner_map::iterator it = same.first; it != same.second; ++it) {
+			if (it->second == col) {
+				owners.erase (it);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * Add a column which is alone in its ring to the group of another.
+	 */
+	void join_group (const int col, const int tc) {
+		const int last = peer_prev[tc];
+		peer_next[last] = col;
+		peer_prev[col] = last;
+		peer_next[col] = tc;
+		peer_prev[tc] = col;
+	}
+
+	/**
+	 * Take a column out of the ring of its group.
+	 */
+	void leave_group (const int col) {
+		peer_next[peer_prev[col]] = peer_next[col];
+		peer_prev[peer_next[col]] = peer_prev[col];
+		peer_next[col] = peer_prev[col] = col;
+	}
+
+	/**
+	 * Whether a column has entries of its own in the tables.
+	 */
+	bool own_entries (const int col) const {
+		return local[col] && canon[col] == col && !uniform[col];
+	}
+
+	virtual void update (const int num_cells, const int* cells) {
+		// list each column that has at least one changed cell once, in
+		// order; it is enough to rebuild a column once regardless of how
+		// many of its cells have changed. columns that this object has no
+		// tables for are left for the process that has them
+		vector <int> changed;
+		changed.reserve (num_cells);
+		for (int i = 0; i < num_cells; ++i) {
+			const int col = ts.fine_col[cells[i]];
+			if (local[col]) {
+				changed.push_back (col);
+			}
+		}
+		sort (changed.begin (), changed.end ());
+		changed.erase (unique (changed.begin (), changed.end ()), changed.end ());
+		const int num_changed = static_cast <int> (changed.size ());
+
+		// the layout of the tables only has to be redone if some column
+		// gets or loses entries of its own
+		vector <char> had_entries (num_changed);
+		for (int i = 0; i < num_changed; ++i) {
+			had_entries[i] = own_entries (changed[i]);
+		}
+		bool relaid = false;
+
+		// the columns that shared the tables of a changed column get the
+		// first of them that is unchanged as their new owner, which takes
+		// over the current entries (they were made from the same profile)
+		vector <pair <int, int> > heirs;
+		for (int i = 0; i < num_changed; ++i) {
+			const int col = changed[i];
+			if (canon[col] == col) {
+				erase_owner (col);
+				int heir = -1;
+				for (int peer = peer_next[col]; peer != col; peer = peer_next[peer]) {
+					if (binary_search (changed.begin (), changed.end (), peer)) {
+						continue;
+					}
+					if (heir < 0) {
+						heir = peer;
+						owners.insert (make_pair (keys[heir], heir));
+						copy (&uni_val[col * NUM_UNIFORM], &uni_val[(col + 1) * NUM_UNIFORM],
+						      &uni_val[heir * NUM_UNIFORM]);
+						heirs.push_back (make_pair (heir, col));
+						relaid = relaid || !uniform[heir];
+					}
+					canon[peer] = heir;
+				}
+			}
+			leave_group (col);
+			canon[col] = col;
+		}
+
+		// find the group of each changed column from its new profile; only
+		// the owners with the same hash are profiled to compare with it
+		const int size = ts.max_vert_res * fp.numPhases ();
+		vector <double> smin (size), smax (size), sat (size), kr (size);
+		vector <double> prof, other;
+		for (int i = 0; i < num_changed; ++i) {
+			const int col = changed[i];
+			column_profile (fp, ts, col, smin, smax, sat, kr, prof);
+			uniform[col] = uniform_profile (prof, up.num_rows (col), fp.numPhases ());
+			keys[col] = hash_profile (prof);
+			const pair <owner_map::const_iterator, owner_map::const_iterator> same =
+				owners.equal_range (keys[col]);
+			for (owner_map::const_iterator it = same.first; it != same.second; ++it) {
+				column_profile (fp, ts, it->second, smin, smax, sat, kr, other);
+				if (other == prof) {
+					canon[col] = it->second;
+					join_group (col, it->second);
+					break;
+				}
+			}
+			if (canon[col] == col) {
+				owners.insert (make_pair (keys[col], col));
+			}
+			ready[col] = 0;
+			relaid = relaid || (own_entries (col) != static_cast <bool> (had_entries[i]));
+		}
+
+		// columns which get or lose tables of their own, or become uniform,
+		// change the layout; the entries of the unchanged owners are moved
+		// over, and the heirs get those of the column they inherited from
+		if (relaid) {
+			vector <int> new_pos = table_layout (ts, local, canon, uniform);
+			vector <int> src (ts.number_of_cells, -1);
+			for (int col = 0; col < ts.number_of_cells; ++col) {
+				if (canon[col] == col) {
+					src[col] = col;
+				}
+			}
+			for (int i = 0; i < num_changed; ++i) {
+				src[changed[i]] = -1;
+			}
+			for (size_t i = 0; i < heirs.size (); ++i) {
+				src[heirs[i].first] = heirs[i].second;
+			}
+			relayout (new_pos, src);
+		}
+
+		// rebuild the changed columns, in order, reusing the buffers
+		scratch.reserve ();
+		ColumnScratch& buf = scratch.local ();
+		for (int i = 0; i < num_changed; ++i) {
+			setup_column (changed[i], buf);
+		}
+
+		// the layers may have been split or merged by the change
+		if (layers) {
+			compress_layers ();
+		}
+	}
+
+	virtual void compress_layers () {
+		// the search tables are integrals of the volume fractions, so
+		// those are what must be the same throughout a layer
+		vector <const RunLenView <double>*> vols;
+		vols.push_back (&res_gas_vol);
+		vols.push_back (&mob_mix_vol);
+		vols.push_back (&res_wat_vol);
+		unique_ptr <ColumnLayers> lyr (new ColumnLayers (ts, vols));
+
+		// allocate tables with one entry per layer, and fill them from
+		// the ones with an entry per block
+		const int num_cols = ts.number_of_cells;
+		int* const pos = &lyr->col_layerpos[0];
+		unique_ptr <RunLenData <double> > res_gas (new RunLenData <double> (num_cols, pos));
+		unique_ptr <RunLenData <double> > mob_mix (new RunLenData <double> (num_cols, pos));
+		unique_ptr <RunLenData <double> > res_wat (new RunLenData <double> (num_cols, pos));
+		lyr->compress (res_gas_dpt, *res_gas);
+		lyr->compress (mob_mix_dpt, *mob_mix);
+		lyr->compress (res_wat_dpt, *res_wat);
+
+		// switch over only when everything is in place
+		res_gas_lyr = move (res_gas);
+		mob_mix_lyr = move (mob_mix);
+		res_wat_lyr = move (res_wat);
+		layers = move (lyr);
 	}
 
 	/* rock properties; use volume-weighted averages */
@@ -413,10 +1233,16 @@ struct VertEqPropsImpl : public VertEqProps {
 	                      const int *cells,
 	                      double *kr,
 	                      double *dkrds) const {
+		OPM_VERTEQ_TIMED (RELPERM);
+		OPM_VERTEQ_COUNT (bytes, n * (sizeof (int) + sizeof (double) *
+		                  (2 * NUM_PHASES + (dkrds ? NUM_PHASES_SQ : 0))));
+
 		// process each column/cell individually
 		for (int i = 0; i < n; ++i) {
-			// index (into the upscaled grid) of the column
+			// index (into the upscaled grid) of the column, and of the
+			// column that holds the tables for it
 			const int col = cells[i];
+			const int tc = canon[col];
 
 			// get the (upscaled) CO2 saturation
 			const double Sg = s[i * NUM_PHASES + GAS];
@@ -426,7 +1252,7 @@ struct VertEqPropsImpl : public VertEqProps {
 
 			// rel.perm. for CO2 at this location; simply look up in the
 			// table of integrated rel.perm. changes by depth
-			const double Krg = up.eval (col, prm_gas_int, intf);
+			const double Krg = integral (tc, prm_gas_int, UNI_PRM_GAS, intf);
 
 			// registered level of maximum CO2 sat. (where there is at least
 			// residual CO2
@@ -434,8 +1260,8 @@ struct VertEqPropsImpl : public VertEqProps {
 
 			// rel.perm. for brine at this location; notice that all of
 			// our expressions uses the CO2 saturation as parameter
-			const double Krw = 1 - (up.eval (col, prm_res_int, res_lvl)
-			                       +up.eval (col, prm_wat_int, intf));
+			const double Krw = 1 - (integral (tc, prm_res_int, UNI_PRM_RES, res_lvl)
+			                       +integral (tc, prm_wat_int, UNI_PRM_WAT, intf));
 
 			// assign to output
 			kr[i * NUM_PHASES + GAS] = Krg;
@@ -444,16 +1270,16 @@ struct VertEqPropsImpl : public VertEqProps {
 			// was derivatives requested?
 			if (dkrds) {
 				// volume available for the mobile liquid/gas: \phi (1-s_{w,r}-s_{g,r})
-				const double mob_vol = up.eval (col, mob_mix_vol, intf);
+				const double mob_vol = property (tc, mob_mix_vol, UNI_MOB_MIX, intf);
 
 				// rel.perm. change for CO2: K^{-1} k_|| k_{r,g}(1-s_{w,r})
-				const double prm_chg_gas = up.eval (col, prm_gas, intf);
+				const double prm_chg_gas = property (tc, prm_gas, UNI_PRM_GAS, intf);
 
 				// possible change in CO2 rel.perm.
 				const double dKrg_dSg = upscaled_poro[col] / mob_vol * prm_chg_gas;
 
 				// rel.perm. change for brine: K^{-1} k_|| k_{r,w}(s_{g,r})
-				const double prm_chg_wat = up.eval (col, prm_wat, intf);
+				const double prm_chg_wat = property (tc, prm_wat, UNI_PRM_WAT, intf);
 
 				// possible change in brine rel.perm.
 				const double dKrw_dSg = -upscaled_poro[col] / mob_vol * prm_chg_wat;
@@ -474,6 +1300,10 @@ struct VertEqPropsImpl : public VertEqProps {
 	                       const int *cells,
 	                       double *pc,
 	                       double *dpcds) const {
+		OPM_VERTEQ_TIMED (CAP_PRESS);
+		OPM_VERTEQ_COUNT (bytes, n * (sizeof (int) + sizeof (double) *
+		                  (2 * NUM_PHASES + (dpcds ? NUM_PHASES_SQ : 0))));
+
 		// cache this on the outside of the loop; the phase properties
 		// are the same in every block
 		const double dens_gas = density ()[GAS];
@@ -488,8 +1318,10 @@ struct VertEqPropsImpl : public VertEqProps {
 
 		// process each column/cell individually
 		for (int i = 0; i < n; ++i) {
-			// index (into the upscaled grid) of the column
+			// index (into the upscaled grid) of the column, and of the
+			// column that holds the tables for it
 			const int col = cells[i];
+			const int tc = canon[col];
 
 			// get the (upscaled) CO2 saturation
 			const double Sg = s[i * NUM_PHASES + GAS];
@@ -528,19 +1360,19 @@ struct VertEqPropsImpl : public VertEqProps {
 
 			// total capillary pressure. the fine scale entry pressure is
 			// a wedge between the slopes of the hydrostatic pressures.
-			const double fine_pc_GAS = phase_sign * fine_pc[0];
+			const double fine_pc_GAS = PHASE_SIGN * fine_pc[0];
 			const double cap_pres = fine_pc_GAS + hyd_diff;
 
 			// assign to output; only the first phase is set, the other should
 			// be set to zero (?), see method SimpleFluid2pWrappingProps::pc in
 			// opm/core/transport/implicit/SimpleFluid2pWrappingProps_impl.hpp
-			pc[i * NUM_PHASES + 0] = phase_sign * cap_pres;
+			pc[i * NUM_PHASES + 0] = PHASE_SIGN * cap_pres;
 			pc[i * NUM_PHASES + 1] = 0.;
 
 			// interested in the derivatives of the capillary pressure as well?
 			if (dpcds) {
 				// volume available for the mobile liquid/gas: \phi (1-s_{w,r}-s_{g,r})
-				const double mob_vol = up.eval (col, mob_mix_vol, intf);
+				const double mob_vol = property (tc, mob_mix_vol, UNI_MOB_MIX, intf);
 
 				// change of interface height per of upscaled saturation; d\zeta_M/dS
 				const double dh_dSg = -(ts.h_tot[col] * upscaled_poro[col]) / mob_vol;
@@ -565,7 +1397,7 @@ struct VertEqPropsImpl : public VertEqProps {
 				// (saturation) and the major index designates the numerator (rel.perm.)
 				// here too (like for pc) only the first phase is set, the others should
 				// have the magic value zero hard-coded (?)
-				dpcds[i * NUM_PHASES_SQ + NUM_PHASES * 0 + 0] = phase_sign * dPc_dSg;
+				dpcds[i * NUM_PHASES_SQ + NUM_PHASES * 0 + 0] = PHASE_SIGN * dPc_dSg;
 				dpcds[i * NUM_PHASES_SQ + NUM_PHASES * 0 + 1] = 0.;
 				dpcds[i * NUM_PHASES_SQ + NUM_PHASES * 1 + 0] = 0.;
 				dpcds[i * NUM_PHASES_SQ + NUM_PHASES * 1 + 1] = 0.;
@@ -589,15 +1421,18 @@ struct VertEqPropsImpl : public VertEqProps {
 		static_cast <void> (cells);
 	}
 
-	virtual void upscale_pressure (const double* coarseSaturation,
-	                               const double* finePressure,
-	                               double* coarsePressure) {
+	/**
+	 * Upscale the pressure of a single column.
+	 */
+	void upscale_pres_col (const int col,
+	                       const double* coarseSaturation,
+	                       const double* finePressure,
+	                       double* coarsePressure) const {
 		// pressure locations we'll have to relate to
 		static const int    FIRST_BLOCK = 0;    // relative index in the column
 		static const double HALFWAY     = 0.5;  // center of the block
 
 		// incompressible means that the density is the same everywhere
-		// we can thus cache the phase properties outside of the loop
 		const double gas_dens = density ()[GAS];
 		const double wat_dens = density ()[WAT];
 
@@ -606,85 +1441,251 @@ struct VertEqPropsImpl : public VertEqProps {
 		const rlw_double ts_dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
 		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
 
+		// location of the brine-co2 phase contact
+		const double gas_sat = coarseSaturation[col * NUM_PHASES + GAS];
+		const Elevation& intf_lvl = intf_elev (col, gas_sat);
+
+		// what fraction of the first block from the pressure point (halfway)
+		// up to the top surface is of each of the phases? if the interface
+		// is below the first block, or if it is further down than halfway,
+		// then everything, otherwise the fraction (less than 0.5)
+		double gas_frac = (intf_lvl.block () == FIRST_BLOCK) ?
+			min (HALFWAY, intf_lvl.fraction ()) : HALFWAY;
+
+		// id of the upper-most block of this column. if there is no
+		// blocks, then the TopSurf object wouldn't generate a column.
+		const int block_id = col_cells[col][FIRST_BLOCK];
+
+		// height of the uppermost block (twice the distance from the top
+		// to the center
+		const double hgt = ts_dz[col][FIRST_BLOCK];
+
+		// get the pressure in the middle of this block
+		const double mid_pres = finePressure[block_id];
+
+		// pressure at the reference point; adjust hydrostatically for
+		// those phases that are on the way up from the center of the first
+		// block in the column.
+		const double ref_pres = mid_pres - gravity * hgt *
+		    (gas_frac * gas_dens + (HALFWAY - gas_frac) * wat_dens);
+
+		// Eclipse uses non-aquous pressure (see Variable Sets in Formulation
+		// of the Equations in the Technical Description) as the main unknown
+		// in the pressure equation; there is assumed continuity at the
+		// contact, so the pressure at the top should always be a CO2 pressure
+		coarsePressure[col] = ref_pres;
+	}
+
+	virtual void upscale_pressure (const double* coarseSaturation,
+	                               const double* finePressure,
+	                               double* coarsePressure) {
 		// upscale each column separately. assume that something like the
 		// EQUIL keyword has been used in the Eclipse file and that the
 		// pressures are already in equilibrium. thus, we only need to
 		// extract the pressure at the reference point (top surface)
-		for (int col = 0; col < col_cells.cols (); ++col) {
-			// location of the brine-co2 phase contact
-			const double gas_sat = coarseSaturation[col * NUM_PHASES + GAS];
-			const Elevation& intf_lvl = intf_elev (col, gas_sat);
-
-			// what fraction of the first block from the pressure point (halfway)
-			// up to the top surface is of each of the phases? if the interface
-			// is below the first block, or if it is further down than halfway,
-			// then everything, otherwise the fraction (less than 0.5)
-			double gas_frac = (intf_lvl.block () == FIRST_BLOCK) ?
-				min (HALFWAY, intf_lvl.fraction ()) : HALFWAY;
-
-			// id of the upper-most block of this column. if there is no
-			// blocks, then the TopSurf object wouldn't generate a column.
-			const int block_id = col_cells[col][FIRST_BLOCK];
-
-			// height of the uppermost block (twice the distance from the top
-			// to the center
-			const double hgt = ts_dz[col][FIRST_BLOCK];
-
-			// get the pressure in the middle of this block
-			const double mid_pres = finePressure[block_id];
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const ColumnIterator first = col_cells.columns ().begin ();
+		const ColumnIterator last = col_cells.columns ().end ();
+		ThreadError err;
+#ifdef _OPENMP
+#pragma omp parallel for schedule (dynamic, 16)
+#endif /* _OPENMP */
+		for (ColumnIterator it = first; it < last; ++it) {
+			try {
+				upscale_pres_col ((*it).index (), coarseSaturation, finePressure,
+				                  coarsePressure);
+			}
+			catch (...) {
+				err.store ();
+			}
+		}
+		err.rethrow ();
+	}
 
-			// pressure at the reference point; adjust hydrostatically for
-			// those phases that are on the way up from the center of the first
-			// block in the column.
-			const double ref_pres = mid_pres - gravity * hgt *
-			    (gas_frac * gas_dens + (HALFWAY - gas_frac) * wat_dens);
+	virtual void upscale_pressure (const double* coarseSaturation,
+	                               const double* finePressure,
+	                               double* coarsePressure,
+	                               int num_cols,
+	                               const int* cols) {
+		// same as above, but only for the columns in the list
+		for (int i = 0; i < num_cols; ++i) {
+			upscale_pres_col (cols[i], coarseSaturation, finePressure, coarsePressure);
+		}
+	}
 
-			// Eclipse uses non-aquous pressure (see Variable Sets in Formulation
-			// of the Equations in the Technical Description) as the main unknown
-			// in the pressure equation; there is assumed continuity at the
-			// contact, so the pressure at the top should always be a CO2 pressure
-			coarsePressure[col] = ref_pres;
+	/**
+	 * Upscale the saturation of a single column.
+	 *
+	 * @param phi Scratch space to hold the porosities of the column.
+	 * @param sg Scratch space to hold the saturations of the column.
+	 * @param pvg Scratch space to hold the pore volumes of the column.
+	 */
+	void upscale_sat_col (const int col,
+	                      const double* fineSaturation,
+	                      double* phi,
+	                      double* sg,
+	                      double* pvg,
+	                      double* coarseSaturation) const {
+		// porosities for the column. this is the same code as
+		// early in the constructor, but we don't save all this
+		// data because we don't need it very often.
+		up.gather (col, phi, fp.porosity (), 1, 0);
+
+		// pick out the CO2 saturation from the initial values
+		up.gather (col, sg, fineSaturation, NUM_PHASES, GAS);
+
+		// pore-volume occupied by that one phase is the product of
+		// volume, porosity and saturation; volume/height is part of
+		// the upscaling operator - we assume that every part of the
+		// column has the same area (violation of this assumption may
+		// cause slight mass balance problems)
+		const int num_rows = ts.col_cellpos[col + 1] - ts.col_cellpos[col];
+		for (int i = 0; i < num_rows; ++i) {
+			pvg[i] = phi[i] * sg[i];
 		}
+
+		// get the sum and update output. notice that we only need
+		// the total amount of CO2 in the column
+		const double col_porevol = up.dpt_avg (col, pvg);
+		const double upscaled_Sg = col_porevol / upscaled_poro[col];
+		coarseSaturation[col * NUM_PHASES + GAS] = upscaled_Sg;
+		coarseSaturation[col * NUM_PHASES + WAT] = 1 - upscaled_Sg;
 	}
 
 	virtual void upscale_saturation (const double* fineSaturation,
 	                                 double* coarseSaturation) {
-		// pointer to all porosities in the fine grid
-		const double* fine_poro = fp.porosity ();
+		// upscale column by column, sharing the columns among the threads
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const ColumnIterator first = col_cells.columns ().begin ();
+		const ColumnIterator last = col_cells.columns ().end ();
+		scratch.reserve ();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+		{
+			// fine porosity, saturation and pore volume of each thread
+			ColumnScratch& buf = scratch.local ();
+#ifdef _OPENMP
+#pragma omp for schedule (dynamic, 16)
+#endif /* _OPENMP */
+			for (ColumnIterator it = first; it < last; ++it) {
+				upscale_sat_col ((*it).index (), fineSaturation, &buf.poro[0],
+				                 &buf.sg[0], &buf.pvg[0], coarseSaturation);
+			}
+		}
+	}
 
-		// allocate memory outside of the loop
-		vector <double> phi (ts.max_vert_res, 0.); // fine porosity
-		vector <double> sg  (ts.max_vert_res, 0.); // fine saturation
-		vector <double> pvg (ts.max_vert_res, 0.); // fine pore volume
+	virtual void upscale_saturation (const double* fineSaturation,
+	                                 double* coarseSaturation,
+	                                 int num_cols,
+	                                 const int* cols) {
+		// same as above, but only for the columns in the list; the buffers
+		// are this call's own and not taken from the arena, so that several
+		// threads may upscale their own columns at the same time
+		vector <double> phi (ts.max_vert_res);
+		vector <double> sg (ts.max_vert_res);
+		vector <double> pvg (ts.max_vert_res);
+		for (int i = 0; i < num_cols; ++i) {
+			upscale_sat_col (cols[i], fineSaturation, &phi[0], &sg[0],
+			                 &pvg[0], coarseSaturation);
+		}
+	}
 
-		// use this object to find the actual number of columns
-		rlw_int colcellpos (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	/**
+	 * Downscale the saturation of a single column.
+	 *
+	 * @param ids Position in the output array of each block in the column.
+	 * @param sgr Scratch space to hold the residual saturations of the column.
+	 * @param l_swr Scratch space to hold the maximum saturations of the column.
+	 */
+	void downscale_sat_col (const int col,
+	                        const double* coarseSaturation,
+	                        const int* ids,
+	                        double* sgr,
+	                        double* l_swr,
+	                        double* fineSaturation) const {
+		// current height of mobile CO2
+		const double gas_hgt = coarseSaturation[col * NUM_PHASES + GAS];
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const int num_rows = col_cells.size (col);
 
-		// upscale column by column
-		for (int col = 0; col < ts.number_of_cells; ++col) {
-			// porosities for the column. this is the same code as
-			// early in the constructor, but we don't save all this
-			// data because we don't need it very often.
-			up.gather (col, &phi[0], fine_poro, 1, 0);
-
-			// pick out the CO2 saturation from the initial values
-			up.gather (col, &sg[0], fineSaturation, NUM_PHASES, GAS);
-
-			// pore-volume occupied by that one phase is the product of
-			// volume, porosity and saturation; volume/height is part of
-			// the upscaling operator - we assume that every part of the
-			// column has the same area (violation of this assumption may
-			// cause slight mass balance problems)
-			for (int i = 0; i < colcellpos.size (col); ++i) {
-				pvg[i] = phi[i] * sg[i];
+		// columns which the plume has never reached hold pure brine; this is
+		// most of the domain, so don't bother to look up the interfaces
+		if (gas_hgt <= 0. && max_gas_sat[col] <= 0.) {
+			for (int row = 0; row < num_rows; ++row) {
+				const int block = ids[row];
+				fineSaturation[block * NUM_PHASES + GAS] = 0.;
+				fineSaturation[block * NUM_PHASES + WAT] = 1.;
 			}
+			return;
+		}
+
+		// height of the interface of residual and mobile CO2, resp.
+		const Elevation res_gas = res_elev (col, gas_hgt);   // zeta_R
+		const Elevation mob_gas = intf_elev (col, gas_hgt);  // zeta_M
+
+		// query the fine properties for the residual saturations; notice
+		// that only every other item holds the value for CO2
+		fp.satRange (num_rows, col_cells[col], sgr, l_swr);
+
+		// fill the number of whole blocks which contain mobile CO2 and
+		// only residual water (maximum CO2)
+		for (int row = 0; row < mob_gas.block (); ++row) {
+			const double gas_sat = l_swr[row * NUM_PHASES + GAS];
+			const int block = ids[row];
+			fineSaturation[block * NUM_PHASES + GAS] = gas_sat;
+			fineSaturation[block * NUM_PHASES + WAT] = 1 - gas_sat;
+		}
+
+		// then fill the number of *whole* blocks which contain only
+		// residual CO2. we start out in the block that was not filled
+		// with mobile CO2, i.e. these only fill the *extra* blocks
+		// where the plume once was but is not anymore
+		for (int row = mob_gas.block(); row < res_gas.block(); ++row) {
+			const double gas_sat = sgr[row * NUM_PHASES + GAS];
+			const int block = ids[row];
+			fineSaturation[block * NUM_PHASES + GAS] = gas_sat;
+			fineSaturation[block * NUM_PHASES + WAT] = 1 - gas_sat;
+		}
 
-			// get the sum and update output. notice that we only need
-			// the total amount of CO2 in the column
-			const double col_porevol = up.dpt_avg (col, &pvg[0]);
-			const double upscaled_Sg = col_porevol / upscaled_poro[col];
-			coarseSaturation[col * NUM_PHASES + GAS] = upscaled_Sg;
-			coarseSaturation[col * NUM_PHASES + WAT] = 1 - upscaled_Sg;
+		// fill the remaining of the blocks in the column with pure brine
+		for (int row = res_gas.block(); row < num_rows; ++row) {
+			const int block = ids[row];
+			fineSaturation[block * NUM_PHASES + GAS] = 0.;
+			fineSaturation[block * NUM_PHASES + WAT] = 1.;
+		}
+
+		// adjust the block with the mobile/residual interface with its
+		// fraction of mobile CO2. since we only have a resolution of one
+		// block this sharp interface will only be seen on the visualization
+		// as a slightly differently colored block. only do this if there
+		// actually is a partially filled block. (the test is on the row
+		// and the saturation ranges are column-local, whereas the output
+		// is written to the block where the row is placed)
+		const int intf_row = mob_gas.block ();
+		if (intf_row != num_rows) {
+			// there will already be residual gas in this block thanks to the
+			// loop above; we must only fill a fraction of it with mobile gas,
+			// which is the difference between the maximum and minimum filling
+			const int intf_block = ids[intf_row];
+			const double intf_gas_sat_incr = mob_gas.fraction () *
+			    (l_swr[intf_row * NUM_PHASES + GAS]
+			    - sgr[intf_row * NUM_PHASES + GAS]);
+			fineSaturation[intf_block * NUM_PHASES + GAS] += intf_gas_sat_incr;
+			// we could have written at the brine saturations afterwards to
+			// avoid this extra adjustment, but the data locality will be bad
+			fineSaturation[intf_block * NUM_PHASES + WAT] -= intf_gas_sat_incr;
+		}
+
+		// do the same drill, but with the fraction of where the residual
+		// zone ends (the outermost historical edge of the plume)
+		const int res_row = res_gas.block ();
+		if (res_row != num_rows) {
+			const int res_block = ids[res_row];
+			const double res_gas_sat_incr = res_gas.fraction() *
+				  sgr[res_row * NUM_PHASES + GAS];
+			fineSaturation[res_block * NUM_PHASES + GAS] += res_gas_sat_incr;
+			fineSaturation[res_block * NUM_PHASES + WAT] -= res_gas_sat_incr;
 		}
 	}
 
@@ -697,158 +1698,283 @@ struct VertEqPropsImpl : public VertEqProps {
 		// object itself, it may add to memory pressure; I assume instead
 		// that it is not expensive for the underlaying properties object
 		// to deliver these values on-demand.
-		vector <double> sgr   (ts.max_vert_res * NUM_PHASES, 0.); // residual CO2
-		vector <double> l_swr (ts.max_vert_res * NUM_PHASES, 0.); // 1 - residual brine
 
 		// indexing object that helps us find the cell in a particular column
 		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
-
-		// downscale each column individually
-		for (int col = 0; col < ts.number_of_cells; ++col) {
-			// current height of mobile CO2
-			const double gas_hgt = coarseSaturation[col * NUM_PHASES + GAS];
-
-			// height of the interface of residual and mobile CO2, resp.
-			const Elevation res_gas = res_elev (col, gas_hgt);   // zeta_R
-			const Elevation mob_gas = intf_elev (col, gas_hgt);  // zeta_M
-
-			// query the fine properties for the residual saturations; notice
-			// that only every other item holds the value for CO2
-			const int* ids = col_cells[col];
-			fp.satRange (col_cells.size (col), ids, &sgr[0], &l_swr[0]);
-
-			// fill the number of whole blocks which contain mobile CO2 and
-			// only residual water (maximum CO2)
-			for (int row = 0; row < mob_gas.block (); ++row) {
-				const double gas_sat = l_swr[row * NUM_PHASES + GAS];
-				const int block = ids[row];
-				fineSaturation[block * NUM_PHASES + GAS] = gas_sat;
-				fineSaturation[block * NUM_PHASES + WAT] = 1 - gas_sat;
-			}
-
-			// then fill the number of *whole* blocks which contain only
-			// residual CO2. we start out in the block that was not filled
-			// with mobile CO2, i.e. these only fill the *extra* blocks
-			// where the plume once was but is not anymore
-			for (int row = mob_gas.block(); row < res_gas.block(); ++row) {
-				const double gas_sat = sgr[row * NUM_PHASES + GAS];
-				const int block = ids[row];
-				fineSaturation[block * NUM_PHASES + GAS] = gas_sat;
-				fineSaturation[block * NUM_PHASES + WAT] = 1 - gas_sat;
-			}
-
-			// fill the remaining of the blocks in the column with pure brine
-			for (int row = res_gas.block(); row < col_cells.size (col); ++row) {
-				const int block = ids[row];
-				fineSaturation[block * NUM_PHASES + GAS] = 0.;
-				fineSaturation[block * NUM_PHASES + WAT] = 1.;
-			}
-
-			// adjust the block with the mobile/residual interface with its
-			// fraction of mobile CO2. since we only have a resolution of one
-			// block this sharp interface will only be seen on the visualization
-			// as a slightly differently colored block. only do this if there
-			// actually is a partially filled block.
-			const int intf_block = ids[mob_gas.block ()];
-			if (intf_block != col_cells.size(col)) {
-				// there will already be residual gas in this block thanks to the
-				// loop above; we must only fill a fraction of it with mobile gas,
-				// which is the difference between the maximum and minimum filling
-				const double intf_gas_sat_incr = mob_gas.fraction () *
-				    (l_swr[intf_block * NUM_PHASES + GAS]
-				    - sgr[intf_block * NUM_PHASES + GAS]);
-				fineSaturation[intf_block * NUM_PHASES + GAS] += intf_gas_sat_incr;
-				// we could have written at the brine saturations afterwards to
-				// avoid this extra adjustment, but the data locality will be bad
-				fineSaturation[intf_block * NUM_PHASES + WAT] -= intf_gas_sat_incr;
-			}
-
-			// do the same drill, but with the fraction of where the residual
-			// zone ends (the outermost historical edge of the plume)
-			const int res_block = ids[res_gas.block()];
-			if (res_block != col_cells.size(col)) {
-				const double res_gas_sat_incr = res_gas.fraction() *
-					  sgr[res_block * NUM_PHASES + GAS];
-				fineSaturation[res_block * NUM_PHASES + GAS] += res_gas_sat_incr;
-				fineSaturation[res_block * NUM_PHASES + WAT] -= res_gas_sat_incr;
+		const ColumnIterator first = col_cells.columns ().begin ();
+		const ColumnIterator last = col_cells.columns ().end ();
+		ThreadError err;
+		scratch.reserve ();
+
+		// downscale each column individually, writing directly into the
+		// location of each block in the fine grid. the blocks of different
+		// columns are disjoint, so the threads never write to the same place
+#ifdef _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+		{
+			// residual CO2 and 1 - residual brine, in the thread's buffers
+			ColumnScratch& buf = scratch.local ();
+#ifdef _OPENMP
+#pragma omp for schedule (dynamic, 16)
+#endif /* _OPENMP */
+			for (ColumnIterator it = first; it < last; ++it) {
+				const rlw_int::Column c = *it;
+				try {
+					downscale_sat_col (c.index (), coarseSaturation, c.begin (),
+					                   &buf.sgr[0], &buf.l_swr[0], fineSaturation);
+				}
+				catch (...) {
+					err.store ();
+				}
 			}
 		}
+		err.rethrow ();
 	}
 
-	virtual void downscale_pressure (const double* coarseSaturation,
-	                                 const double* coarsePressure,
-	                                 double* finePressure) {
+	/**
+	 * Downscale the pressure of a single column.
+	 *
+	 * @param ids Position in the output array of each block in the column.
+	 */
+	void downscale_pres_col (const int col,
+	                         const double* coarseSaturation,
+	                         const double* coarsePressure,
+	                         const int* ids,
+	                         double* finePressure) const {
 		// pressure locations we'll have to relate to
 		static const double HALFWAY     = 0.5;  // center of the block
 
-		// helper object to get the index (into the pressure array) and
-		// the height of elements in a column
+		// helper object to get the height of elements in a column
 		const rlw_double ts_h (ts.number_of_cells, ts.col_cellpos, ts.h);
 		const rlw_double ts_dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
-		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const int num_rows = up.num_rows (col);
 
 		// incompressible means that the density is the same everywhere
 		// we can thus cache the phase properties outside of the loop
 		const double gas_dens = density ()[GAS];
 		const double wat_dens = density ()[WAT];
-
-		for (int col = 0; col < col_cells.cols (); ++col) {
+		const double gas_sat = coarseSaturation[col * NUM_PHASES + GAS];
+		const double gas_ref = coarsePressure[col];
+
+		// columns outside of the plume hold pure brine; the interface is
+		// then at the top, where the difference between the phases is the
+		// entry pressure of the top block only, and we don't have to look
+		// it up in the tables (which capPress would do)
+		double wat_ref;
+		int num_gas_rows;
+		if (gas_sat <= 0. && max_gas_sat[col] <= 0.) {
+			const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+			const int top = col_cells[col][0];
+			double fine_sat[NUM_PHASES];
+			double fine_pc[NUM_PHASES];
+			double fine_dpc[NUM_PHASES_SQ];
+			fine_sat[GAS] = 0.;
+			fine_sat[WAT] = 1.;
+			fp.capPress (1, fine_sat, &top, fine_pc, fine_dpc);
+			wat_ref = gas_ref - fine_pc[0];
+			num_gas_rows = 0;
+		}
+		else {
 			// location of the brine-co2 phase contact
-			const double gas_sat = coarseSaturation[col * NUM_PHASES + GAS];
 			const Elevation& intf_lvl = intf_elev (col, gas_sat);
 
-			// get the pressure difference between the phases at top of this column
-			const double sat[NUM_PHASES] = { gas_sat, 1-gas_sat };
-			double pres_diff;
-			capPress (1, sat, &col, &pres_diff, 0);
+			// get the pressure difference between the phases at top of this
+			// column (the output has room for both phases, but only the first
+			// is set)
+			double sat[NUM_PHASES];
+			sat[GAS] = gas_sat;
+			sat[WAT] = 1 - gas_sat;
+			double pc[NUM_PHASES];
+			capPress (1, sat, &col, pc, 0);
+			const double pres_diff = pc[0];
 
-			// get the reference phase pressure at the top; notice that the CO2
-			// pressure is the largest so we subtract the difference
-			const double gas_ref = coarsePressure[col];
-			const double wat_ref = gas_ref - pres_diff;
+			// get the reference phase pressure at the top; notice that the
+			// CO2 pressure is the largest so we subtract the difference
+			wat_ref = gas_ref - pres_diff;
 
 			// are we going to include the block with the interface
 			const int incl_intf = intf_lvl.fraction () >= HALFWAY ? 1 : 0;
-			const int num_gas_rows = intf_lvl.block () + incl_intf;
+			num_gas_rows = intf_lvl.block () + incl_intf;
+		}
 
-			// write all CO2 pressure blocks
-			for (int row = 0; row < num_gas_rows; ++row) {
-				// height of block center
-				const double hgt = ts_h[col][row] + HALFWAY * ts_dz[col][row];
+		// write all CO2 pressure blocks
+		for (int row = 0; row < num_gas_rows; ++row) {
+			// height of block center
+			const double hgt = ts_h[col][row] + HALFWAY * ts_dz[col][row];
 
-				// hydrostatically get the pressure for this block
-				const double gas_pres = gas_ref + gravity * hgt * gas_dens;
-				const int block = col_cells[col][row];
+			// hydrostatically get the pressure for this block
+			const double gas_pres = gas_ref + gravity * hgt * gas_dens;
+			const int block = ids[row];
 
-				// (scatter) write to output array
-				finePressure[block] = gas_pres;
-			}
+			// (scatter) write to output array
+			finePressure[block] = gas_pres;
+		}
 
-			// then write the brine blocks, starting where we left off
-			for (int row = num_gas_rows; row < col_cells.size (col); ++row) {
-				// height of block center
-				const double hgt = ts_h[col][row] + HALFWAY * ts_dz[col][row];
+		// then write the brine blocks, starting where we left off
+		for (int row = num_gas_rows; row < num_rows; ++row) {
+			// height of block center
+			const double hgt = ts_h[col][row] + HALFWAY * ts_dz[col][row];
 
-				// hydrostatically get the pressure for this block
-				const double wat_pres = wat_ref + gravity * hgt * wat_dens;
-				const int block = col_cells[col][row];
+			// hydrostatically get the pressure for this block
+			const double wat_pres = wat_ref + gravity * hgt * wat_dens;
+			const int block = ids[row];
 
-				// (scatter) write to output array
-				finePressure[block] = wat_pres;
+			// (scatter) write to output array
+			finePressure[block] = wat_pres;
+		}
+	}
+
+	virtual void downscale_pressure (const double* coarseSaturation,
+	                                 const double* coarsePressure,
+	                                 double* finePressure) {
+		// helper object to get the index (into the pressure array)
+		const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+		const ColumnIterator first = col_cells.columns ().begin ();
+		const ColumnIterator last = col_cells.columns ().end ();
+		ThreadError err;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule (dynamic, 16)
+#endif /* _OPENMP */
+		for (ColumnIterator it = first; it < last; ++it) {
+			const rlw_int::Column c = *it;
+			try {
+				downscale_pres_col (c.index (), coarseSaturation, coarsePressure,
+				                    c.begin (), finePressure);
+			}
+			catch (...) {
+				err.store ();
 			}
 		}
+		err.rethrow ();
+	}
+
+	virtual void downscale_column (int col,
+	                               const double* coarseSaturation,
+	                               const double* coarsePressure,
+	                               const int* rows,
+	                               double* fineSaturation,
+	                               double* finePressure) {
+		// scratch space for the saturation ranges of this column only; it
+		// is not taken from the arena, since this is called for a column
+		// at a time from threads that the arena doesn't know about
+		vector <double> sgr (up.num_rows (col) * NUM_PHASES);
+		vector <double> l_swr (up.num_rows (col) * NUM_PHASES);
+
+		downscale_sat_col (col, coarseSaturation, rows,
+		                   &sgr[0], &l_swr[0], fineSaturation);
+		downscale_pres_col (col, coarseSaturation, coarsePressure,
+		                    rows, finePressure);
 	}
 };
 
+namespace {
+
+/**
+ * Create the instantiation of the implementation that matches the order
+ * of the phases in the fine-scale properties.
+ */
+VertEqPropsBase*
+create_impl (const IncompPropertiesInterface& fineProps,
+             const TopSurf& topSurf,
+             const double* grav_vec,
+             int num_cols,
+             const int* cols,
+             bool deferred) {
+	// assign which phase is which (e.g. CO2 is first, brine is second)
+	if (VertEqProps::gas_phase (fineProps) == 0) {
+		return new VertEqPropsImpl <0> (fineProps, topSurf, grav_vec,
+		                                num_cols, cols, deferred);
+	}
+	else {
+		return new VertEqPropsImpl <1> (fineProps, topSurf, grav_vec,
+		                                num_cols, cols, deferred);
+	}
+}
+
+} // anonymous namespace
+
+int
+VertEqProps::gas_phase (const IncompPropertiesInterface& props) {
+	if (props.numPhases () != 2) {
+		throw OPM_EXC ("Expected %d phases, but got %d", 2, props.numPhases ());
+	}
+	return props.density ()[0] < props.density ()[1] ? 0 : 1;
+}
+
 VertEqProps*
 VertEqProps::create (const IncompPropertiesInterface& fineProps,
                      const TopSurf& topSurf,
                      const double* grav_vec) {
 	// construct real object which contains all the implementation details
-	unique_ptr <VertEqProps> props (new VertEqPropsImpl (fineProps,
-	                                                     topSurf,
-	                                                     grav_vec));
+	unique_ptr <VertEqProps> props (create_impl (fineProps,
+	                                             topSurf,
+	                                             grav_vec,
+	                                             0, 0,
+	                                             false));
+
+	// client owns pointer to constructed fluid object from this point
+	return props.release ();
+}
+
+VertEqProps*
+VertEqProps::create (const IncompPropertiesInterface& fineProps,
+                     const TopSurf& topSurf,
+                     const double* grav_vec,
+                     int num_cols,
+                     const int* cols) {
+	// the tables are indexed by the global column, but only the columns
+	// that we are asked for have any entries in them
+	unique_ptr <VertEqPropsBase> props (create_impl (fineProps,
+	                                                 topSurf,
+	                                                 grav_vec,
+	                                                 num_cols, cols,
+	                                                 true));
+	props->scratch.reserve ();
+	ColumnScratch& buf = props->scratch.local ();
+	for (int i = 0; i < num_cols; ++i) {
+		props->setup_column (cols[i], buf);
+	}
 
 	// client owns pointer to constructed fluid object from this point
 	return props.release ();
 }
+
+vector <VertEqProps*>
+VertEqProps::create (const vector <const IncompPropertiesInterface*>& fineProps,
+                     const TopSurf& topSurf,
+                     const double* grav_vec) {
+	// which columns can share tables depends on the rock of each
+	// realization, so they are grouped for each of them. the realizations
+	// are independent of each other, so they are processed in parallel,
+	// each one by a single thread with its own scratch space; keep the
+	// ownership here until every one of them is complete
+	const int num = static_cast <int> (fineProps.size ());
+	vector <unique_ptr <VertEqPropsBase> > members (num);
+	ThreadError err;
+#ifdef _OPENMP
+#pragma omp parallel for schedule (dynamic, 1)
+#endif /* _OPENMP */
+	for (int i = 0; i < num; ++i) {
+		try {
+			members[i].reset (create_impl (*fineProps[i], topSurf, grav_vec,
+			                               0, 0, true));
+			ColumnScratch buf (topSurf.max_vert_res);
+			for (int col = 0; col < topSurf.number_of_cells; ++col) {
+				members[i]->setup_column (col, buf);
+			}
+		}
+		catch (...) {
+			err.store ();
+		}
+	}
+	err.rethrow ();
+
+	// client owns pointers to constructed fluid objects from this point
+	vector <VertEqProps*> result (members.size ());
+	for (size_t i = 0; i < members.size (); ++i) {
+		result[i] = members[i].release ();
+	}
+	return result;
+}
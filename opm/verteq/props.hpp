@@ -8,6 +8,9 @@
 #include <opm/verteq/visibility.hpp>
 #endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
 
+#include <cstddef> // size_t
+#include <vector>
+
 #ifndef OPM_INCOMPPROPERTIESINERFACE_HEADER_INCLUDED
 #include <opm/core/props/IncompPropertiesInterface.hpp>
 #endif /* OPM_INCOMPPROPERTIESINERFACE_HEADER_INCLUDED */
@@ -33,6 +36,102 @@ struct VertEqProps : public IncompPropertiesInterface {
 	                            const TopSurf& topSurf,
 	                            const double* gravity);
 
+	/**
+	 * Create upscaled properties for some of the columns only, e.g. those
+	 * that are local to this process when the top surface is partitioned.
+	 *
+	 * No tables are allocated for the other columns, so the object must
+	 * only be evaluated for the columns in the list. Use the overloads of
+	 * the upscaling methods that take a list of columns. Only the columns
+	 * in the list can share tables with each other.
+	 *
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of the columns to setup.
+	 *
+	 * The other parameters are the same as for the function above.
+	 */
+	static VertEqProps* create (const IncompPropertiesInterface& fineProps,
+	                            const TopSurf& topSurf,
+	                            const double* gravity,
+	                            int num_cols,
+	                            const int* cols);
+
+	/**
+	 * Create upscaled versions of several realizations of the fluid and
+	 * rock properties at once, all on the same top surface.
+	 *
+	 * This gives the same result as calling the function above for each
+	 * realization, but the realizations are processed in parallel (when
+	 * the library is built with OpenMP), each of them by one thread.
+	 *
+	 * @param fineProps Fluid and rock properties for each realization.
+	 * @param topSurf Grid for which the properties should be upscaled.
+	 * @param gravity Gravity vector (three-dimensional).
+	 * @return Fluid object for each realization, in the same order as the
+	 * input. The caller has the responsibility to dispose off all of them.
+	 */
+	static std::vector <VertEqProps*> create (
+		const std::vector <const IncompPropertiesInterface*>& fineProps,
+		const TopSurf& topSurf,
+		const double* gravity);
+
+	/**
+	 * Index of the phase that is the CO2, i.e. the lighter of the two.
+	 *
+	 * A basic assumption of the vertical equilibrium is that the CO2 is
+	 * the lighter phase and thus rises to the top of the reservoir. The
+	 * upscaled properties keep the order of the phases (and the densities)
+	 * of the fine-scale ones, so this can be asked of either.
+	 *
+	 * @param props Fluid properties with two phases.
+	 * @return Index of the CO2; the brine is the other one.
+	 */
+	static int gas_phase (const IncompPropertiesInterface& props);
+
+	/**
+	 * Recompute the upscaled rock properties of the columns which contain
+	 * any of the given cells.
+	 *
+	 * Call this when the porosity or permeability of some blocks in the
+	 * fine properties object have been changed in place. Only the tables
+	 * for the affected columns are rebuilt; the rest are left as is.
+	 *
+	 * @param num_cells Number of cells in the list.
+	 * @param cells Indices (in the fine grid) of cells that have changed.
+	 *              The same column may be referred to several times.
+	 */
+	virtual void update (int num_cells, const int* cells) = 0;
+
+	/**
+	 * Merge consecutive blocks in each column that have the same rock
+	 * properties into layers, and search for the interfaces among the
+	 * layers instead of among the blocks.
+	 *
+	 * The results are the same (up to rounding) as without, but in
+	 * models where each geological layer is split into many cells the
+	 * tables that are searched become much shorter.
+	 *
+	 * Call this after all the columns have been setup; the layers are
+	 * found again by update() after that.
+	 */
+	virtual void compress_layers () = 0;
+
+	/**
+	 * Memory used by the tables that have an entry for each block, in
+	 * bytes. Columns that have the same vertical profile, i.e. the same
+	 * heights, rock properties and saturation functions in every block,
+	 * share the tables of the first of them. Columns that are the same
+	 * in every block have no tables, only a value for each property.
+	 */
+	virtual std::size_t table_bytes () const = 0;
+
+	/**
+	 * Memory that is saved by sharing the tables among identical columns,
+	 * and by leaving them out for uniform columns, compared to having
+	 * tables for each column, in bytes.
+	 */
+	virtual std::size_t shared_bytes () const = 0;
+
 	/**
 	 * Update residual saturation of CO2 through-out the domain.
 	 *
@@ -49,6 +148,42 @@ struct VertEqProps : public IncompPropertiesInterface {
 	 */
 	virtual void upd_res_sat (const double* sat) = 0;
 
+	/**
+	 * Update residual saturation of CO2 in some of the columns only.
+	 *
+	 * Use this when it is known where the saturation may have changed,
+	 * e.g. from a PlumeSet; the other columns are left as they are.
+	 *
+	 * @param sat Saturation for the phases in the coarse domain, for
+	 *            all the columns (as above).
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of the columns to update.
+	 */
+	virtual void upd_res_sat (const double* sat,
+	                          int num_cols,
+	                          const int* cols) = 0;
+
+	/**
+	 * Maximum CO2 saturation that has been seen in each column so far,
+	 * i.e. what determines the extent of the residual CO2.
+	 *
+	 * This is the only part of the properties that depends on the history
+	 * of the simulation, and it must be saved together with the state to
+	 * be able to restart.
+	 *
+	 * @return Array with one value for each column in the top surface. It
+	 *         is valid as long as the properties object is.
+	 */
+	virtual const double* max_sat () const = 0;
+
+	/**
+	 * Replace the history of the maximum CO2 saturation, e.g. with values
+	 * gotten from max_sat() in an earlier run.
+	 *
+	 * @param sat Maximum saturation of CO2, one value for each column.
+	 */
+	virtual void max_sat (const double* sat) = 0;
+
 	/**
 	 * Upscale pressure from fine-scale to coarse-scale.
 	 *
@@ -70,6 +205,21 @@ struct VertEqProps : public IncompPropertiesInterface {
 	                               const double* finePressure,
 	                               double* coarsePressure) = 0;
 
+	/**
+	 * Upscale pressure from fine-scale to coarse-scale in some of the
+	 * columns only; the other columns are left as they are.
+	 *
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of the columns to upscale.
+	 *
+	 * The other parameters are the same as for the method above.
+	 */
+	virtual void upscale_pressure (const double* coarseSaturation,
+	                               const double* finePressure,
+	                               double* coarsePressure,
+	                               int num_cols,
+	                               const int* cols) = 0;
+
 	/**
 	 * Upscale saturation from fine-scale to coarse-scale.
 	 *
@@ -88,6 +238,22 @@ struct VertEqProps : public IncompPropertiesInterface {
 	virtual void upscale_saturation (const double* fineSaturation,
 	                                 double* coarseSaturation) = 0;
 
+	/**
+	 * Upscale saturation from fine-scale to coarse-scale in some of the
+	 * columns only; the other columns are left as they are.
+	 *
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of the columns to upscale.
+	 *
+	 * The other parameters are the same as for the method above. Threads
+	 * may call this at the same time for lists that have no column in
+	 * common.
+	 */
+	virtual void upscale_saturation (const double* fineSaturation,
+	                                 double* coarseSaturation,
+	                                 int num_cols,
+	                                 const int* cols) = 0;
+
 	/**
 	 * Downscale to corresponding 3D fine-scale saturations from 2D
 	 * coarse-scale saturations.
@@ -131,6 +297,47 @@ struct VertEqProps : public IncompPropertiesInterface {
 	virtual void downscale_pressure (const double* coarseSaturation,
 	                                 const double* coarsePressure,
 	                                 double* finePressure) = 0;
+
+	/**
+	 * Downscale saturation and pressure for a single column only.
+	 *
+	 * This does the same job as downscale_saturation and downscale_pressure
+	 * together, but lets the caller decide where the result for each block
+	 * is written.
+	 *
+	 * @param[in] col
+	 *	Index of the column in the top surface grid to downscale.
+	 *
+	 * @param[in] coarseSaturation
+	 *	Saturation for each phase, and for each column in the coarse grid.
+	 *
+	 * @param[in] coarsePressure
+	 *	Pressure of the CO2 phase at the top of each column.
+	 *
+	 * @param[in] rows
+	 *	Position in the output arrays for each block in the column, from the
+	 *	top and downwards. Pass the part of col_cells for this column to write
+	 *	into arrays for the entire fine grid, or 0, 1, ..., n-1 to get a
+	 *	compact result for the column alone.
+	 *
+	 * @param[out] fineSaturation
+	 *	Saturation for each phase, at the positions given in rows.
+	 *
+	 * @param[out] finePressure
+	 *	Pressure at the positions given in rows.
+	 *
+	 * @note You should call upd_res_sat before calling this method to make
+	 *       sure that the position of the interface is up-to-date.
+	 *
+	 * Threads may call this at the same time for different columns, as
+	 * long as nothing else uses the object meanwhile.
+	 */
+	virtual void downscale_column (int col,
+	                               const double* coarseSaturation,
+	                               const double* coarsePressure,
+	                               const int* rows,
+	                               double* fineSaturation,
+	                               double* finePressure) = 0;
 };
 
 } // namespace Opm
@@ -0,0 +1,143 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/restrict.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/utility/runlen.hpp>
+#include <memory> // unique_ptr
+
+using namespace Opm;
+using namespace std;
+
+Restriction::Restriction (const TopSurf& ts)
+	// the sparsity pattern is given by the columns of the top surface;
+	// row_ptr is the col_cellpos and col_ind is the col_cells array
+	: num_rows (ts.number_of_cells)
+	, num_cols (ts.col_cellpos[ts.number_of_cells])
+	, row_ptr (ts.col_cellpos, ts.col_cellpos + ts.number_of_cells + 1)
+	, col_ind (ts.col_cells, ts.col_cells + num_cols)
+	, val (num_cols, 0.) {
+}
+
+Restriction*
+Restriction::depth_avg (const TopSurf& ts) {
+	unique_ptr <Restriction> R (new Restriction (ts));
+
+	// the weight of each block is its share of the column height; this
+	// is the same as what is done in VertEqUpscaler::dpt_avg
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	for (int col = 0; col < dz.cols (); ++col) {
+		const double H = ts.h_tot[col];
+		const int start = R->row_ptr[col];
+		for (int row = 0; row < dz.size (col); ++row) {
+			R->val[start + row] = dz[col][row] / H;
+		}
+	}
+
+	// client owns pointer to constructed matrix from this point
+	return R.release ();
+}
+
+Restriction*
+Restriction::depth_avg (const TopSurf& ts,
+                        const double* weight,
+                        int stride,
+                        int offset) {
+	unique_ptr <Restriction> R (new Restriction (ts));
+
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	for (int col = 0; col < dz.cols (); ++col) {
+		const int start = R->row_ptr[col];
+
+		// the weight of each block is the additional weight times the
+		// height, which we store unnormalized the first time through
+		double total = 0.;
+		for (int row = 0; row < dz.size (col); ++row) {
+			const double w = weight[col_cells[col][row] * stride + offset];
+			total += R->val[start + row] = w * dz[col][row];
+		}
+
+		// normalize so that the weights in the row sum to one. a column
+		// with no weight at all (e.g. no pore volume) cannot be averaged
+		// and will get zero for every field
+		if (total > 0.) {
+			for (int row = 0; row < dz.size (col); ++row) {
+				R->val[start + row] /= total;
+			}
+		}
+	}
+
+	return R.release ();
+}
+
+Restriction*
+Restriction::sum (const TopSurf& ts) {
+	unique_ptr <Restriction> R (new Restriction (ts));
+
+	// every block counts fully
+	R->val.assign (R->num_cols, 1.);
+
+	return R.release ();
+}
+
+void
+Restriction::apply (const double* fine,
+                    double* coarse,
+                    int stride,
+                    int offset) const {
+	// pointers to the arrays to avoid bounds checks in debug builds
+	const int* const ptr = &row_ptr[0];
+	const int* const ind = &col_ind[0];
+	const double* const w = &val[0];
+
+	// plain row-oriented sparse matrix-vector product
+	for (int row = 0; row < num_rows; ++row) {
+		double accum = 0.;
+		for (int nz = ptr[row]; nz < ptr[row + 1]; ++nz) {
+			accum += w[nz] * fine[ind[nz] * stride + offset];
+		}
+		coarse[row] = accum;
+	}
+}
+
+void
+Restriction::apply_batch (int num_fields,
+                          const double* fine,
+                          double* coarse) const {
+	const int* const ptr = &row_ptr[0];
+	const int* const ind = &col_ind[0];
+	const double* const w = &val[0];
+
+	for (int row = 0; row < num_rows; ++row) {
+		// accumulate directly into the output record for this column
+		double* const out = &coarse[row * num_fields];
+		for (int fld = 0; fld < num_fields; ++fld) {
+			out[fld] = 0.;
+		}
+
+		// each entry of the matrix is read once, and applied to every
+		// field of the block, which is stored together
+		for (int nz = ptr[row]; nz < ptr[row + 1]; ++nz) {
+			const double* const in = &fine[ind[nz] * num_fields];
+			for (int fld = 0; fld < num_fields; ++fld) {
+				out[fld] += w[nz] * in[fld];
+			}
+		}
+	}
+}
+
+void
+Restriction::apply_trans (const double* coarse,
+                          double* fine) const {
+	const int* const ptr = &row_ptr[0];
+	const int* const ind = &col_ind[0];
+	const double* const w = &val[0];
+
+	// since each fine block is in exactly one column, there is only one
+	// entry in each column of the matrix, and we can scatter directly
+	for (int row = 0; row < num_rows; ++row) {
+		for (int nz = ptr[row]; nz < ptr[row + 1]; ++nz) {
+			fine[ind[nz]] = w[nz] * coarse[row];
+		}
+	}
+}
@@ -0,0 +1,172 @@
+#ifndef OPM_VERTEQ_RESTRICT_HPP_INCLUDED
+#define OPM_VERTEQ_RESTRICT_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+namespace Opm {
+
+// forward declaration
+struct TopSurf;
+
+/**
+ * Linear map from the fine grid to the columns of the top surface.
+ *
+ * The linear parts of the upscaling, i.e. depth-averaging of properties
+ * and summing of source terms, are fixed weightings of the blocks in each
+ * column. This class stores these weights explicitly as a sparse matrix
+ * with one row for each column and one column for each fine block, in
+ * the compressed sparse row (CSR) format, so that other components can
+ * apply the upscaling with their own kernels, or to several fields at
+ * the same time.
+ *
+ * The transpose of the matrix maps from the columns back to the fine
+ * grid. For the sum() operator this is the piecewise constant
+ * prolongation; for the depth-averaging operators each block gets the
+ * value of its column scaled by its weight, e.g. dz/H, and not the
+ * value itself.
+ *
+ * The sparsity pattern is the same as that of TopSurf::col_cells; row c
+ * of the matrix contains the blocks of column c, from the top and down.
+ *
+ * @example
+ * @code{.cpp}
+ * std::unique_ptr <Restriction> R (Restriction::depth_avg (*ts));
+ * R->apply (fp.porosity (), &upscaled_poro[0]);
+ * @endcode
+ *
+ * @see VertEqUpscaler::dpt_avg, VertEqUpscaler::sum
+ */
+struct OPM_VERTEQ_PUBLIC Restriction {
+	/**
+	 * Number of rows in the matrix; this is the number of columns in the
+	 * top surface.
+	 */
+	int num_rows;
+
+	/**
+	 * Number of columns in the matrix; this is the number of cells in the
+	 * fine grid.
+	 */
+	int num_cols;
+
+	/**
+	 * Index into col_ind and val of the first entry of each row. There is
+	 * one more item than there are rows, which holds the number of non-
+	 * zeros.
+	 */
+	std::vector <int> row_ptr;
+
+	/**
+	 * Index of the fine block of each entry.
+	 */
+	std::vector <int> col_ind;
+
+	/**
+	 * Weight of each entry.
+	 */
+	std::vector <double> val;
+
+	/**
+	 * Operator that averages a property over the depth of each column,
+	 * weighting each block with its height.
+	 *
+	 * This is the same as gathering the column and calling
+	 * VertEqUpscaler::dpt_avg on it.
+	 *
+	 * @param ts Top surface which define the columns and the heights.
+	 * @return Matrix that the caller is responsible to dispose of.
+	 */
+	static Restriction* depth_avg (const TopSurf& ts);
+
+	/**
+	 * Operator that averages a property over the depth of each column,
+	 * weighting each block by its height and an additional weight, e.g.
+	 * the porosity to get the upscaled saturation from the fine one.
+	 *
+	 * @param ts Top surface which define the columns and the heights.
+	 * @param weight Additional weight for each block in the fine grid.
+	 * @param stride Number of values (not bytes!) between each weight.
+	 * @param offset Number of values (not bytes!) before the first weight.
+	 * @return Matrix that the caller is responsible to dispose of.
+	 */
+	static Restriction* depth_avg (const TopSurf& ts,
+	                               const double* weight,
+	                               int stride = 1,
+	                               int offset = 0);
+
+	/**
+	 * Operator that sums a property down each column, regardless of the
+	 * height of the blocks. This is used for volumetric source terms.
+	 *
+	 * This is the same as calling VertEqUpscaler::sum for each column.
+	 *
+	 * @param ts Top surface which define the columns.
+	 * @return Matrix that the caller is responsible to dispose of.
+	 */
+	static Restriction* sum (const TopSurf& ts);
+
+	/**
+	 * Restrict a fine-scale field to the columns, y = R x.
+	 *
+	 * @param[in] fine Values for the entire fine grid, stored in records
+	 *                 of 'stride' length, 'offset' elements from the
+	 *                 start (same format as for VertEqUpscaler::gather).
+	 * @param[out] coarse Value for each column. Storage must be allocated
+	 *                    by the caller.
+	 * @param stride Number of values (not bytes!) between each entry.
+	 * @param offset Number of values (not bytes!) before the first entry.
+	 */
+	void apply (const double* fine,
+	            double* coarse,
+	            int stride = 1,
+	            int offset = 0) const;
+
+	/**
+	 * Restrict several fine-scale fields at the same time.
+	 *
+	 * The fields are interleaved, i.e. all values for a block are stored
+	 * together (as with the saturations of each phase). Each row of the
+	 * matrix is traversed only once for all the fields.
+	 *
+	 * @param num_fields Number of values for each block.
+	 * @param[in] fine Record of num_fields values for each fine block.
+	 * @param[out] coarse Record of num_fields values for each column.
+	 */
+	void apply_batch (int num_fields,
+	                  const double* fine,
+	                  double* coarse) const;
+
+	/**
+	 * Prolongate column values to the fine grid, x = R^T y.
+	 *
+	 * For the sum() operator, this spreads the value of each column to
+	 * every block in it. For depth_avg() every block gets the value times
+	 * its share of the column height; divide by that share (or use the
+	 * sum() operator) to get piecewise constant values.
+	 *
+	 * @param[in] coarse Value for each column.
+	 * @param[out] fine Value for each block in the fine grid. Storage
+	 *                  must be allocated by the caller. Only blocks which
+	 *                  are in a column are written.
+	 */
+	void apply_trans (const double* coarse,
+	                  double* fine) const;
+
+private:
+	/**
+	 * @brief You are not meant to construct these yourself; use one of
+	 *        the static functions above.
+	 */
+	Restriction (const TopSurf& ts);
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_RESTRICT_HPP_INCLUDED */
@@ -4,6 +4,8 @@
 // Copyright (C) 2013 Uni Research AS
 // This file is licensed under the GNU General Public License v3.0
 
+#include <iosfwd>
+
 #ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
 #include <opm/verteq/visibility.hpp>
 #endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
@@ -41,6 +43,23 @@ struct VertEqState : public TwophaseState {
 		ve.upscale (fineScale, *this);
 	}
 
+	/**
+	 * Initialize from a checkpoint instead of from a fine-scale state,
+	 * to continue a simulation where it was left off.
+	 *
+	 * @param checkpoint Stream containing data written by
+	 *                   VertEq::checkpoint.
+	 *
+	 * @see VertEq::restore
+	 */
+	VertEqState (VertEq& model,
+	             std::istream& checkpoint)
+		: ve (model) {
+
+		// the model puts back both the state and its own history
+		ve.restore (checkpoint, *this);
+	}
+
 	/**
 	 * Push changes that are done to this object back into the VE
 	 * model when it has been updated (a timestep has completed)
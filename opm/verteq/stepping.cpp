@@ -0,0 +1,192 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/stepping.hpp>
+#include <opm/verteq/plume.hpp>
+#include <opm/verteq/props.hpp>
+#include <opm/verteq/trans.hpp>
+#include <opm/verteq/verteq.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/core/grid.h>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <algorithm> // max, min
+#include <cmath>     // ceil, fabs
+#include <limits>    // numeric_limits
+#include <ostream>
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+const int NUM_PHASES = 2;
+const int NUM_PHASES_SQ = NUM_PHASES * NUM_PHASES;
+
+} // anonymous namespace
+
+StepStats::StepStats ()
+	: report_steps (0)
+	, substeps (0)
+	, min_step (numeric_limits <double>::max ())
+	, max_step (0.)
+	, max_cfl (0.) {
+}
+
+void
+StepStats::report (ostream& os) const {
+	os << "Number of report steps:      " << report_steps << "\n"
+	   << "Number of steps:             " << substeps << "\n"
+	   << "Shortest step (days):        " << (substeps ? min_step / unit::day : 0.) << "\n"
+	   << "Longest step (days):         " << max_step / unit::day << "\n"
+	   << "Highest estimated CFL:       " << max_cfl << endl;
+}
+
+StepControl::StepControl (VertEq& ve,
+                          const parameter::ParameterGroup& param)
+	: ve (ve)
+	, target_cfl (param.getDefault ("verteq_cfl", 1.0))
+	, growth (param.getDefault ("verteq_step_growth", 2.0))
+	, max_substeps (param.getDefault ("verteq_max_substeps", 100))
+	, last_step (0.)
+	, min_step (0.) {
+
+	if (!(target_cfl > 0.) || !(growth >= 1.) || max_substeps < 1) {
+		throw OPM_EXC ("Invalid parameters for adaptive steps");
+	}
+
+	// the first step is not limited by the growth, but by the length
+	// we have been given
+	const double initial = param.getDefault ("verteq_initial_step_days", 1.0) * unit::day;
+	last_step = initial / growth;
+
+	// pore volume does not change during the simulation
+	const UnstructuredGrid& g = ve.grid ();
+	const double* poro = ve.props ().porosity ();
+	pv.resize (g.number_of_cells);
+	for (int col = 0; col < g.number_of_cells; ++col) {
+		pv[col] = poro[col] * g.cell_volumes[col];
+	}
+}
+
+double
+StepControl::wave_speed (const TwophaseState& coarseScale) const {
+	const UnstructuredGrid& g = ve.grid ();
+	const IncompPropertiesInterface& pr = ve.props ();
+	const PlumeSet& plume = ve.plume ();
+	const double* trans = &ve.trans ().trans[0];
+	const vector <double>& gpot = ve.gravity_potential ();
+	const vector <double>& flux = coarseScale.faceflux ();
+	const vector <double>& sat = coarseScale.saturation ();
+	const vector <double>& src = ve.src ();
+	const int gas = VertEqProps::gas_phase (pr);
+	const int wat = 1 - gas;
+	const double drho = pr.density ()[wat] - pr.density ()[gas];
+	const double mu_g = pr.viscosity ()[gas];
+	const double mu_w = pr.viscosity ()[wat];
+
+	// evaluate the properties for all the columns at once
+	const int num = plume.size ();
+	if (num == 0) {
+		return 0.;
+	}
+	vector <double> sats (num * NUM_PHASES);
+	for (int i = 0; i < num; ++i) {
+		const int col = plume.cols ()[i];
+		sats[i * NUM_PHASES + gas] = sat[col * NUM_PHASES + gas];
+		sats[i * NUM_PHASES + wat] = sat[col * NUM_PHASES + wat];
+	}
+	vector <double> kr (num * NUM_PHASES);
+	vector <double> dkr (num * NUM_PHASES_SQ);
+	vector <double> pc (num * NUM_PHASES);
+	vector <double> dpc (num * NUM_PHASES_SQ);
+	pr.relperm (num, &sats[0], plume.cols (), &kr[0], &dkr[0]);
+	pr.capPress (num, &sats[0], plume.cols (), &pc[0], &dpc[0]);
+
+	double fastest = 0.;
+	for (int i = 0; i < num; ++i) {
+		const int col = plume.cols ()[i];
+
+		// mobilities and their derivatives with respect to the CO2
+		// saturation (same layout as VertEqProps)
+		const double lg = kr[i * NUM_PHASES + gas] / mu_g;
+		const double lw = kr[i * NUM_PHASES + wat] / mu_w;
+		const double dlg = dkr[i * NUM_PHASES_SQ + NUM_PHASES * gas + gas] / mu_g;
+		const double dlw = dkr[i * NUM_PHASES_SQ + NUM_PHASES * wat + gas] / mu_w;
+		const double lt = lg + lw;
+		if (!(lt > 0.)) {
+			continue;
+		}
+
+		// fractional flow, and the product that goes with buoyancy and
+		// capillary pressure
+		const double df = (dlg * lw - lg * dlw) / (lt * lt);
+		const double h = lg * lw / lt;
+		const double dh = (dlg * lw + lg * dlw) / lt - h * (dlg + dlw) / lt;
+
+		// only the first phase holds the capillary pressure
+		const double dpc_ds = fabs (dpc[i * NUM_PHASES_SQ]);
+
+		// production from the column itself
+		double rate = src[col] < 0. ? -src[col] * fabs (df) : 0.;
+
+		for (int pos = g.cell_facepos[col]; pos != g.cell_facepos[col + 1]; ++pos) {
+			const int face = g.cell_faces[pos];
+			const int c1 = g.face_cells[2 * face + 0];
+			const int c2 = g.face_cells[2 * face + 1];
+			const int other = c1 == col ? c2 : c1;
+
+			// viscous flux out of the column
+			const double out = (c1 == col ? 1. : -1.) * flux[face];
+			if (out > 0.) {
+				rate += out * fabs (df);
+			}
+			if (other < 0) {
+				continue;
+			}
+
+			// buoyancy and capillary pressure over the face; the buoyancy is
+			// driven by the difference in gravity potential between the two
+			// sides of it, i.e. the local difference in height of the caprock
+			int opp = g.cell_facepos[other];
+			while (g.cell_faces[opp] != face) {
+				++opp;
+			}
+			const double G = trans[face] * drho * fabs (gpot[opp] - gpot[pos]);
+			rate += G * fabs (dh) + trans[face] * h * dpc_ds;
+		}
+		fastest = max (fastest, rate / pv[col]);
+	}
+	return fastest;
+}
+
+void
+StepControl::begin (double length) {
+	// never take more steps than we have been allowed to
+	min_step = length / max_substeps;
+	++st.report_steps;
+}
+
+double
+StepControl::next_step (const TwophaseState& coarseScale,
+                        double remaining) {
+	// step which gives the requested CFL number, but which is not too
+	// long compared to the previous one
+	const double speed = wave_speed (coarseScale);
+	double step = speed > 0. ? target_cfl / speed : remaining;
+	step = min (step, growth * last_step);
+	step = max (step, min_step);
+
+	// divide the remainder evenly, so that we don't end up with a short
+	// step at the end
+	const double parts = max (1., ceil (remaining / step - 1e-6));
+	step = remaining / parts;
+
+	last_step = step;
+	++st.substeps;
+	st.min_step = min (st.min_step, step);
+	st.max_step = max (st.max_step, step);
+	st.max_cfl = max (st.max_cfl, speed * step);
+	return step;
+}
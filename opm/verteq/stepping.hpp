@@ -0,0 +1,141 @@
+#ifndef OPM_VERTEQ_STEPPING_HPP_INCLUDED
+#define OPM_VERTEQ_STEPPING_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <iosfwd>
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+namespace Opm {
+
+// forward declaration
+class TwophaseState;
+class VertEq;
+
+namespace parameter {
+class ParameterGroup;
+} // namespace parameter
+
+/**
+ * Statistics of the steps that has been taken by a StepControl.
+ */
+struct OPM_VERTEQ_PUBLIC StepStats {
+	/// Number of report steps that has been split
+	int report_steps;
+
+	/// Total number of steps that has been taken
+	int substeps;
+
+	/// Length of the shortest and longest step, in seconds
+	double min_step;
+	double max_step;
+
+	/// Highest CFL number of any step, as it was estimated
+	double max_cfl;
+
+	StepStats ();
+
+	/**
+	 * Write the statistics in the same format as SimulatorReport::report
+	 */
+	void report (std::ostream& os) const;
+};
+
+/**
+ * Choose the length of the steps inside a report step, based on the
+ * speed with which the saturation may change in each column.
+ *
+ * The speed is the derivative of the flux of CO2 out of the column with
+ * respect to the saturation, divided by the pore volume. The flux has a
+ * viscous part, which is driven by the total flux of the coarse state
+ * and the fractional flow, a buoyancy part, which is driven by the local
+ * slope of the caprock over each face (from VertEq::gravity_potential),
+ * and a diffusive part from the derivative of the upscaled capillary
+ * pressure (which is where the VE model represents the segregation of
+ * the phases). The derivatives are evaluated from the upscaled
+ * properties, in the columns around the plume only; in the other
+ * columns there is nothing that can move.
+ *
+ * The step is chosen such that the highest speed times the step is the
+ * CFL number that is requested, but it does not grow faster than a given
+ * factor from one step to the next, since the flux is not known until
+ * the pressure has been solved for the step. The remainder of the report
+ * step is divided in steps of equal length.
+ *
+ * Parameters that are read:
+ *
+ * * verteq_cfl (default 1.0): Target CFL number.
+ * * verteq_initial_step_days (default 1.0): Length of the first step.
+ * * verteq_step_growth (default 2.0): Maximum ratio between two steps.
+ * * verteq_max_substeps (default 100): Maximum number of steps inside
+ *   each report step, which is also what decides the shortest step.
+ */
+class OPM_VERTEQ_PUBLIC StepControl {
+public:
+	/**
+	 * @param ve Model that the steps are taken in. This object is not
+	 *           adopted, but must be live over the lifetime of this one.
+	 * @param param Parameters, see above.
+	 */
+	StepControl (VertEq& ve,
+	             const parameter::ParameterGroup& param);
+
+	/**
+	 * Highest rate of change of the saturation of any column, relative
+	 * to the saturation, i.e. the inverse of the time it takes to fill
+	 * the column.
+	 *
+	 * @param coarseScale Current state of the upscaled domain.
+	 * @return Rate in 1/s, or zero if nothing moves.
+	 */
+	double wave_speed (const TwophaseState& coarseScale) const;
+
+	/**
+	 * Start a new report step.
+	 *
+	 * @param length Length of the report step, in seconds.
+	 */
+	void begin (double length);
+
+	/**
+	 * Length of the next step.
+	 *
+	 * @param coarseScale Current state of the upscaled domain.
+	 * @param remaining Time left of the report step, in seconds.
+	 * @return Length of the step, in seconds. This is never longer than
+	 *         the remaining time, and equal to it at the end.
+	 */
+	double next_step (const TwophaseState& coarseScale,
+	                  double remaining);
+
+	/**
+	 * Statistics of the steps that has been taken so far.
+	 */
+	const StepStats& stats () const { return st; }
+
+private:
+	VertEq& ve;
+
+	// parameters
+	double target_cfl;
+	double growth;
+	int max_substeps;
+
+	// pore volume of each column
+	std::vector <double> pv;
+
+	// length of the previous step, and the shortest one we allow
+	double last_step;
+	double min_step;
+
+	StepStats st;
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_STEPPING_HPP_INCLUDED */
@@ -0,0 +1,149 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/trans.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/utility/runlen.hpp>
+#include <opm/core/grid.h>
+#include <algorithm> // fill
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+// number of sides of each column; the lateral faces of the blocks in
+// the fine grid have the same tags as the sides of the columns
+const int QUAD_SIDES = 4;
+
+/**
+ * Half-transmissibility of a face of a block in the fine grid. This is
+ * the same formula as used in tpfa_htrans_compute.
+ */
+inline double
+half_trans (const UnstructuredGrid& g,
+            const double* perm,
+            int cell,
+            int face) {
+	const int dim = g.dimensions;
+	const double* K = &perm[cell * dim * dim];
+	const double* cc = &g.cell_centroids[cell * dim];
+	const double* fc = &g.face_centroids[face * dim];
+	const double* n = &g.face_normals[face * dim];
+
+	// normals are oriented from the first to the second cell of the
+	// face, so turn them outwards from this cell
+	const double sgn = g.face_cells[2 * face + 0] == cell ? 1. : -1.;
+
+	// (K n) . c / (c . c), where c is the vector from the cell centroid
+	// to the face centroid, and the normal is weighted with the area
+	double num = 0.;
+	double dist = 0.;
+	for (int j = 0; j < dim; ++j) {
+		const double c = fc[j] - cc[j];
+		double Kn = 0.;
+		for (int k = 0; k < dim; ++k) {
+			Kn += K[j * dim + k] * n[k];
+		}
+		num += c * Kn;
+		dist += c * c;
+	}
+	return sgn * num / dist;
+}
+
+/**
+ * Combine the half-transmissibilities on each side of a face in the
+ * top surface. This is the same formula as used in tpfa_trans_compute.
+ */
+inline double
+face_trans (const TopSurf& ts,
+            const vector <double>& htrans,
+            int face) {
+	double recip = 0.;
+	for (int side = 0; side < 2; ++side) {
+		const int col = ts.face_cells[2 * face + side];
+		if (col >= 0) {
+			// find the position of the face in the list of the column
+			for (int pos = ts.cell_facepos[col];
+			     pos != ts.cell_facepos[col + 1]; ++pos) {
+				if (ts.cell_faces[pos] == face) {
+					recip += 1. / htrans[pos];
+				}
+			}
+		}
+	}
+	return 1. / recip;
+}
+
+} // anonymous namespace
+
+TopSurfTrans::TopSurfTrans (const UnstructuredGrid& fine,
+                            const TopSurf& ts,
+                            const double* perm)
+	: htrans (ts.cell_facepos[ts.number_of_cells], 0.)
+	, trans (ts.number_of_faces, 0.) {
+
+	// computing from scratch is the same as updating every column
+	vector <int> all (ts.number_of_cells);
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		all[col] = col;
+	}
+	update (fine, ts, perm, ts.number_of_cells, all.empty () ? 0 : &all[0]);
+}
+
+TopSurfTrans::TopSurfTrans (const UnstructuredGrid& fine,
+                            const TopSurf& ts,
+                            const double* perm,
+                            int num_cols,
+                            const int* cols)
+	: htrans (ts.cell_facepos[ts.number_of_cells], 0.)
+	, trans (ts.number_of_faces, 0.) {
+	update (fine, ts, perm, num_cols, cols);
+}
+
+void
+TopSurfTrans::update (const UnstructuredGrid& fine,
+                      const TopSurf& ts,
+                      const double* perm,
+                      int num_cols,
+                      const int* cols) {
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+
+	for (int i = 0; i < num_cols; ++i) {
+		const int col = cols[i];
+
+		// accumulate each side of the column separately; the position of
+		// the side in the top surface is given by its tag
+		double* side = &htrans[ts.cell_facepos[col]];
+		fill (side, side + QUAD_SIDES, 0.);
+
+		// add the lateral faces of each block; a block may have several
+		// faces on one side if there is a fault
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			const int cell = col_cells[col][row];
+			for (int pos = fine.cell_facepos[cell];
+			     pos != fine.cell_facepos[cell + 1]; ++pos) {
+				const int tag = fine.cell_facetag[pos];
+				if (tag < QUAD_SIDES) {
+					side[tag] += half_trans (fine, perm, cell, fine.cell_faces[pos]);
+				}
+			}
+		}
+
+		// the properties are averaged over the height of the column, so
+		// the transmissibilities must be for a unit height too
+		for (int tag = 0; tag < QUAD_SIDES; ++tag) {
+			side[tag] /= ts.h_tot[col];
+		}
+	}
+
+	// combine the halves of every face around the columns that have
+	// changed; a face between two of them is just done twice
+	for (int i = 0; i < num_cols; ++i) {
+		const int col = cols[i];
+		for (int pos = ts.cell_facepos[col];
+		     pos != ts.cell_facepos[col + 1]; ++pos) {
+			const int face = ts.cell_faces[pos];
+			trans[face] = face_trans (ts, htrans, face);
+		}
+	}
+}
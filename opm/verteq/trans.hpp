@@ -0,0 +1,105 @@
+#ifndef OPM_VERTEQ_TRANS_HPP_INCLUDED
+#define OPM_VERTEQ_TRANS_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+// forward declaration
+struct TopSurf;
+
+/**
+ * Transmissibilities of the top surface, integrated from the fine grid.
+ *
+ * The half-transmissibility of each side of a column is the sum of the
+ * half-transmissibilities of the lateral faces of the blocks in the
+ * column on that side, using the permeability and geometry of the fine
+ * grid. This accounts for layering in the column, which is lost when
+ * the transmissibilities are computed from the depth-averaged
+ * permeability and the geometry of the top surface.
+ *
+ * As the upscaled model is formulated per unit height, the sums are
+ * divided by the height of the column. The half-transmissibilities of
+ * the two columns on each side of a face are then combined harmonically.
+ *
+ * The arrays are in the same format as those of tpfa_htrans_compute and
+ * tpfa_trans_compute, for the top surface grid, and may be passed on to
+ * a pressure solver in place of these.
+ *
+ * @example
+ * @code{.cpp}
+ * TopSurfTrans T (grid, *ts, props.permeability ());
+ * assemble (ts->number_of_faces, &T.trans[0], ...);
+ * @endcode
+ */
+struct OPM_VERTEQ_PUBLIC TopSurfTrans {
+	/**
+	 * Half-transmissibility for each face of each column, in the same
+	 * order as the cell_faces array of the top surface.
+	 */
+	std::vector <double> htrans;
+
+	/**
+	 * Transmissibility of each face in the top surface. Faces on the
+	 * boundary only get the half-transmissibility of their column.
+	 */
+	std::vector <double> trans;
+
+	/**
+	 * Compute the transmissibilities for all the columns.
+	 *
+	 * @param fine Grid that the top surface was created from.
+	 * @param ts Top surface of the grid.
+	 * @param perm Permeability tensor (3x3) of each block in the fine
+	 *             grid, as returned from the properties.
+	 */
+	TopSurfTrans (const UnstructuredGrid& fine,
+	              const TopSurf& ts,
+	              const double* perm);
+
+	/**
+	 * Compute the transmissibilities for some of the columns only, e.g.
+	 * those that are local to this process when the top surface is
+	 * partitioned. Faces between a column in the list and one that is
+	 * not, get no transmissibility.
+	 *
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of columns in the top surface.
+	 *
+	 * The other parameters are the same as for the constructor above.
+	 */
+	TopSurfTrans (const UnstructuredGrid& fine,
+	              const TopSurf& ts,
+	              const double* perm,
+	              int num_cols,
+	              const int* cols);
+
+	/**
+	 * Compute the transmissibilities again for some of the columns, after
+	 * the permeability of the blocks in them has changed.
+	 *
+	 * @param num_cols Number of columns in the list.
+	 * @param cols Indices of columns in the top surface.
+	 *
+	 * The other parameters are the same as for the constructor.
+	 */
+	void update (const UnstructuredGrid& fine,
+	             const TopSurf& ts,
+	             const double* perm,
+	             int num_cols,
+	             const int* cols);
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_TRANS_HPP_INCLUDED */
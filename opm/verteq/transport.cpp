@@ -0,0 +1,410 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/transport.hpp>
+#include <opm/verteq/plume.hpp>
+#include <opm/verteq/props.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/core/grid.h>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/transport/reorder/tarjan.h>
+#include <algorithm> // max, min, sort, unique
+#include <cmath>     // fabs
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+const int NUM_PHASES = 2;
+const int NUM_PHASES_SQ = NUM_PHASES * NUM_PHASES;
+
+} // anonymous namespace
+
+TransportSolverVE::TransportSolverVE (const UnstructuredGrid& g,
+                                      const IncompPropertiesInterface& props,
+                                      const double* trans,
+                                      const double* gpot,
+                                      double tol,
+                                      int max_iter,
+                                      const PlumeSet* plume)
+	: g (g)
+	, props (props)
+	, tol (tol)
+	, max_iter (max_iter)
+	, plume (plume)
+	, gas (VertEqProps::gas_phase (props))
+	, wat (1 - gas)
+	, smin (g.number_of_cells)
+	, smax (g.number_of_cells)
+	, buoy (g.cell_facepos[g.number_of_cells])
+	, nb (g.cell_facepos[g.number_of_cells])
+	, vout (g.cell_facepos[g.number_of_cells])
+	, sat0 (g.number_of_cells)
+	, sat (g.number_of_cells)
+	, mob (g.number_of_cells * NUM_PHASES, 0.)
+	, idx (g.number_of_cells, -1)
+	, num_comps (0)
+	, max_comp (0)
+	, num_lvls (0) {
+
+	visc[gas] = props.viscosity ()[gas];
+	visc[wat] = props.viscosity ()[wat];
+
+	// limits of the saturation do not depend on the state
+	vector <int> cells (g.number_of_cells);
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		cells[cell] = cell;
+	}
+	vector <double> lo (g.number_of_cells * NUM_PHASES);
+	vector <double> hi (g.number_of_cells * NUM_PHASES);
+	props.satRange (g.number_of_cells, &cells[0], &lo[0], &hi[0]);
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		smin[cell] = lo[cell * NUM_PHASES + gas];
+		smax[cell] = hi[cell * NUM_PHASES + gas];
+	}
+
+	// the buoyancy does not depend on the state either; it is the
+	// density difference times the difference in gravity potential
+	// between the columns, which drives CO2 up-dip. the potential is
+	// relative to the top of each column, so the difference over a face
+	// is the local difference in the height of the caprock
+	const double drho = props.density ()[wat] - props.density ()[gas];
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		for (int pos = g.cell_facepos[cell];
+		     pos != g.cell_facepos[cell + 1]; ++pos) {
+			const int face = g.cell_faces[pos];
+			const int other = g.face_cells[2 * face + 0] == cell
+			                ? g.face_cells[2 * face + 1]
+			                : g.face_cells[2 * face + 0];
+			nb[pos] = other;
+			if (other < 0) {
+				buoy[pos] = 0.;
+				continue;
+			}
+			// same face, seen from the other column
+			int opp = g.cell_facepos[other];
+			while (g.cell_faces[opp] != face) {
+				++opp;
+			}
+			buoy[pos] = trans[face] * drho * (gpot[opp] - gpot[pos]);
+		}
+	}
+}
+
+TransportSolverVE::~TransportSolverVE () {
+}
+
+double
+TransportSolverVE::residual (int cell,
+                             double s,
+                             double pv,
+                             double src,
+                             double dt,
+                             double& deriv) const {
+	// mobilities of this cell at the trial saturation; derivatives are
+	// with respect to the CO2 saturation (same layout as VertEqProps)
+	double sat_rec[NUM_PHASES];
+	sat_rec[gas] = s;
+	sat_rec[wat] = 1. - s;
+	double kr[NUM_PHASES];
+	double dkr[NUM_PHASES_SQ];
+	props.relperm (1, sat_rec, &cell, kr, dkr);
+	const double lg = kr[gas] / visc[gas];
+	const double lw = kr[wat] / visc[wat];
+	const double dlg = dkr[NUM_PHASES * gas + gas] / visc[gas];
+	const double dlw = dkr[NUM_PHASES * wat + gas] / visc[wat];
+
+	// fractional flow of CO2
+	const double lt = lg + lw;
+	const double f = lt > 0. ? lg / lt : 0.;
+	const double df = lt > 0. ? (dlg * lw - lg * dlw) / (lt * lt) : 0.;
+
+	// accumulation
+	double r = pv / dt * (s - sat0[cell]);
+	deriv = pv / dt;
+
+	// injection is pure CO2, production is what flows in the cell
+	if (src > 0.) {
+		r -= src;
+	}
+	else {
+		r -= src * f;
+		deriv -= src * df;
+	}
+
+	for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+		const int other = nb[pos];
+
+		// viscous part, upwinded with the total flux. inflow over the
+		// boundary is assumed to be brine
+		const double v = vout[pos];
+		if (v > 0.) {
+			r += v * f;
+			deriv += v * df;
+		}
+		else if (v < 0. && other >= 0) {
+			const double lg_o = mob[other * NUM_PHASES + gas];
+			const double lw_o = mob[other * NUM_PHASES + wat];
+			if (lg_o > 0.) {
+				r += v * lg_o / (lg_o + lw_o);
+			}
+		}
+
+		// buoyancy part; CO2 is taken from the deeper cell and brine from
+		// the shallower one. only read the other cell if there is CO2 in
+		// the deeper one, otherwise it may be solved concurrently
+		const double G = buoy[pos];
+		if (G > 0. && lg > 0.) {
+			const double lw_o = mob[other * NUM_PHASES + wat];
+			const double den = lg + lw_o;
+			r += G * lg * lw_o / den;
+			deriv += G * dlg * lw_o * lw_o / (den * den);
+		}
+		else if (G < 0.) {
+			const double lg_o = mob[other * NUM_PHASES + gas];
+			if (lg_o > 0.) {
+				const double den = lg_o + lw;
+				r += G * lg_o * lw / den;
+				deriv += G * dlw * lg_o * lg_o / (den * den);
+			}
+		}
+	}
+	return r;
+}
+
+double
+TransportSolverVE::solve_cell (int cell, double pv, double src, double dt) {
+	// if there is no CO2 in the cell, and none can come in, then there
+	// is nothing to do. this is the case for most of the domain, and the
+	// mobility of the cell is not even evaluated
+	if (sat0[cell] <= 0. && src <= 0.) {
+		bool inflow = false;
+		for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+			const int other = nb[pos];
+			if (other >= 0 && (vout[pos] < 0. || buoy[pos] < 0.) &&
+			    mob[other * NUM_PHASES + gas] > 0.) {
+				inflow = true;
+				break;
+			}
+		}
+		if (!inflow) {
+			return 0.;
+		}
+	}
+
+	// safeguarded Newton; the residual is increasing in the saturation,
+	// so the sign of it tells which part of the bracket to keep
+	double lo = smin[cell];
+	double hi = smax[cell];
+	double s = max (lo, min (hi, sat[cell]));
+	const double old = s;
+	for (int it = 0; it < max_iter; ++it) {
+		double deriv;
+		const double r = residual (cell, s, pv, src, dt, deriv);
+		if (r > 0.) {
+			hi = s;
+		}
+		else {
+			lo = s;
+		}
+
+		// bisect if the Newton step goes outside of the bracket
+		double next = deriv > 0. ? s - r / deriv : lo - 1.;
+		if (!(next > lo && next < hi)) {
+			next = 0.5 * (lo + hi);
+		}
+		const bool done = fabs (next - s) < tol || hi - lo < tol;
+		s = next;
+		if (done) {
+			break;
+		}
+	}
+	sat[cell] = s;
+	update_mob (cell);
+	return fabs (s - old);
+}
+
+void
+TransportSolverVE::update_mob (int cell) {
+	double sat_rec[NUM_PHASES];
+	sat_rec[gas] = sat[cell];
+	sat_rec[wat] = 1. - sat[cell];
+	double kr[NUM_PHASES];
+	props.relperm (1, sat_rec, &cell, kr, 0);
+	mob[cell * NUM_PHASES + gas] = kr[gas] / visc[gas];
+	mob[cell * NUM_PHASES + wat] = kr[wat] / visc[wat];
+}
+
+void
+TransportSolverVE::solve (const double* porevolume,
+                          const double* source,
+                          const double dt,
+                          TwophaseState& state) {
+	const int nc = g.number_of_cells;
+	const vector <double>& flux = state.faceflux ();
+	vector <double>& s = state.saturation ();
+
+	// find the cells which may get CO2 in this step; these are the ones
+	// that can be reached from the CO2 there is now, or that is injected,
+	// following the total flux or going up-dip. the rest of the cells
+	// keep their saturation, and are not looked at any further
+	vector <int> cells;
+	const int num_seeds = plume ? plume->size () : nc;
+	for (int i = 0; i < num_seeds; ++i) {
+		const int cell = plume ? plume->cols ()[i] : i;
+		if (s[cell * NUM_PHASES + gas] > 0. || source[cell] > 0.) {
+			idx[cell] = static_cast <int> (cells.size ());
+			cells.push_back (cell);
+		}
+	}
+	for (size_t i = 0; i < cells.size (); ++i) {
+		const int cell = cells[i];
+		for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+			// total flux out of the cell
+			const int face = g.cell_faces[pos];
+			const double sgn = g.face_cells[2 * face + 0] == cell ? 1. : -1.;
+			vout[pos] = sgn * flux[face];
+
+			const int other = nb[pos];
+			if (other >= 0 && idx[other] < 0 && (vout[pos] > 0. || buoy[pos] > 0.)) {
+				idx[other] = static_cast <int> (cells.size ());
+				cells.push_back (other);
+			}
+		}
+	}
+	const int n = static_cast <int> (cells.size ());
+
+	// start from the saturation of the state; the mobilities of all the
+	// cells that are reached are evaluated in one call. the others have
+	// no CO2, and their mobility of CO2 is left at zero
+	{
+		vector <double> sat_rec (n * NUM_PHASES);
+		vector <double> kr (n * NUM_PHASES);
+		for (int i = 0; i < n; ++i) {
+			const int cell = cells[i];
+			sat0[cell] = sat[cell] = s[cell * NUM_PHASES + gas];
+			sat_rec[i * NUM_PHASES + gas] = sat[cell];
+			sat_rec[i * NUM_PHASES + wat] = 1. - sat[cell];
+		}
+		if (n > 0) {
+			props.relperm (n, &sat_rec[0], &cells[0], &kr[0], 0);
+		}
+		for (int i = 0; i < n; ++i) {
+			const int cell = cells[i];
+			mob[cell * NUM_PHASES + gas] = kr[i * NUM_PHASES + gas] / visc[gas];
+			mob[cell * NUM_PHASES + wat] = kr[i * NUM_PHASES + wat] / visc[wat];
+		}
+	}
+
+	// dependency graph among the cells that are reached, numbered in the
+	// order they were found; the neighbours of each cell are those which
+	// must be solved before it
+	vector <int> ia (n + 1, 0);
+	vector <int> ja;
+	for (int i = 0; i < n; ++i) {
+		const int cell = cells[i];
+		const size_t start = ja.size ();
+		for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+			const int other = nb[pos];
+			if (other < 0 || idx[other] < 0) {
+				continue;
+			}
+			if (vout[pos] < 0. || buoy[pos] != 0.) {
+				ja.push_back (idx[other]);
+			}
+		}
+		// two cells may share more than one face
+		sort (ja.begin () + start, ja.end ());
+		ja.erase (unique (ja.begin () + start, ja.end ()), ja.end ());
+		ia[i + 1] = static_cast <int> (ja.size ());
+	}
+
+	// strongly connected components, where the ones that are depended
+	// upon come first
+	vector <int> seq (n);
+	vector <int> comp (n + 1);
+	vector <int> work (3 * n);
+	int ncomp = 0;
+	if (n > 0) {
+		tarjan (n, &ia[0], ja.empty () ? 0 : &ja[0],
+		        &seq[0], &comp[0], &ncomp, &work[0]);
+	}
+
+	// level of each component; it is one more than the highest level of
+	// those it depends on, so that components on the same level can be
+	// solved independently of each other
+	vector <int> comp_of (n);
+	for (int k = 0; k < ncomp; ++k) {
+		for (int i = comp[k]; i < comp[k + 1]; ++i) {
+			comp_of[seq[i]] = k;
+		}
+	}
+	vector <int> level (ncomp, 0);
+	num_lvls = 0;
+	max_comp = 0;
+	for (int k = 0; k < ncomp; ++k) {
+		for (int i = comp[k]; i < comp[k + 1]; ++i) {
+			const int v = seq[i];
+			for (int nz = ia[v]; nz < ia[v + 1]; ++nz) {
+				const int dep = comp_of[ja[nz]];
+				if (dep != k) {
+					level[k] = max (level[k], level[dep] + 1);
+				}
+			}
+		}
+		num_lvls = max (num_lvls, level[k] + 1);
+		max_comp = max (max_comp, comp[k + 1] - comp[k]);
+	}
+	num_comps = ncomp;
+
+	// sort the components by level (counting sort, keeping the order)
+	vector <int> lvl_pos (num_lvls + 1, 0);
+	for (int k = 0; k < ncomp; ++k) {
+		++lvl_pos[level[k] + 1];
+	}
+	for (int l = 0; l < num_lvls; ++l) {
+		lvl_pos[l + 1] += lvl_pos[l];
+	}
+	vector <int> by_lvl (ncomp);
+	{
+		vector <int> next (lvl_pos.begin (), lvl_pos.end () - 1);
+		for (int k = 0; k < ncomp; ++k) {
+			by_lvl[next[level[k]]++] = k;
+		}
+	}
+
+	// solve the components of each level; a single cell is solved
+	// directly, and the cells of a larger component are iterated until
+	// none of them change anymore
+	for (int l = 0; l < num_lvls; ++l) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule (dynamic, 16)
+#endif /* _OPENMP */
+		for (int m = lvl_pos[l]; m < lvl_pos[l + 1]; ++m) {
+			const int k = by_lvl[m];
+			for (int it = 0; it < max_iter; ++it) {
+				double change = 0.;
+				for (int i = comp[k]; i < comp[k + 1]; ++i) {
+					const int cell = cells[seq[i]];
+					change = max (change, solve_cell (cell, porevolume[cell],
+					                                  source[cell], dt));
+				}
+				if (comp[k + 1] - comp[k] == 1 || change < tol) {
+					break;
+				}
+			}
+		}
+	}
+
+	// write the result back into the state, and leave the cells as
+	// not reached (with no mobility of CO2) for the next step
+	for (int i = 0; i < n; ++i) {
+		const int cell = cells[i];
+		s[cell * NUM_PHASES + gas] = sat[cell];
+		s[cell * NUM_PHASES + wat] = 1. - sat[cell];
+		mob[cell * NUM_PHASES + gas] = 0.;
+		mob[cell * NUM_PHASES + wat] = 0.;
+		idx[cell] = -1;
+	}
+}
@@ -0,0 +1,192 @@
+#ifndef OPM_VERTEQ_TRANSPORT_HPP_INCLUDED
+#define OPM_VERTEQ_TRANSPORT_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+#ifndef OPM_TRANSPORTSOLVERTWOPHASEINTERFACE_HEADER_INCLUDED
+#include <opm/core/transport/TransportSolverTwophaseInterface.hpp>
+#endif /* OPM_TRANSPORTSOLVERTWOPHASEINTERFACE_HEADER_INCLUDED */
+
+// forward declaration
+struct UnstructuredGrid;
+
+namespace Opm {
+
+// forward declaration
+class IncompPropertiesInterface;
+class PlumeSet;
+class TwophaseState;
+
+/**
+ * Implicit transport solver for the top surface, which solves for one
+ * cell at a time in upwind order.
+ *
+ * The flux of CO2 over each face is split into a viscous part, which is
+ * upwinded with the total flux, and a buoyancy part, which is driven by
+ * the difference in the height of the caprock between the columns; here
+ * CO2 is taken from the deeper column and brine from the shallower one.
+ * A cell thus only depends on neighbours that are upstream of the total
+ * flux, or that are up-dip or down-dip of it when there can be CO2 in
+ * the deeper of them.
+ *
+ * The cells are ordered by computing the strongly connected components
+ * of this dependency graph (with Tarjan's algorithm). Where CO2 and
+ * brine flow in opposite directions, the cells depend on each other and
+ * end up in the same component, which is then solved by Gauss-Seidel
+ * iterations; elsewhere each component is a single cell which is solved
+ * with a safeguarded Newton method. Components which do not depend on
+ * each other, directly or indirectly, are solved in parallel when the
+ * library is built with OpenMP.
+ *
+ * Only the cells which can get CO2 in the step, i.e. those which can be
+ * reached from the cells that have CO2 or an injector by following the
+ * total flux or going up-dip, are part of the graph; the others keep
+ * their saturation. The mobility of each of these cells is computed once
+ * at the start of the step, and again each time the cell is solved, so
+ * that the relative permeability of the upscaled properties (which
+ * involves finding the interface in the column) is not evaluated for
+ * the rest of the domain at all. If a PlumeSet is given, the search for
+ * those cells starts from the columns in it instead of from every cell.
+ *
+ * @example
+ * @code{.cpp}
+ * TransportSolverVE tsolver (ve->grid (), ve->props (),
+ *                            &ve->trans ().trans[0],
+ *                            &ve->gravity_potential ()[0],
+ *                            1e-9, 30, &ve->plume ());
+ * tsolver.solve (&porevol[0], &src[0], dt, state);
+ * @endcode
+ */
+class OPM_VERTEQ_PUBLIC TransportSolverVE
+	: public TransportSolverTwophaseInterface {
+public:
+	/**
+	 * Setup the solver for a grid.
+	 *
+	 * @param g Top surface grid. This object is not adopted, but must be
+	 *          live over the lifetime of the solver (as must the others).
+	 * @param props Upscaled properties; the lighter phase is CO2 and the
+	 *              other one is brine (see VertEqProps::gas_phase).
+	 * @param trans Transmissibility of each face, e.g. from TopSurfTrans.
+	 * @param gpot Gravity potential of each face of each column, relative
+	 *             to the column, e.g. from VertEq::gravity_potential; the
+	 *             difference between the two sides of a face is what
+	 *             drives the buoyancy over it.
+	 * @param tol Convergence criterion for the change in saturation.
+	 * @param max_iter Maximum number of iterations for each cell, and of
+	 *                 Gauss-Seidel sweeps for each component.
+	 * @param plume Columns where there can be CO2 at the start of each
+	 *              step, e.g. ve->plume (); every column that has CO2 or
+	 *              a positive source must be in it, which holds when the
+	 *              model has been notified after the last step. If it is
+	 *              null, every cell is looked at.
+	 */
+	TransportSolverVE (const UnstructuredGrid& g,
+	                   const IncompPropertiesInterface& props,
+	                   const double* trans,
+	                   const double* gpot,
+	                   double tol = 1e-9,
+	                   int max_iter = 30,
+	                   const PlumeSet* plume = 0);
+
+	virtual ~TransportSolverVE ();
+
+	/**
+	 * Solve the transport equation for one timestep.
+	 *
+	 * @param porevolume Pore volume of each cell.
+	 * @param source Volumetric source term for each cell. Inflow (positive)
+	 *               is CO2, outflow (negative) is at the fractional flow
+	 *               of the cell.
+	 * @param dt Length of the timestep.
+	 * @param state The faceflux member holds the total flux, and the
+	 *              saturation member is advanced to the end of the step.
+	 */
+	virtual void solve (const double* porevolume,
+	                    const double* source,
+	                    const double dt,
+	                    TwophaseState& state);
+
+	/**
+	 * Number of strongly connected components in the last solve.
+	 */
+	int num_components () const { return num_comps; }
+
+	/**
+	 * Number of cells in the largest component in the last solve; this is
+	 * one if there were no counter-current flow.
+	 */
+	int max_component () const { return max_comp; }
+
+	/**
+	 * Number of wavefronts in the last solve, i.e. the length of the
+	 * longest chain of components that depend on each other.
+	 */
+	int num_levels () const { return num_lvls; }
+
+private:
+	const UnstructuredGrid& g;
+	const IncompPropertiesInterface& props;
+	const double tol;
+	const int max_iter;
+	const PlumeSet* plume;
+
+	// index of the CO2 and of the brine phase
+	const int gas;
+	const int wat;
+
+	// viscosity of each phase
+	double visc[2];
+
+	// range of the CO2 saturation in each cell
+	std::vector <double> smin;
+	std::vector <double> smax;
+
+	// buoyancy term for each half-face; it is positive when the CO2 is
+	// driven out of the cell, i.e. when the cell is the deeper one
+	std::vector <double> buoy;
+
+	// other cell of each half-face, or negative on the boundary
+	std::vector <int> nb;
+
+	// total flux out of the cell over each half-face, in this step; it is
+	// only set for the cells that are reached
+	std::vector <double> vout;
+
+	// saturation of CO2 at the start and at the end of the step
+	std::vector <double> sat0;
+	std::vector <double> sat;
+
+	// mobility of CO2 and brine in each cell, at the current saturation;
+	// it is zero for the cells that are not reached in this step
+	std::vector <double> mob;
+
+	// index of each cell among those reached in this step, or negative
+	std::vector <int> idx;
+
+	// statistics
+	int num_comps;
+	int max_comp;
+	int num_lvls;
+
+	// solve for one cell with the neighbours fixed, and return the change
+	double solve_cell (int cell, double pv, double src, double dt);
+
+	// residual of the cell equation and its derivative
+	double residual (int cell, double s, double pv, double src, double dt,
+	                 double& deriv) const;
+
+	// update the cached mobility from the saturation
+	void update_mob (int cell);
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_TRANSPORT_HPP_INCLUDED */
@@ -1,6 +1,8 @@
 #include <opm/verteq/upscale.hpp>
 #include <opm/verteq/utility/exc.hpp>
+#include <opm/verteq/utility/instrument.hpp>
 #include <opm/verteq/utility/runlen.hpp>
+#include <algorithm> // min, max, upper_bound
 #include <cmath> // floor
 
 using namespace Opm;
@@ -167,11 +169,23 @@ VertEqUpscaler::eval (
 	return before + (dpt_col[row] - before) * zeta.fraction ();
 }
 
+namespace {
+
+/**
+ * Interpolation search for the target in a table of increasing values,
+ * where the first entry implicitly is preceeded by zero.
+ *
+ * @param dpt Table to search in.
+ * @param num_rows Number of entries in the table.
+ * @param target Value to search for.
+ * @return Index of the entry where the target is, and the fraction of
+ *         the way from the previous entry.
+ */
 Elevation
-VertEqUpscaler::find (
-		int col,
+interp_find (
 		const double* dpt,
-		const double target) const {
+		const int num_rows,
+		const double target) {
 
 	// use interpolation search to find the proper block for this
 	// (relative) depth. under the assumption that all individual
@@ -188,13 +202,14 @@ VertEqUpscaler::find (
 
 	// bottom of the searching scope. bot_hgt is the height of the
 	// *end* of the block, like what is in up_bnd
-	int bot_ndx = num_rows (col) - 1;
+	int bot_ndx = num_rows - 1;
 	double bot_val = dpt[bot_ndx]; // target <=bot_val
 
 	// input sanity check; if we get an out-of-range error it is usually
 	// because the reservoir has been initialized with a brine saturation
 	// which is lower than the residual saturation
 	if (! ((top_val <= target) && (target <= bot_val))) {
+		OPM_VERTEQ_COUNT (out_of_range, 1);
 		throw OPM_EXC ("Target %g out of range [%g, %g]; "
 		               "check initial CO2 saturation",
 		               target, top_val, bot_val);
@@ -203,13 +218,18 @@ VertEqUpscaler::find (
 	// search until we have a solution; as the search space get tighter
 	// and tighter, we must eventually end up with a solution if the
 	// saturation was between 0. and 1 initially.
+	int iters = 0;
 	for (;;) {
+		++iters;
 
 		// based on the fraction of the interval the target height is,
-		// guess at the index assuming that every block has equal height
-		const double frac = (target - top_val) / (bot_val - top_val);
-		const int cur_ndx = top_ndx + static_cast <int> (
-		                    std::floor ((bot_ndx - top_ndx + 1) * frac));
+		// guess at the index assuming that every block has equal height.
+		// a target at the bottom of the interval would give the block
+		// after it, and an empty interval has no fraction at all
+		const double frac = bot_val > top_val
+		                  ? (target - top_val) / (bot_val - top_val) : 0.;
+		const int cur_ndx = std::min (bot_ndx, top_ndx + static_cast <int> (
+		                    std::floor ((bot_ndx - top_ndx + 1) * frac)));
 
 		// get the brackets of this block; the weigted depth is the upper
 		// bound of the integral for each block. unfortunately we don't have
@@ -232,7 +252,202 @@ VertEqUpscaler::find (
 		else {
 			// get the fraction of this block
 			const double cur_frac = (target - cur_top) / (cur_bot - cur_top);
+			OPM_VERTEQ_COUNT (find_iters, iters);
 			return Elevation (cur_ndx, cur_frac);
 		}
 	}
 }
+
+} // anonymous namespace
+
+Elevation
+VertEqUpscaler::find (
+		int col,
+		const double* dpt,
+		const double target) const {
+	return interp_find (dpt, num_rows (col), target);
+}
+
+ColumnLayers::ColumnLayers (
+		const TopSurf& ts,
+		const std::vector <const RunLenView <double>*>& props)
+	: number_of_cells (ts.number_of_cells)
+	, col_layerpos (ts.number_of_cells + 1, 0) {
+
+	// there cannot be more layers than blocks
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	layer_end.reserve (ts.col_cellpos[ts.number_of_cells]);
+
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		// columns that have no entries of their own in the tables (because
+		// they share those of another column) get no layers either
+		int num_rows = col_cells.size (col);
+		for (size_t i = 0; i < props.size (); ++i) {
+			num_rows = std::min (num_rows, props[i]->size (col));
+		}
+		for (int row = 1; row <= num_rows; ++row) {
+			// a layer ends at the bottom of the column, or at the first
+			// block that differs from the one above it in any property
+			bool same = row < num_rows;
+			for (size_t i = 0; same && i < props.size (); ++i) {
+				const double* val = (*props[i])[col];
+				same = val[row] == val[row - 1];
+			}
+			if (!same) {
+				layer_end.push_back (row);
+			}
+		}
+		col_layerpos[col + 1] = static_cast <int> (layer_end.size ());
+	}
+}
+
+void
+ColumnLayers::compress (
+		const RunLenView <double>& dpt,
+		RunLenView <double>& res) const {
+
+	// the integral is linear within each layer, so only the value at the
+	// bottom of it is needed to interpolate anywhere inside
+	for (int col = 0; col < number_of_cells; ++col) {
+		const int* end_col = layer_end.data () + col_layerpos[col];
+		const int num_layers = col_layerpos[col + 1] - col_layerpos[col];
+		const double* dpt_col = dpt[col];
+		double* res_col = res[col];
+		for (int layer = 0; layer < num_layers; ++layer) {
+			res_col[layer] = dpt_col[end_col[layer] - 1];
+		}
+	}
+}
+
+double
+VertEqUpscaler::eval (
+		int col,
+		const ColumnLayers& layers,
+		const rlw_double& dpt,
+		const Elevation zeta) const {
+
+	// rows at the bottom of each of the layers in this column
+	const int* first = layers.layer_end.data () + layers.col_layerpos[col];
+	const int* last = layers.layer_end.data () + layers.col_layerpos[col + 1];
+
+	// layer that the block is in; the first one that ends below it. an
+	// elevation at the bottom of the column is put in the last layer
+	const int layer = std::min (
+		static_cast <int> (std::upper_bound (first, last, zeta.block ()) - first),
+		static_cast <int> (last - first) - 1);
+	const int top_row = layer == 0 ? 0 : first[layer - 1];
+	const int end_row = first[layer];
+
+	// value above this layer, same as in the regular eval
+	const double* dpt_col = dpt[col];
+	const double before = layer == 0 ? 0. : dpt_col[layer - 1];
+
+	// the integral is linear in depth inside the layer, so take the
+	// fraction of the height of it that is above the elevation. if the
+	// layer is only a block, then this is the fraction of the elevation
+	double frac = 1.;
+	if (zeta.block () < end_row) {
+		frac = zeta.fraction ();
+		if (end_row - top_row > 1) {
+			const rlw_double h (ts.number_of_cells, ts.col_cellpos, ts.h);
+			const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+			const double* h_col = h[col];
+			const double* dz_col = dz[col];
+			const double top = h_col[top_row];
+			const double bot = h_col[end_row - 1] + dz_col[end_row - 1];
+			const double at = h_col[zeta.block ()] + frac * dz_col[zeta.block ()];
+			frac = (at - top) / (bot - top);
+		}
+	}
+	return before + (dpt_col[layer] - before) * frac;
+}
+
+Elevation
+VertEqUpscaler::find (
+		int col,
+		const ColumnLayers& layers,
+		const double* dpt,
+		const double target) const {
+
+	// search among the layers only
+	const int* ends = layers.layer_end.data () + layers.col_layerpos[col];
+	const int num_layers = layers.col_layerpos[col + 1] - layers.col_layerpos[col];
+	const Elevation in_layer = interp_find (dpt, num_layers, target);
+
+	// a layer of a single block is the same as the regular search
+	const int layer = in_layer.block ();
+	const int top_row = layer == 0 ? 0 : ends[layer - 1];
+	const int end_row = ends[layer];
+	if (end_row - top_row == 1) {
+		return Elevation (top_row, in_layer.fraction ());
+	}
+
+	// depth that corresponds to the fraction of the layer, since the
+	// integral is linear in depth inside it
+	const rlw_double h (ts.number_of_cells, ts.col_cellpos, ts.h);
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	const double* h_col = h[col];
+	const double* dz_col = dz[col];
+	const double top = h_col[top_row];
+	const double bot = h_col[end_row - 1] + dz_col[end_row - 1];
+	const double at = top + in_layer.fraction () * (bot - top);
+
+	// block which starts at or above this depth, and the fraction of it
+	const int row = static_cast <int> (
+		std::upper_bound (h_col + top_row + 1, h_col + end_row, at) - h_col) - 1;
+	const double frac = std::min (1., std::max (0., (at - h_col[row]) / dz_col[row]));
+	return Elevation (row, frac);
+}
+
+double
+VertEqUpscaler::eval_uniform (
+		int col,
+		const double bot_val,
+		const Elevation zeta) const {
+
+	// an elevation at the bottom of the column has all of it above
+	const int row = zeta.block ();
+	if (row >= num_rows (col)) {
+		return bot_val;
+	}
+
+	// the value is proportional to the depth of the elevation
+	const rlw_double h (ts.number_of_cells, ts.col_cellpos, ts.h);
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	const double at = h[col][row] + zeta.fraction () * dz[col][row];
+	return bot_val * at / ts.h_tot[col];
+}
+
+Elevation
+VertEqUpscaler::find_uniform (
+		int col,
+		const double bot_val,
+		const double target) const {
+
+	// same sanity check as in the search
+	if (! ((0. <= target) && (target <= bot_val))) {
+		OPM_VERTEQ_COUNT (out_of_range, 1);
+		throw OPM_EXC ("Target %g out of range [%g, %g]; "
+		               "check initial CO2 saturation",
+		               target, 0., bot_val);
+	}
+
+	// if there is nothing of the property, then the target (which must
+	// be zero as well) is already reached at the top
+	if (bot_val <= 0.) {
+		return Elevation (0, 0.);
+	}
+
+	// depth at which the target is reached
+	const rlw_double h (ts.number_of_cells, ts.col_cellpos, ts.h);
+	const rlw_double dz (ts.number_of_cells, ts.col_cellpos, ts.dz);
+	const double* h_col = h[col];
+	const double* dz_col = dz[col];
+	const double at = target / bot_val * ts.h_tot[col];
+
+	// block which starts at or above this depth, and the fraction of it
+	const int row = static_cast <int> (
+		std::upper_bound (h_col + 1, h_col + num_rows (col), at) - h_col) - 1;
+	const double frac = std::min (1., std::max (0., (at - h_col[row]) / dz_col[row]));
+	return Elevation (row, frac);
+}
@@ -5,6 +5,7 @@
 // This file is licensed under the GNU General Public License v3.0
 
 #include <utility> // pair
+#include <vector>
 
 #ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
 #include <opm/verteq/visibility.hpp>
@@ -70,6 +71,63 @@ struct Elevation : private std::pair <int, double> {
 	bool operator< (const Elevation& rhs) const;
 };
 
+/**
+ * Layers of consecutive blocks in each column that have the same
+ * properties, so that tables which are integrated down the column are
+ * linear in the depth within each of them.
+ *
+ * Geological models are often built from a few layers, each split into
+ * many cells that are identical apart from their position; storing and
+ * searching the integrals only at the bottom of each layer gives the
+ * same results with a shorter table.
+ *
+ * The layers are found by comparing the integrands of the tables, not
+ * the rock properties themselves, so blocks that end up with the same
+ * values are merged even if they differ in something that does not
+ * matter for these tables.
+ */
+struct OPM_VERTEQ_PUBLIC ColumnLayers {
+	/**
+	 * Merge the rows in every column for which all of the properties
+	 * have the same value as the row above.
+	 *
+	 * @param topSurf Grid that the properties are defined on.
+	 * @param props Value of each property for each block, arranged in
+	 *              columns like in the top surface (e.g. the integrands
+	 *              given to VertEqUpscaler::wgt_dpt). A column which
+	 *              is empty in any of them gets no layers.
+	 */
+	ColumnLayers (const TopSurf& topSurf,
+	              const std::vector <const RunLenView <double>*>& props);
+
+	/**
+	 * Number of columns; this is the same as in the top surface.
+	 */
+	int number_of_cells;
+
+	/**
+	 * Index of the first layer of each column in layer_end, in the
+	 * same format as TopSurf::col_cellpos.
+	 */
+	std::vector <int> col_layerpos;
+
+	/**
+	 * Row in its column that is just below each layer, i.e. one past
+	 * the last block in it. The first block of the layer is the end of
+	 * the layer above, or the top of the column for the first.
+	 */
+	std::vector <int> layer_end;
+
+	/**
+	 * Pick the value of an integrated table at the bottom of each layer.
+	 *
+	 * @param dpt Integrated table for each block, from wgt_dpt().
+	 * @param res Table with one value for each layer, allocated with
+	 *            col_layerpos as starting indices.
+	 */
+	void compress (const RunLenView <double>& dpt, RunLenView <double>& res) const;
+};
+
 /**
  * Extension of the top surface that does integration across columns.
  * The extension is done by aggregation since these methods really are
@@ -220,6 +278,56 @@ struct VertEqUpscaler {
 	 */
 	Elevation find (int col, const double* dpt, const double target) const;
 
+	/**
+	 * Same as eval() above, but with a table that is compressed into
+	 * layers; the elevation is still given in blocks.
+	 *
+	 * @param layers Layers that the table was compressed with.
+	 * @param dpt Values at the bottom of each layer, from compress().
+	 */
+	double eval (int col,
+	             const ColumnLayers& layers,
+	             const rlw_double& dpt,
+	             const Elevation zeta) const;
+
+	/**
+	 * Same as find() above, but searching in a table that is compressed
+	 * into layers. The elevation returned is still given in blocks; the
+	 * search only goes through the layers, and then the block is found
+	 * from the depth within the layer.
+	 *
+	 * @param layers Layers that the table was compressed with.
+	 * @param dpt Values at the bottom of each layer in this column.
+	 */
+	Elevation find (int col,
+	                const ColumnLayers& layers,
+	                const double* dpt,
+	                const double target) const;
+
+	/**
+	 * Same as eval() above, for a property which is the same in every
+	 * block of the column. The integral is then linear in depth, and no
+	 * table is needed.
+	 *
+	 * @param bot_val Depth-weighted value of the property down to the
+	 *                bottom of the column, i.e. the property itself.
+	 */
+	double eval_uniform (int col,
+	                     const double bot_val,
+	                     const Elevation zeta) const;
+
+	/**
+	 * Same as find() above, for a property which is the same in every
+	 * block of the column; the elevation is found directly from the
+	 * fraction of the value at the bottom that the target is.
+	 *
+	 * @param bot_val Depth-weighted value of the property down to the
+	 *                bottom of the column, i.e. the property itself.
+	 */
+	Elevation find_uniform (int col,
+	                        const double bot_val,
+	                        const double target) const;
+
 protected:
 	const TopSurf& ts;
 };
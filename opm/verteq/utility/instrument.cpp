@@ -0,0 +1,73 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/utility/instrument.hpp>
+#include <iomanip>   // setw
+#include <ostream>
+
+using namespace Opm;
+using namespace std;
+
+PerfStats::PerfStats ()
+	: find_iters (0ul)
+	, out_of_range (0ul)
+	, bytes (0ul) {
+	for (int i = 0; i < NUM_SECTIONS; ++i) {
+		calls[i] = 0ul;
+		seconds[i] = 0.;
+	}
+}
+
+PerfStats&
+PerfStats::operator -= (const PerfStats& rhs) {
+	for (int i = 0; i < NUM_SECTIONS; ++i) {
+		calls[i] -= rhs.calls[i];
+		seconds[i] -= rhs.seconds[i];
+	}
+	find_iters -= rhs.find_iters;
+	out_of_range -= rhs.out_of_range;
+	bytes -= rhs.bytes;
+	return *this;
+}
+
+const char*
+PerfStats::name (Section section) {
+	static const char* names[NUM_SECTIONS] = {
+		"upscale",
+		"notify",
+		"relperm",
+		"capPress",
+		"downscale"
+	};
+	return names[section];
+}
+
+bool
+PerfStats::enabled () {
+#ifdef OPM_VERTEQ_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif /* OPM_VERTEQ_INSTRUMENT */
+}
+
+PerfStats&
+PerfStats::global () {
+	static PerfStats stats;
+	return stats;
+}
+
+void
+PerfStats::report (ostream& os) const {
+	if (!enabled ()) {
+		os << "VE instrumentation not compiled in" << endl;
+		return;
+	}
+	for (int i = 0; i < NUM_SECTIONS; ++i) {
+		const Section section = static_cast <Section> (i);
+		os << "Time in VE " << left << setw (18) << name (section) << right
+		   << seconds[i] << " (" << calls[i] << " calls)\n";
+	}
+	os << "Interface search iterations: " << find_iters << "\n"
+	   << "Interface out of range:      " << out_of_range << "\n"
+	   << "VE bytes touched:            " << bytes << endl;
+}
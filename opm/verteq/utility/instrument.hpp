@@ -0,0 +1,148 @@
+#ifndef OPM_VERTEQ_INSTRUMENT_HPP_INCLUDED
+#define OPM_VERTEQ_INSTRUMENT_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <chrono>
+#include <iosfwd>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+namespace Opm {
+
+/**
+ * Timings and counters for the parts of the upscaling which are called
+ * for every timestep.
+ *
+ * The library only collects these if it is compiled with the symbol
+ * OPM_VERTEQ_INSTRUMENT defined (configure with -DVERTEQ_INSTRUMENT=ON);
+ * otherwise the hooks in the code expand to nothing, and all the values
+ * stay zero.
+ *
+ * The counters are shared by all the models in the process, since the
+ * properties are evaluated by the simulator without going through the
+ * model. Take the difference of two snapshots to get the values for a
+ * certain period.
+ *
+ * @example
+ * @code{.cpp}
+ * const PerfStats before = PerfStats::global ();
+ * ...
+ * PerfStats spent = PerfStats::global ();
+ * spent -= before;
+ * spent.report (std::cout);
+ * @endcode
+ */
+struct OPM_VERTEQ_PUBLIC PerfStats {
+	/// Parts of the code that are timed. They may be nested, e.g. the
+	/// downscaling does a notification first.
+	enum Section {
+		UPSCALE,
+		NOTIFY,
+		RELPERM,
+		CAP_PRESS,
+		DOWNSCALE,
+		NUM_SECTIONS
+	};
+
+	/// Number of times each section has been entered
+	unsigned long calls[NUM_SECTIONS];
+
+	/// Wall-clock time spent in each section, in seconds
+	double seconds[NUM_SECTIONS];
+
+	/// Number of iterations done to find interfaces in the columns
+	unsigned long find_iters;
+
+	/// Number of targets that were outside of a column (and thrown for)
+	unsigned long out_of_range;
+
+	/// Size of the state and property arrays read and written
+	unsigned long bytes;
+
+	PerfStats ();
+
+	/**
+	 * Subtract an earlier snapshot of the counters.
+	 */
+	PerfStats& operator -= (const PerfStats& rhs);
+
+	/**
+	 * Write the statistics in the same format as SimulatorReport::report
+	 */
+	void report (std::ostream& os) const;
+
+	/**
+	 * Name of a section, as it is written in the report.
+	 */
+	static const char* name (Section section);
+
+	/**
+	 * Whether the library has been compiled to collect the statistics.
+	 */
+	static bool enabled ();
+
+	/**
+	 * Counters that are updated by the library.
+	 */
+	static PerfStats& global ();
+
+	/**
+	 * Add to one of the counters; this is safe to do from several threads.
+	 */
+	template <typename T>
+	static void add (T& counter, T amount) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif /* _OPENMP */
+		counter += amount;
+	}
+};
+
+/**
+ * Time a section from the point of declaration to the end of the scope.
+ */
+class OPM_VERTEQ_PUBLIC SectionTimer {
+public:
+	SectionTimer (PerfStats::Section section)
+		: section (section)
+		, start (std::chrono::steady_clock::now ()) {
+	}
+
+	~SectionTimer () {
+		const std::chrono::duration <double> elapsed =
+			std::chrono::steady_clock::now () - start;
+		PerfStats& stats = PerfStats::global ();
+		PerfStats::add (stats.calls[section], 1ul);
+		PerfStats::add (stats.seconds[section], elapsed.count ());
+	}
+
+private:
+	const PerfStats::Section section;
+	const std::chrono::steady_clock::time_point start;
+};
+
+} /* namespace Opm */
+
+/**
+ * Hooks to put in the code that should be instrumented. The timer
+ * lasts until the end of the enclosing scope.
+ *
+ *	OPM_VERTEQ_TIMED (RELPERM);
+ *	OPM_VERTEQ_COUNT (bytes, n * sizeof (double));
+ */
+#ifdef OPM_VERTEQ_INSTRUMENT
+#  define OPM_VERTEQ_TIMED(section) \
+	::Opm::SectionTimer opm_verteq_timer_ (::Opm::PerfStats::section)
+#  define OPM_VERTEQ_COUNT(counter, amount) \
+	::Opm::PerfStats::add (::Opm::PerfStats::global ().counter, \
+	                       static_cast <unsigned long> (amount))
+#else
+#  define OPM_VERTEQ_TIMED(section) static_cast <void> (0)
+#  define OPM_VERTEQ_COUNT(counter, amount) static_cast <void> (amount)
+#endif /* OPM_VERTEQ_INSTRUMENT */
+
+#endif /* OPM_VERTEQ_INSTRUMENT_HPP_INCLUDED */
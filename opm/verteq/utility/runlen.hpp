@@ -4,6 +4,11 @@
 // Copyright (C) 2013 Uni Research AS
 // This file is licensed under the GNU General Public License v3.0
 
+#include <algorithm> // upper_bound
+#include <cstddef>   // ptrdiff_t
+#include <iterator>  // random_access_iterator_tag
+#include <utility>   // swap
+
 // forward declaration
 struct UnstructuredGrid;
 
@@ -149,6 +154,220 @@ public:
     T& last (int col) const {
         return data [pos [col + 1] - 1];
     }
+
+    /**
+     * Elements of one column, together with the index of the column.
+     * This is what is returned when a column iterator is dereferenced.
+     */
+    class Column {
+    public:
+        Column (int col, T* first, T* last)
+            : col (col)
+            , first (first)
+            , past (last) {
+        }
+
+        /// Index of the column in the matrix
+        int index () const { return col; }
+
+        /// Number of elements in the column
+        int size () const { return static_cast <int> (past - first); }
+
+        /// Range of the elements; the pointers are random-access iterators
+        T* begin () const { return first; }
+        T* end () const { return past; }
+
+        T& operator [] (int row) const { return first [row]; }
+
+    private:
+        int col;
+        T* first;
+        T* past;
+    };
+
+    /**
+     * Iterator over the columns of the matrix.
+     *
+     * This is random-access so that it can be used as the loop variable
+     * of an OpenMP worksharing loop, or with the parallel algorithms of
+     * the standard library. Notice that dereferencing it returns a Column
+     * by value, since there is no such object stored.
+     */
+    class ColumnIterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef Column value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Column reference;
+        typedef void pointer;
+
+        ColumnIterator ()
+            : view (0)
+            , col (0) {
+        }
+
+        ColumnIterator (const RunLenView* view, int col)
+            : view (view)
+            , col (col) {
+        }
+
+        Column operator * () const {
+            return Column (col, (*view) [col], (*view) [col + 1]);
+        }
+        Column operator [] (difference_type n) const {
+            return *(*this + n);
+        }
+
+        ColumnIterator& operator ++ () { ++col; return *this; }
+        ColumnIterator& operator -- () { --col; return *this; }
+        ColumnIterator operator ++ (int) { ColumnIterator t (*this); ++col; return t; }
+        ColumnIterator operator -- (int) { ColumnIterator t (*this); --col; return t; }
+        ColumnIterator& operator += (difference_type n) { col += static_cast <int> (n); return *this; }
+        ColumnIterator& operator -= (difference_type n) { col -= static_cast <int> (n); return *this; }
+        ColumnIterator operator + (difference_type n) const { return ColumnIterator (view, col + static_cast <int> (n)); }
+        ColumnIterator operator - (difference_type n) const { return ColumnIterator (view, col - static_cast <int> (n)); }
+        friend ColumnIterator operator + (difference_type n, const ColumnIterator& it) { return it + n; }
+        difference_type operator - (const ColumnIterator& rhs) const { return col - rhs.col; }
+
+        bool operator == (const ColumnIterator& rhs) const { return col == rhs.col; }
+        bool operator != (const ColumnIterator& rhs) const { return col != rhs.col; }
+        bool operator <  (const ColumnIterator& rhs) const { return col <  rhs.col; }
+        bool operator >  (const ColumnIterator& rhs) const { return col >  rhs.col; }
+        bool operator <= (const ColumnIterator& rhs) const { return col <= rhs.col; }
+        bool operator >= (const ColumnIterator& rhs) const { return col >= rhs.col; }
+
+    private:
+        const RunLenView* view;
+        int col;
+    };
+
+    /**
+     * Iterator over every element in the matrix, column by column, which
+     * also knows which column (and row within it) it is at.
+     *
+     * Moving to the next element is done in constant time; jumping is
+     * done with a binary search on the column starts, so it is still
+     * logarithmic (which is what the parallel algorithms need to split
+     * the range).
+     */
+    class ElementIterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T& reference;
+        typedef T* pointer;
+
+        ElementIterator ()
+            : view (0)
+            , col (0)
+            , ndx (0) {
+        }
+
+        ElementIterator (const RunLenView* view, int ndx)
+            : view (view)
+            , col (0)
+            , ndx (ndx) {
+            locate ();
+        }
+
+        /// Index of the column that the current element is in
+        int column () const { return col; }
+
+        /// Index of the current element within its column
+        int row () const { return ndx - view->pos [col]; }
+
+        T& operator * () const { return view->data [ndx]; }
+        T* operator -> () const { return &view->data [ndx]; }
+        T& operator [] (difference_type n) const { return view->data [ndx + n]; }
+
+        ElementIterator& operator ++ () {
+            ++ndx;
+            // skip past any empty columns too
+            while (col < view->num_of_cols && ndx >= view->pos [col + 1]) {
+                ++col;
+            }
+            return *this;
+        }
+        ElementIterator& operator -- () {
+            --ndx;
+            while (col > 0 && ndx < view->pos [col]) {
+                --col;
+            }
+            return *this;
+        }
+        ElementIterator operator ++ (int) { ElementIterator t (*this); ++(*this); return t; }
+        ElementIterator operator -- (int) { ElementIterator t (*this); --(*this); return t; }
+        ElementIterator& operator += (difference_type n) { ndx += static_cast <int> (n); locate (); return *this; }
+        ElementIterator& operator -= (difference_type n) { ndx -= static_cast <int> (n); locate (); return *this; }
+        ElementIterator operator + (difference_type n) const { ElementIterator t (*this); return t += n; }
+        ElementIterator operator - (difference_type n) const { ElementIterator t (*this); return t -= n; }
+        friend ElementIterator operator + (difference_type n, const ElementIterator& it) { return it + n; }
+        difference_type operator - (const ElementIterator& rhs) const { return ndx - rhs.ndx; }
+
+        bool operator == (const ElementIterator& rhs) const { return ndx == rhs.ndx; }
+        bool operator != (const ElementIterator& rhs) const { return ndx != rhs.ndx; }
+        bool operator <  (const ElementIterator& rhs) const { return ndx <  rhs.ndx; }
+        bool operator >  (const ElementIterator& rhs) const { return ndx >  rhs.ndx; }
+        bool operator <= (const ElementIterator& rhs) const { return ndx <= rhs.ndx; }
+        bool operator >= (const ElementIterator& rhs) const { return ndx >= rhs.ndx; }
+
+    private:
+        // find the column that holds the current element; the last column
+        // which starts at or before it (past the end, it is the number of
+        // columns)
+        void locate () {
+            const int* first = view->pos;
+            const int* past = view->pos + view->num_of_cols;
+            col = static_cast <int> (std::upper_bound (first, past, ndx) - first) - 1;
+            if (ndx >= *past) {
+                col = view->num_of_cols;
+            }
+        }
+
+        const RunLenView* view;
+        int col;
+        int ndx;
+    };
+
+    /**
+     * Pair of iterators that can be used in a range-based for loop.
+     */
+    template <typename Iter>
+    struct Range {
+        Range (Iter first, Iter last)
+            : first (first)
+            , past (last) {
+        }
+        Iter begin () const { return first; }
+        Iter end () const { return past; }
+    private:
+        Iter first;
+        Iter past;
+    };
+
+    /**
+     * All the columns in the matrix.
+     *
+     * @example
+     * @code{.cpp}
+     * for (rlw_double::Column c : dz.columns ()) {
+     *     std::accumulate (c.begin (), c.end (), 0.);
+     * }
+     * @endcode
+     */
+    Range <ColumnIterator> columns () const {
+        return Range <ColumnIterator> (ColumnIterator (this, 0),
+                                       ColumnIterator (this, num_of_cols));
+    }
+
+    /**
+     * All the elements in the matrix, in the order they are stored.
+     */
+    Range <ElementIterator> elements () const {
+        return Range <ElementIterator> (ElementIterator (this, pos [0]),
+                                        ElementIterator (this, pos [num_of_cols]));
+    }
 };
 
 /**
@@ -184,6 +403,16 @@ struct RunLenData : public RunLenView <T> {
         // this member is initialized with data allocated in our ctor
         delete [] RunLenView <T>::data;
     }
+
+    /**
+     * Exchange the layout and the data with another matrix. Use this to
+     * reallocate a matrix that is a member of another object.
+     */
+    void swap (RunLenData& rhs) {
+        std::swap (this->num_of_cols, rhs.num_of_cols);
+        std::swap (this->pos, rhs.pos);
+        std::swap (this->data, rhs.data);
+    }
 };
 
 // shorthands for most used types
@@ -0,0 +1,106 @@
+#ifndef OPM_VERTEQ_SCRATCH_HPP_INCLUDED
+#define OPM_VERTEQ_SCRATCH_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <memory> // unique_ptr
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
+
+namespace Opm {
+
+/**
+ * Scratch space for each of the threads that work on behalf of an
+ * object. The space is kept between the calls, so that the buffers are
+ * allocated once for the lifetime of the object, instead of every time
+ * a method is called, by every thread that takes part.
+ *
+ * The space of each thread is an object of type T, which is constructed
+ * from the size given to the arena (usually the length of the largest
+ * column). They are separate allocations, so that threads which write
+ * to their own buffers don't share cache lines.
+ *
+ * Call reserve() before a parallel region is started, and local() from
+ * each of the threads inside it. Outside of a parallel region, local()
+ * returns the space of the first thread. The arena itself is not
+ * thread-safe, so two regions must not use the same arena at once.
+ *
+ * @example
+ * @code{.cpp}
+ * ScratchArena <ColumnScratch> scratch (ts.max_vert_res);
+ * scratch.reserve ();
+ * #pragma omp parallel
+ * {
+ *   ColumnScratch& buf = scratch.local ();
+ *   ...
+ * }
+ * @endcode
+ */
+template <typename T>
+class ScratchArena {
+public:
+	explicit ScratchArena (int size)
+		: size (size) {
+	}
+
+	/**
+	 * Make sure that there is space for every thread in a parallel region
+	 * started after this. Only the first call allocates anything, unless
+	 * the number of threads has been increased since.
+	 */
+	void reserve () {
+		const int num_threads = max_threads ();
+		while (static_cast <int> (slots.size ()) < num_threads) {
+			slots.push_back (std::unique_ptr <T> (new T (size)));
+		}
+	}
+
+	/**
+	 * Space of the calling thread.
+	 */
+	T& local () {
+		return *slots[thread_num ()];
+	}
+
+	/**
+	 * Number of threads that have space reserved.
+	 */
+	int threads () const {
+		return static_cast <int> (slots.size ());
+	}
+
+private:
+	static int max_threads () {
+#ifdef _OPENMP
+		return omp_get_max_threads ();
+#else
+		return 1;
+#endif /* _OPENMP */
+	}
+
+	static int thread_num () {
+#ifdef _OPENMP
+		return omp_get_thread_num ();
+#else
+		return 0;
+#endif /* _OPENMP */
+	}
+
+	// argument to the constructor of each of the objects
+	const int size;
+
+	// object of each thread, indexed by its number in the team
+	std::vector <std::unique_ptr <T> > slots;
+
+	// the slots are owned by the arena
+	ScratchArena (const ScratchArena&);
+	ScratchArena& operator= (const ScratchArena&);
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_SCRATCH_HPP_INCLUDED */
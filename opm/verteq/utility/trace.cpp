@@ -0,0 +1,140 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/utility/trace.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>   // fixed, setprecision
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace Opm;
+using namespace std;
+
+namespace {
+
+// all events are put in the same process in the viewer
+const int TRACE_PID = 1;
+
+/**
+ * State of the trace in progress. Everything but the flag is protected
+ * by the lock, which is held while an event is written.
+ */
+struct Trace {
+	atomic <bool> active;
+	mutex lock;
+	ofstream file;
+	chrono::steady_clock::time_point origin;
+
+	// number of each thread that has written to the trace, in the order
+	// that they appeared, since the native ids are not readable
+	map <thread::id, int> threads;
+
+	// the events are separated by commas, so the first is special
+	bool first;
+
+	// number of times the trace has been started and not yet stopped
+	int users;
+
+	Trace ()
+		: active (false)
+		, first (true)
+		, users (0) {
+	}
+
+	// number of the calling thread, which is announced to the viewer the
+	// first time it is seen; must be called with the lock held
+	int thread_num () {
+		const thread::id id = this_thread::get_id ();
+		map <thread::id, int>::const_iterator it = threads.find (id);
+		if (it != threads.end ()) {
+			return it->second;
+		}
+		const int num = static_cast <int> (threads.size ());
+		threads[id] = num;
+		separate ();
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << TRACE_PID
+		     << ",\"tid\":" << num << ",\"args\":{\"name\":\""
+		     << (num == 0 ? "main" : "worker") << " " << num << "\"}}";
+		return num;
+	}
+
+	// put a comma between the events; must be called with the lock held
+	void separate () {
+		file << (first ? "\n" : ",\n");
+		first = false;
+	}
+};
+
+Trace&
+trace () {
+	static Trace t;
+	return t;
+}
+
+} // anonymous namespace
+
+void
+TraceSink::start (const string& file_name) {
+	Trace& t = trace ();
+	lock_guard <mutex> guard (t.lock);
+
+	// if there is a trace in progress already, the events are added to
+	// that one; the file is closed when the last user has stopped
+	if (t.users > 0) {
+		++t.users;
+		return;
+	}
+	t.file.open (file_name.c_str (), ios::out | ios::trunc);
+	if (!t.file) {
+		throw OPM_EXC ("Unable to open trace file \"%s\"", file_name.c_str ());
+	}
+	t.users = 1;
+	t.file << fixed << setprecision (3) << "[";
+	t.threads.clear ();
+	t.first = true;
+	t.origin = chrono::steady_clock::now ();
+	t.active = true;
+}
+
+void
+TraceSink::stop () {
+	Trace& t = trace ();
+	lock_guard <mutex> guard (t.lock);
+	if (t.users > 0 && --t.users == 0) {
+		t.active = false;
+		t.file << "\n]\n";
+		t.file.close ();
+	}
+}
+
+bool
+TraceSink::enabled () {
+	return trace ().active;
+}
+
+double
+TraceSink::now () {
+	const chrono::duration <double, micro> elapsed =
+		chrono::steady_clock::now () - trace ().origin;
+	return elapsed.count ();
+}
+
+void
+TraceSink::complete (const char* name, double begin) {
+	const double end = now ();
+	Trace& t = trace ();
+	lock_guard <mutex> guard (t.lock);
+
+	// the trace may have been stopped while the event was in progress
+	if (!t.active) {
+		return;
+	}
+	const int tid = t.thread_num ();
+	t.separate ();
+	t.file << "{\"name\":\"" << name << "\",\"cat\":\"verteq\",\"ph\":\"X\""
+	       << ",\"ts\":" << begin << ",\"dur\":" << (end - begin)
+	       << ",\"pid\":" << TRACE_PID << ",\"tid\":" << tid << "}";
+}
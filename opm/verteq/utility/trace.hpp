@@ -0,0 +1,99 @@
+#ifndef OPM_VERTEQ_TRACE_HPP_INCLUDED
+#define OPM_VERTEQ_TRACE_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <string>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+namespace Opm {
+
+/**
+ * Timeline of what the upscaling is doing, written as trace events in
+ * the JSON format that is read by chrome://tracing and Perfetto.
+ *
+ * Each event is a named interval on the thread that recorded it, so
+ * that work done in parallel shows up on separate tracks. The events are
+ * written as they complete, in a JSON array which is closed when the
+ * trace is stopped; the viewers accept the file even if the program was
+ * terminated before that.
+ *
+ * There is one trace for the process, which may be started by several
+ * objects; it is written until all of them have stopped it again. If
+ * it has not been started, an event costs only the test for whether it
+ * is.
+ *
+ * @example
+ * @code{.cpp}
+ * TraceSink::start ("verteq.json");
+ * {
+ *   TraceScope scope ("downscale");
+ *   ...
+ * }
+ * TraceSink::stop ();
+ * @endcode
+ */
+struct OPM_VERTEQ_PUBLIC TraceSink {
+	/**
+	 * Start writing events to a file, replacing its contents. If there
+	 * is a trace in progress already, the events go to that one instead,
+	 * and the file name is not used. Each call must be matched by one to
+	 * stop().
+	 */
+	static void start (const std::string& file_name);
+
+	/**
+	 * Complete the file, if this matches the first call to start();
+	 * events after this are ignored. Otherwise the trace goes on for the
+	 * ones that have not stopped yet.
+	 */
+	static void stop ();
+
+	/**
+	 * Is there a trace in progress?
+	 */
+	static bool enabled ();
+
+	/**
+	 * Current time, in microseconds since the trace was started.
+	 */
+	static double now ();
+
+	/**
+	 * Record an interval on the calling thread.
+	 *
+	 * @param name Label of the event; this must be a literal, or
+	 *             otherwise not need any escaping in JSON.
+	 * @param begin Time at which the interval started, from now().
+	 */
+	static void complete (const char* name, double begin);
+};
+
+/**
+ * Record an event for the duration of the enclosing scope.
+ */
+class OPM_VERTEQ_PUBLIC TraceScope {
+public:
+	TraceScope (const char* name)
+		: name (name)
+		, begin (TraceSink::enabled () ? TraceSink::now () : 0.) {
+	}
+
+	~TraceScope () {
+		if (TraceSink::enabled ()) {
+			TraceSink::complete (name, begin);
+		}
+	}
+
+private:
+	const char* const name;
+	const double begin;
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_TRACE_HPP_INCLUDED */
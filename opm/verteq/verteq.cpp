@@ -1,11 +1,16 @@
 // Copyright (C) 2013 Uni Research AS
 // This file is licensed under the GNU General Public License v3.0
 #include <opm/verteq/nav.hpp>
+#include <opm/verteq/partition.hpp>
+#include <opm/verteq/plume.hpp>
 #include <opm/verteq/props.hpp>
 #include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/trans.hpp>
 #include <opm/verteq/upscale.hpp>
 #include <opm/verteq/verteq.hpp>
 #include <opm/verteq/utility/exc.hpp>
+#include <opm/verteq/utility/instrument.hpp>
+#include <opm/verteq/utility/trace.hpp>
 #include <opm/core/pressure/flow_bc.h>
 #ifdef __clang__
 #pragma clang diagnostic push
@@ -16,10 +21,18 @@
 #pragma clang diagnostic pop
 #endif /* __clang__ */
 #include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/simulator/WellState.hpp>
 #include <opm/core/utility/parameters/ParameterGroup.hpp>
 #include <opm/core/grid/GridHelpers.hpp>
 #include <opm/core/wells.h>
-#include <memory>           // unique_ptr
+#include <algorithm>        // fill, set_intersection
+#include <cstdint>          // uint32_t, uint64_t
+#include <cmath>            // sqrt
+#include <cstring>          // memcmp
+#include <istream>
+#include <iterator>         // back_inserter
+#include <memory>           // unique_ptr, shared_ptr
+#include <ostream>
 
 using namespace Opm;
 using namespace Opm::parameter;
@@ -42,41 +55,94 @@ struct VertEqImpl : public VertEq {
 		}
 	}
 	void init (const UnstructuredGrid& fullGrid,
+	           shared_ptr <const TopSurf> topSurf,
 	           const IncompPropertiesInterface& fullProps,
+	           VertEqProps* coarseProps,
+	           int plumeHalo,
 	           const Wells* wells,
 	           const vector<double>& fullSrc,
 	           const FlowBoundaryConditions* fullBcs,
 	           const double* fullGravity);
 	// public methods defined in the interface
 	virtual const UnstructuredGrid& grid();
+	virtual const TopSurf& top_surf ();
+	virtual const TopSurfTrans& trans ();
+	virtual const PlumeSet& plume ();
 	virtual const Wells* wells();
 	virtual const IncompPropertiesInterface& props();
 	virtual void upscale (const TwophaseState& fineScale,
 	                      TwophaseState& coarseScale);
 	virtual void downscale (const TwophaseState &coarseScale,
 	                        TwophaseState &fineScale);
+	virtual void downscale (int col,
+	                        const TwophaseState& coarseScale,
+	                        const int* rows,
+	                        double* fineSaturation,
+	                        double* finePressure);
+	virtual void update_props (const vector <int>& cells);
+	virtual void checkpoint (const TwophaseState& coarseScale,
+	                         ostream& os);
+	virtual void restore (istream& is,
+	                      TwophaseState& coarseScale);
 	virtual void notify (const TwophaseState& coarseScale);
+	virtual void upscale_wells (const WellState& fineWells,
+	                            WellState& coarseWells);
+	virtual void downscale_wells (const WellState& coarseWells,
+	                              WellState& fineWells);
+	virtual const PerfStats& perf_stats ();
+
+	// size of the arrays in the fine and the coarse state together
+	unsigned long state_bytes () const;
 
-	unique_ptr <TopSurf> ts;
+	// the top surface may be shared with other models for the same grid
+	shared_ptr <const TopSurf> ts;
 	unique_ptr <VertEqProps> pr;
+
+	// transmissibilities are integrated from the fine grid, so keep the
+	// original objects around in case the properties are updated
+	const UnstructuredGrid* fine_grid;
+	const IncompPropertiesInterface* fine_props;
+	unique_ptr <TopSurfTrans> tr;
+
+	// columns that this model is responsible for, if the top surface is
+	// partitioned; both lists are empty if the model covers all of it
+	vector <int> owned;
+	vector <int> local; // owned columns and the halo around them
+
+	// columns where the saturation may change; everything else is brine
+	unique_ptr <PlumeSet> pl;
+	void seed_plume ();
+
 	/**
 	 * Translate all the indices in the well list from a full, three-
-	 * dimensional grid into the upscaled top surface.
+	 * dimensional grid into the upscaled top surface. The perforations
+	 * of a well that end up in the same column are merged.
 	 */
 	void translate_wells ();
 
+	// connection of the upscaled wells that each perforation of the
+	// original wells is merged into, and its part of the well index
+	vector <int> perf_conn;
+	vector <double> perf_share;
+
 	// source terms in the upscaled grid
 	vector<double> coarseSrc;
 	void sum_sources (const vector<double>& fullSrc);
 	virtual const vector<double>& src ();
 
 	// boundary conditions
-	void assert_noflow (const FlowBoundaryConditions* bcs);
+	void upscale_bcs (const UnstructuredGrid& fullGrid,
+	                  const IncompPropertiesInterface& fullProps,
+	                  const FlowBoundaryConditions* fullBcs);
 	virtual const FlowBoundaryConditions* bcs ();
 
 	// gravity
 	const double* grav_vec;
+	double coarse_grav[3];
+	vector <double> grav_pot;
+	void caprock_gravity ();
 	virtual const double* gravity ();
+	virtual const vector<double>& gravity_potential ();
 };
 
 VertEq*
@@ -88,19 +154,116 @@ VertEq::create (const string& title,
                 const vector<double>& fullSrc,
                 const FlowBoundaryConditions* fullBcs,
                 const double* fullGravity) {
+	// generate a two-dimensional upscaling as soon as we get the grid;
+	// this model is the only one using it
+	shared_ptr <const TopSurf> ts (TopSurf::create (fullGrid));
+	return VertEq::create (title, args, fullGrid, ts, fullProps,
+	                       wells, fullSrc, fullBcs, fullGravity);
+}
+
+VertEq*
+VertEq::create (const string& title,
+                const ParameterGroup& args,
+                const UnstructuredGrid& fullGrid,
+                shared_ptr <const TopSurf> topSurf,
+                const IncompPropertiesInterface& fullProps,
+                const Wells* wells,
+                const vector<double>& fullSrc,
+                const FlowBoundaryConditions* fullBcs,
+                const double* fullGravity) {
 	// this is just to avoid warnings about unused variables
 	static_cast <void> (title);
-	static_cast <void> (args);
 
-	// we don't provide any parameters to do tuning yet
+	// width of the band around the plume that is tracked, in columns
+	const int halo = args.getDefault ("verteq_plume_halo", 1);
+
 	unique_ptr <VertEqImpl> impl (new VertEqImpl ());
-	impl->init (fullGrid, fullProps, wells, fullSrc, fullBcs, fullGravity);
+	impl->init (fullGrid, topSurf, fullProps,
+	            VertEqProps::create (fullProps, *topSurf, fullGravity),
+	            halo, wells, fullSrc, fullBcs, fullGravity);
+	if (args.getDefault ("verteq_compress_layers", false)) {
+		impl->pr->compress_layers ();
+	}
 	return impl.release();
 }
 
+VertEq*
+VertEq::create (const string& title,
+                const ParameterGroup& args,
+                const UnstructuredGrid& fullGrid,
+                shared_ptr <const TopSurf> topSurf,
+                const IncompPropertiesInterface& fullProps,
+                const ColumnPartition& part,
+                int rank,
+                const Wells* wells,
+                const vector<double>& fullSrc,
+                const FlowBoundaryConditions* fullBcs,
+                const double* fullGravity) {
+	static_cast <void> (title);
+	const int halo = args.getDefault ("verteq_plume_halo", 1);
+
+	// the lists must be in place before the model is initialized, since
+	// the transmissibilities are only computed for the local columns
+	unique_ptr <VertEqImpl> impl (new VertEqImpl ());
+	impl->owned = part.owned (rank);
+	impl->local = part.local (rank);
+	const int num_local = static_cast <int> (impl->local.size ());
+	impl->init (fullGrid, topSurf, fullProps,
+	            VertEqProps::create (fullProps, *topSurf, fullGravity,
+	                                 num_local, &impl->local[0]),
+	            halo, wells, fullSrc, fullBcs, fullGravity);
+	if (args.getDefault ("verteq_compress_layers", false)) {
+		impl->pr->compress_layers ();
+	}
+	return impl.release();
+}
+
+vector <VertEq*>
+VertEq::create (const string& title,
+                const ParameterGroup& args,
+                const UnstructuredGrid& fullGrid,
+                shared_ptr <const TopSurf> topSurf,
+                const vector <const IncompPropertiesInterface*>& fullProps,
+                const Wells* wells,
+                const vector<double>& fullSrc,
+                const FlowBoundaryConditions* fullBcs,
+                const double* fullGravity) {
+	static_cast <void> (title);
+	const int halo = args.getDefault ("verteq_plume_halo", 1);
+
+	// upscale the properties of all realizations in one pass; hold on
+	// to them until they are adopted by the models below
+	const vector <VertEqProps*> props = VertEqProps::create (fullProps,
+	                                                         *topSurf,
+	                                                         fullGravity);
+	vector <unique_ptr <VertEqProps> > owned (props.begin (), props.end ());
+
+	// create a model for each realization, all sharing the top surface
+	vector <unique_ptr <VertEqImpl> > models;
+	for (size_t i = 0; i < owned.size (); ++i) {
+		unique_ptr <VertEqImpl> impl (new VertEqImpl ());
+		impl->init (fullGrid, topSurf, *fullProps[i], owned[i].release (),
+		            halo, wells, fullSrc, fullBcs, fullGravity);
+		if (args.getDefault ("verteq_compress_layers", false)) {
+			impl->pr->compress_layers ();
+		}
+		models.push_back (move (impl));
+	}
+
+	// client owns the models from this point
+	vector <VertEq*> result (models.size ());
+	for (size_t i = 0; i < models.size (); ++i) {
+		result[i] = models[i].release ();
+	}
+	return result;
+}
+
 void
 VertEqImpl::init(const UnstructuredGrid& fullGrid,
+                 shared_ptr <const TopSurf> topSurf,
                  const IncompPropertiesInterface& fullProps,
+                 VertEqProps* coarseProps,
+                 int plumeHalo,
                  const Wells* wells,
                  const vector<double>& fullSrc,
                  const FlowBoundaryConditions* fullBcs,
@@ -108,33 +271,140 @@ VertEqImpl::init(const UnstructuredGrid& fullGrid,
 	// store a pointer to the original gravity vector passed to us
 	grav_vec = fullGravity;
 
-	// generate a two-dimensional upscaling as soon as we get the grid
-	ts = unique_ptr <TopSurf> (TopSurf::create (fullGrid));
-	pr = unique_ptr <VertEqProps> (VertEqProps::create (fullProps, *ts, grav_vec));
+	// adopt the upscaled grid and properties
+	ts = topSurf;
+	pr = unique_ptr <VertEqProps> (coarseProps);
+	// the slope of the caprock is what drives the plume laterally
+	caprock_gravity ();
+	// integrate the transmissibilities of the lateral faces in the fine
+	// grid, instead of leaving it to the simulator to compute them from
+	// the averaged permeability
+	fine_grid = &fullGrid;
+	fine_props = &fullProps;
+	if (local.empty ()) {
+		tr = unique_ptr <TopSurfTrans> (new TopSurfTrans (
+			fullGrid, *ts, fullProps.permeability ()));
+	}
+	else {
+		tr = unique_ptr <TopSurfTrans> (new TopSurfTrans (
+			fullGrid, *ts, fullProps.permeability (),
+			static_cast <int> (local.size ()), &local[0]));
+	}
 	// create a separate, but identical, list of wells we can work on
 	w = clone_wells(wells);
 	translate_wells ();
 	// sum the volumetric sources in each column
 	sum_sources (fullSrc);
-	// verify that we haven't specified anything than no-flow boundary
-	// conditions (these are the only we support currently)
-	// TODO: This should be replaced with code that reads through the
-	//       grid and map to proper 2D boundary conditions
-	assert_noflow (fullBcs);
-	// rely on the fact that no boundary conditions means no-flow
-	bnd_cond = flow_conditions_construct (0);
+	// start tracking the plume where CO2 may enter the domain
+	pl = unique_ptr <PlumeSet> (new PlumeSet (*ts, plumeHalo));
+	seed_plume ();
+	// map the conditions on the sides of the columns to the faces of
+	// the top surface; this needs the gravity
+	upscale_bcs (fullGrid, fullProps, fullBcs);
+}
+
+void
+VertEqImpl::caprock_gravity () {
+	const int nc = ts->number_of_cells;
+	const double* cc = ts->cell_centroids;
+	const double* area = ts->cell_volumes;
+	const double gz = grav_vec[2];
+
+	// fit a plane z = z_avg + b (x - x_avg) + c (y - y_avg) to the depth
+	// of the top surface, weighting each column with its area. start by
+	// finding the center of the surface
+	double tot = 0., x_avg = 0., y_avg = 0., z_avg = 0.;
+	for (int col = 0; col < nc; ++col) {
+		tot += area[col];
+		x_avg += area[col] * cc[2 * col + 0];
+		y_avg += area[col] * cc[2 * col + 1];
+		z_avg += area[col] * ts->z0[col];
+	}
+	x_avg /= tot;
+	y_avg /= tot;
+	z_avg /= tot;
+
+	// normal equations for the slopes
+	double sxx = 0., sxy = 0., syy = 0., sxz = 0., syz = 0.;
+	for (int col = 0; col < nc; ++col) {
+		const double dx = cc[2 * col + 0] - x_avg;
+		const double dy = cc[2 * col + 1] - y_avg;
+		const double dz = ts->z0[col] - z_avg;
+		sxx += area[col] * dx * dx;
+		sxy += area[col] * dx * dy;
+		syy += area[col] * dy * dy;
+		sxz += area[col] * dx * dz;
+		syz += area[col] * dy * dz;
+	}
+
+	// if the columns are on a line (or there is only one), then there
+	// is no slope across it
+	const double det = sxx * syy - sxy * sxy;
+	double b = 0., c = 0.;
+	if (det > 1e-12 * (sxx * syy)) {
+		b = (sxz * syy - syz * sxy) / det;
+		c = (syz * sxx - sxz * sxy) / det;
+	}
+	else if (sxx > 0.) {
+		b = sxz / sxx;
+	}
+	else if (syy > 0.) {
+		c = syz / syy;
+	}
+
+	// the simulator only knows of the first two dimensions, so tilt the
+	// gravity into the plane of the surface. this captures migration
+	// along a caprock that has a constant dip
+	coarse_grav[0] = grav_vec[0] + gz * b;
+	coarse_grav[1] = grav_vec[1] + gz * c;
+	coarse_grav[2] = gz;
+
+	// local variations of the slope can only be described face by face;
+	// the depth at each face is interpolated between the two columns, or
+	// extrapolated with the average slope on the boundary
+	grav_pot.resize (ts->cell_facepos[nc]);
+	for (int col = 0; col < nc; ++col) {
+		for (int pos = ts->cell_facepos[col]; pos != ts->cell_facepos[col + 1]; ++pos) {
+			const int face = ts->cell_faces[pos];
+			const int other = ts->face_cells[2 * face + 0] == col
+			                ? ts->face_cells[2 * face + 1]
+			                : ts->face_cells[2 * face + 0];
+			const double* fc = &ts->face_centroids[2 * face];
+			const double dx = fc[0] - cc[2 * col + 0];
+			const double dy = fc[1] - cc[2 * col + 1];
+			double z_face;
+			if (other >= 0) {
+				const double d_this = sqrt (dx * dx + dy * dy);
+				const double d_other = sqrt (
+					(fc[0] - cc[2 * other + 0]) * (fc[0] - cc[2 * other + 0]) +
+					(fc[1] - cc[2 * other + 1]) * (fc[1] - cc[2 * other + 1]));
+				z_face = ts->z0[col] + (ts->z0[other] - ts->z0[col])
+				       * d_this / (d_this + d_other);
+			}
+			else {
+				z_face = ts->z0[col] + b * dx + c * dy;
+			}
+			grav_pot[pos] = grav_vec[0] * dx + grav_vec[1] * dy
+			              + gz * (z_face - ts->z0[col]);
+		}
+	}
 }
 
 const double*
 VertEqImpl::gravity () {
-	// simply return the original two first items; the underlaying simulator
-	// cannot "see" the last dimension, because it only know of two elements.
-	return grav_vec;
+	// lateral gravity along the average slope of the caprock, and the
+	// original vertical component for those who need it
+	return coarse_grav;
+}
+
+const vector<double>&
+VertEqImpl::gravity_potential () {
+	return grav_pot;
 }
 
 const FlowBoundaryConditions*
 VertEqImpl::bcs () {
-	// return a set of predefined no-flow conditions
+	// return the conditions that were upscaled at initialization
 	return bnd_cond;
 }
 
@@ -144,16 +414,172 @@ static const char* bc_names[] = {
   "flux"
 };
 
+namespace {
+
+// number of sides of each column; the lateral faces of the blocks in
+// the fine grid have the same tags as the sides of the columns
+const int QUAD_SIDES = 4;
+
+/**
+ * Face of the top surface that a face of a block in the fine grid is a
+ * part of.
+ *
+ * @param col Receives the column of the block that has the face.
+ * @return Index of the face in the top surface, or NO_ELEM if the face
+ *         is on the top or the bottom of the column.
+ */
+int
+top_surf_face (const UnstructuredGrid& fine,
+               const TopSurf& ts,
+               int fine_face,
+               int& col) {
+	// a face on the boundary has only one block
+	const int cell = fine.face_cells[2 * fine_face + 0] >= 0
+	               ? fine.face_cells[2 * fine_face + 0]
+	               : fine.face_cells[2 * fine_face + 1];
+	col = ts.fine_col[cell];
+
+	// the faces of each column are stored in the order of their tags
+	for (int pos = fine.cell_facepos[cell];
+	     pos != fine.cell_facepos[cell + 1]; ++pos) {
+		if (fine.cell_faces[pos] == fine_face) {
+			const int tag = fine.cell_facetag[pos];
+			return tag < QUAD_SIDES
+			     ? ts.cell_faces[ts.cell_facepos[col] + tag]
+			     : Cart2D::NO_ELEM;
+		}
+	}
+	return Cart2D::NO_ELEM;
+}
+
+} // anonymous namespace
+
 void
-VertEqImpl::assert_noflow (const FlowBoundaryConditions* bcs) {
-	// loop through the number of boundary conditions specified,
-	// checking each individually
-	for (size_t i = 0; i < bcs->nbc; ++i) {
-		if (bcs->type[i] != BC_NOFLOW) {
-			// there is no (portable) format for size_t
-			const unsigned long ndx = static_cast <unsigned long> (i);
-			throw OPM_EXC ("Boundary condition %lu is %s, only no-flow supported",
-			               ndx, bc_names[bcs->type[i]]);
+VertEqImpl::upscale_bcs (const UnstructuredGrid& fullGrid,
+                         const IncompPropertiesInterface& fullProps,
+                         const FlowBoundaryConditions* fullBcs) {
+	// no conditions at all means no-flow everywhere, both in the fine
+	// grid and in the top surface
+	bnd_cond = flow_conditions_construct (0);
+	if (!fullBcs) {
+		return;
+	}
+
+	// the pressure at the boundary is referred to the top of the column
+	// assuming that the column is filled with brine there (the heavier
+	// phase); unlike upscale_pressure, the CO2 is not accounted for
+	const double gravity = grav_vec[2];
+	const double brine_dens = max (fullProps.density ()[0],
+	                               fullProps.density ()[1]);
+	const int dim = fullGrid.dimensions;
+
+	// kind of condition on each face of the top surface, which is no-flow
+	// unless there is another kind on any of the faces on that side of the
+	// column. the flux through the side is the sum of the flux through
+	// those faces, and the pressure is the average of them, by area
+	const int num_faces = ts->number_of_faces;
+	vector <int> kind (num_faces, BC_NOFLOW);
+	vector <double> flux (num_faces, 0.);
+	vector <double> pres (num_faces, 0.);
+	vector <double> area (num_faces, 0.);
+
+	// fine faces that have a pressure condition, and the column that
+	// each side of the top surface belongs to, for the message
+	vector <char> has_pres (fullGrid.number_of_faces, 0);
+	vector <int> side_col (num_faces, Cart2D::NO_ELEM);
+
+	for (size_t i = 0; i < fullBcs->nbc; ++i) {
+		// there is no (portable) format for size_t
+		const unsigned long ndx = static_cast <unsigned long> (i);
+		const FlowBCType type = fullBcs->type[i];
+		if (type == BC_NOFLOW) {
+			continue;
+		}
+
+		// the flux is given for all the faces of the condition together;
+		// each face gets a part of it by its area
+		const size_t first = fullBcs->cond_pos[i];
+		const size_t last = fullBcs->cond_pos[i + 1];
+		double cond_area = 0.;
+		for (size_t j = first; j < last; ++j) {
+			cond_area += fullGrid.face_areas[fullBcs->face[j]];
+		}
+
+		for (size_t j = first; j < last; ++j) {
+			// side of the column that the face is on; the top surface can
+			// only have conditions on its own boundary
+			const int fine_face = fullBcs->face[j];
+			int col;
+			const int face = top_surf_face (fullGrid, *ts, fine_face, col);
+			if (face == Cart2D::NO_ELEM ||
+			    (ts->face_cells[2 * face + 0] >= 0 &&
+			     ts->face_cells[2 * face + 1] >= 0)) {
+				throw OPM_EXC ("Boundary condition %lu is %s on face %d, which is "
+				               "not on the lateral boundary of the top surface",
+				               ndx, bc_names[type], fine_face);
+			}
+			if (kind[face] != BC_NOFLOW && kind[face] != type) {
+				throw OPM_EXC ("Boundary condition %lu is %s on face %d, but the "
+				               "same side of column %d is %s",
+				               ndx, bc_names[type], fine_face, col,
+				               bc_names[kind[face]]);
+			}
+			kind[face] = type;
+
+			const double fine_area = fullGrid.face_areas[fine_face];
+			if (type == BC_FLUX_TOTVOL) {
+				flux[face] += fullBcs->value[i] * fine_area / cond_area;
+			}
+			else {
+				// hydrostatic pressure at the top of the column
+				const double depth =
+					fullGrid.face_centroids[fine_face * dim + dim - 1] - ts->z0[col];
+				const double ref_pres = fullBcs->value[i] - gravity * depth * brine_dens;
+				pres[face] += fine_area * ref_pres;
+				area[face] += fine_area;
+				has_pres[fine_face] = 1;
+				side_col[face] = col;
+			}
+		}
+	}
+
+	// the flux through the faces that are left out of a condition is
+	// zero, so the sum is still right, but there is no pressure for the
+	// rest of a side, and we cannot pretend that the whole side has it
+	vector <int> num_fine (num_faces, 0);
+	vector <int> num_pres (num_faces, 0);
+	for (int fine_face = 0; fine_face < fullGrid.number_of_faces; ++fine_face) {
+		if (fullGrid.face_cells[2 * fine_face + 0] < 0 ||
+		    fullGrid.face_cells[2 * fine_face + 1] < 0) {
+			int col;
+			const int face = top_surf_face (fullGrid, *ts, fine_face, col);
+			if (face != Cart2D::NO_ELEM) {
+				++num_fine[face];
+				num_pres[face] += has_pres[fine_face];
+			}
+		}
+	}
+	for (int face = 0; face < num_faces; ++face) {
+		if (kind[face] == BC_PRESSURE && num_pres[face] != num_fine[face]) {
+			throw OPM_EXC ("Pressure condition is on %d of the %d faces on the "
+			               "side of column %d; it must cover the whole side",
+			               num_pres[face], num_fine[face], side_col[face]);
+		}
+	}
+
+	// add a condition for each face of the top surface that is open
+	for (int face = 0; face < num_faces; ++face) {
+		int ok = 1;
+		if (kind[face] == BC_PRESSURE) {
+			ok = flow_conditions_append (BC_PRESSURE, face,
+			                             pres[face] / area[face], bnd_cond);
+		}
+		else if (kind[face] == BC_FLUX_TOTVOL) {
+			ok = flow_conditions_append (BC_FLUX_TOTVOL, face,
+			                             flux[face], bnd_cond);
+		}
+		if (!ok) {
+			throw OPM_EXC ("Unable to add boundary condition on face %d", face);
 		}
 	}
 }
@@ -176,6 +602,21 @@ VertEqImpl::sum_sources (const vector<double>& fineSrc) {
 	}
 }
 
+void
+VertEqImpl::seed_plume () {
+	// we don't know the composition of what is injected, so assume that
+	// every well and every positive source may put CO2 in its column
+	const int num_perfs = w->well_connpos[w->number_of_wells];
+	for (int i = 0; i < num_perfs; ++i) {
+		pl->insert (w->well_cells[i]);
+	}
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		if (coarseSrc[col] > 0.) {
+			pl->insert (col);
+		}
+	}
+}
+
 const vector<double>&
 VertEqImpl::src () {
 	return this->coarseSrc;
@@ -183,37 +624,53 @@ VertEqImpl::src () {
 
 void
 VertEqImpl::translate_wells () {
-	// number of perforations; we assume that each well is specified with
-	// only one perforation, so that there is no column which will end up
-	// with more than one well.
+	// number of perforations in the original wells; since they are only
+	// merged, the upscaled wells never have more connections than this,
+	// and the arrays of the clone can be compacted in place
 	const int num_perfs = w->well_connpos[w->number_of_wells];
+	perf_conn.assign (num_perfs, Cart2D::NO_ELEM);
+	perf_share.assign (num_perfs, 0.);
+	const vector <double> fine_wi (w->WI, w->WI + num_perfs);
 
-	// these flags are used to see if we already have a well in each column
-	// a more advanced implementation could perhaps join wells if appropriate.
-	vector <int> perforated (ts->number_of_cells, Cart2D::NO_ELEM);
+	// connection of the current well in each column, if there is any.
+	// several wells may go through the same column; each of them gets
+	// a connection of its own there
+	vector <int> conn_in_col (ts->number_of_cells, Cart2D::NO_ELEM);
 
-	// translate the index of each well
-	for (int i = 0; i < num_perfs; ++i) {
-		// three-dimensional placement of the well
-		const int fine_id = w->well_cells[i];
-
-		// corresponding position in the two-dimensional grid
-		const int coarse_id = ts->fine_col[fine_id];
-
-		// sanity check: do we already have a well here? otherwise mark the
-		// spot as taken.
-		if (perforated[coarse_id] != Cart2D::NO_ELEM) {
-			throw OPM_EXC ("Error translating well %d; column %d is already "
-			               "perforated with well in fine cell with id %d",
-			               i, coarse_id, fine_id);
-		}
-		else {
-			perforated[coarse_id] = fine_id;
+	int num_conns = 0;
+	for (int well = 0; well < w->number_of_wells; ++well) {
+		// the start of the next well is read before it is overwritten
+		const int first = w->well_connpos[well];
+		const int last = w->well_connpos[well + 1];
+		w->well_connpos[well] = num_conns;
+
+		for (int i = first; i < last; ++i) {
+			// three-dimensional placement of the perforation, and the
+			// corresponding position in the two-dimensional grid
+			const int fine_id = w->well_cells[i];
+			const int coarse_id = ts->fine_col[fine_id];
+
+			// the first perforation of the well in a column adds a
+			// connection; it is never placed after the perforation that
+			// is read, so the list is gradually turned into an upscaled
+			// version of itself
+			int& conn = conn_in_col[coarse_id];
+			if (conn == Cart2D::NO_ELEM) {
+				conn = num_conns++;
+				w->well_cells[conn] = coarse_id;
+				w->WI[conn] = 0.;
+			}
+
+			// the perforations are in parallel; the flow into the column
+			// is the sum of the flow through each of them
+			w->WI[conn] += fine_wi[i];
+			perf_conn[i] = conn;
 		}
 
-		// overwrite (!) the cell identifier with the 2D one; the list
-		// is gradually turned into an upscaled version
-		w->well_cells[i] = coarse_id;
+		// forget the columns of this well before the next one
+		for (int conn = w->well_connpos[well]; conn < num_conns; ++conn) {
+			conn_in_col[w->well_cells[conn]] = Cart2D::NO_ELEM;
+		}
 
 		// TODO: Well productivity index is dependent on the drawdown, and
 		// the drawdown is dependent on the surrounding reservoir pressure
@@ -221,6 +678,67 @@ VertEqImpl::translate_wells () {
 		// now at the bottom and not in the height of the well). should the
 		// well productivity index be adjusted?
 	}
+	w->well_connpos[w->number_of_wells] = num_conns;
+
+	// part of the flow through the connection that goes through each of
+	// the perforations; if none of them have an index, split it evenly
+	vector <int> num_merged (num_conns, 0);
+	for (int i = 0; i < num_perfs; ++i) {
+		++num_merged[perf_conn[i]];
+	}
+	for (int i = 0; i < num_perfs; ++i) {
+		const int conn = perf_conn[i];
+		perf_share[i] = w->WI[conn] > 0.
+		              ? fine_wi[i] / w->WI[conn]
+		              : 1. / num_merged[conn];
+	}
+}
+
+void
+VertEqImpl::upscale_wells (const WellState& fineWells,
+                           WellState& coarseWells) {
+	const int num_perfs = static_cast <int> (perf_conn.size ());
+	if (static_cast <int> (fineWells.perfRates ().size ()) != num_perfs) {
+		throw OPM_EXC ("Well state has %d perforations, but the wells have %d",
+		               static_cast <int> (fineWells.perfRates ().size ()),
+		               num_perfs);
+	}
+
+	// the wells themselves are the same, at the same indices
+	coarseWells.bhp () = fineWells.bhp ();
+
+	// rates are summed, and the pressure is averaged with the same weights
+	// as the flow is split when downscaling
+	vector <double>& rates = coarseWells.perfRates ();
+	vector <double>& press = coarseWells.perfPress ();
+	fill (rates.begin (), rates.end (), 0.);
+	fill (press.begin (), press.end (), 0.);
+	for (int i = 0; i < num_perfs; ++i) {
+		const int conn = perf_conn[i];
+		rates[conn] += fineWells.perfRates ()[i];
+		press[conn] += perf_share[i] * fineWells.perfPress ()[i];
+	}
+}
+
+void
+VertEqImpl::downscale_wells (const WellState& coarseWells,
+                             WellState& fineWells) {
+	const int num_perfs = static_cast <int> (perf_conn.size ());
+	if (static_cast <int> (fineWells.perfRates ().size ()) != num_perfs) {
+		throw OPM_EXC ("Well state has %d perforations, but the wells have %d",
+		               static_cast <int> (fineWells.perfRates ().size ()),
+		               num_perfs);
+	}
+	fineWells.bhp () = coarseWells.bhp ();
+
+	// each perforation gets its part of the flow of the connection; all
+	// of them are at the pressure of the connection, which is the same
+	// as if the column was a single block
+	for (int i = 0; i < num_perfs; ++i) {
+		const int conn = perf_conn[i];
+		fineWells.perfRates ()[i] = perf_share[i] * coarseWells.perfRates ()[conn];
+		fineWells.perfPress ()[i] = coarseWells.perfPress ()[conn];
+	}
 }
 
 const UnstructuredGrid&
@@ -229,6 +747,21 @@ VertEqImpl::grid () {
 	return *(ts.get ());
 }
 
+const TopSurf&
+VertEqImpl::top_surf () {
+	return *ts;
+}
+
+const TopSurfTrans&
+VertEqImpl::trans () {
+	return *tr;
+}
+
+const PlumeSet&
+VertEqImpl::plume () {
+	return *pl;
+}
+
 const Wells*
 VertEqImpl::wells () {
 	// simply return our own list of wells we have translated
@@ -244,6 +777,10 @@ VertEqImpl::props () {
 void
 VertEqImpl::upscale (const TwophaseState& fineScale,
                      TwophaseState& coarseScale) {
+	OPM_VERTEQ_TIMED (UPSCALE);
+	TraceScope scope ("upscale");
+	OPM_VERTEQ_COUNT (bytes, state_bytes ());
+
 	// dimension state object to the top grid
 	coarseScale.init (*ts, pr->numPhases ());
 
@@ -252,12 +789,29 @@ VertEqImpl::upscale (const TwophaseState& fineScale,
 	// and saturation, the flux is an output field. these methods
 	// are handled by the props class, since it already has access to
 	// the densities and weights.
-	pr->upscale_saturation (&fineScale.saturation ()[0],
-	                        &coarseScale.saturation ()[0]);
-	pr->upd_res_sat (&coarseScale.saturation ()[0]);
-	pr->upscale_pressure (&coarseScale.saturation ()[0],
-	                      &fineScale.pressure ()[0],
-	                      &coarseScale.pressure ()[0]);
+	if (local.empty ()) {
+		pr->upscale_saturation (&fineScale.saturation ()[0],
+		                        &coarseScale.saturation ()[0]);
+		pr->upd_res_sat (&coarseScale.saturation ()[0]);
+		pl->reset (pr->max_sat ());
+		pr->upscale_pressure (&coarseScale.saturation ()[0],
+		                      &fineScale.pressure ()[0],
+		                      &coarseScale.pressure ()[0]);
+	}
+	else {
+		// the fine state is only known below the local columns; the
+		// rest of the coarse state is left at zero, i.e. pure brine
+		const int num_local = static_cast <int> (local.size ());
+		pr->upscale_saturation (&fineScale.saturation ()[0],
+		                        &coarseScale.saturation ()[0],
+		                        num_local, &local[0]);
+		pr->upd_res_sat (&coarseScale.saturation ()[0], num_local, &local[0]);
+		pl->reset (pr->max_sat ());
+		pr->upscale_pressure (&coarseScale.saturation ()[0],
+		                      &fineScale.pressure ()[0],
+		                      &coarseScale.pressure ()[0],
+		                      num_local, &local[0]);
+	}
 
 	// use the regular helper method to initialize the face pressure
 	// since it is implemented in the header, we have access to it
@@ -281,6 +835,10 @@ VertEqImpl::upscale (const TwophaseState& fineScale,
 void
 VertEqImpl::downscale (const TwophaseState &coarseScale,
                        TwophaseState &fineScale) {
+	OPM_VERTEQ_TIMED (DOWNSCALE);
+	TraceScope scope ("downscale");
+	OPM_VERTEQ_COUNT (bytes, state_bytes ());
+
 	// assume that the fineScale storage is already initialized
 	if (!fineScale.pressure().size() == ts->number_of_cells) {
 		throw OPM_EXC ("Fine scale state is not dimensioned correctly");
@@ -290,16 +848,215 @@ VertEqImpl::downscale (const TwophaseState &coarseScale,
 	// already has the information about the interface.
 	// update the coarse saturation *before* we downscale to 3D,
 	// since we need the residual interface for that.
-	pr->upd_res_sat (&coarseScale.saturation ()[0]);
-	pr->downscale_saturation (&coarseScale.saturation ()[0],
-	                          &fineScale.saturation ()[0]);
-	pr->downscale_pressure (&coarseScale.saturation ()[0],
-	                        &coarseScale.pressure ()[0],
-	                        &fineScale.pressure ()[0]);
+	notify (coarseScale);
+	if (owned.empty ()) {
+		pr->downscale_saturation (&coarseScale.saturation ()[0],
+		                          &fineScale.saturation ()[0]);
+		pr->downscale_pressure (&coarseScale.saturation ()[0],
+		                        &coarseScale.pressure ()[0],
+		                        &fineScale.pressure ()[0]);
+	}
+	else {
+		// only write the blocks that this process is responsible for;
+		// the other blocks in the fine state are left untouched
+		for (size_t i = 0; i < owned.size (); ++i) {
+			const int col = owned[i];
+			pr->downscale_column (col,
+			                      &coarseScale.saturation ()[0],
+			                      &coarseScale.pressure ()[0],
+			                      &ts->col_cells[ts->col_cellpos[col]],
+			                      &fineScale.saturation ()[0],
+			                      &fineScale.pressure ()[0]);
+		}
+	}
+}
+
+void
+VertEqImpl::downscale (int col,
+                       const TwophaseState& coarseScale,
+                       const int* rows,
+                       double* fineSaturation,
+                       double* finePressure) {
+	// the interface is assumed to be up-to-date, since the properties
+	// have been notified at the end of the last timestep; we don't
+	// want to update the residual saturation for every column
+	pr->downscale_column (col,
+	                      &coarseScale.saturation ()[0],
+	                      &coarseScale.pressure ()[0],
+	                      rows,
+	                      fineSaturation,
+	                      finePressure);
+}
+
+// header of the checkpoint files
+namespace {
+const char CHKPT_MAGIC[8] = {'O', 'P', 'M', 'V', 'E', 'Q', 'C', 'P'};
+const uint32_t CHKPT_VERSION = 1;
+
+// this value is read back differently if the byte order has changed
+const uint32_t CHKPT_BYTE_ORDER = 0x01020304;
+
+// write an array prefixed with its length, in a single call, so that
+// the stream can pass it through to the file without copying
+void
+write_array (ostream& os, const double* data, uint64_t len) {
+	os.write (reinterpret_cast <const char*> (&len), sizeof (len));
+	os.write (reinterpret_cast <const char*> (data), len * sizeof (double));
+}
+
+// read an array that was written with write_array; the length must be
+// the same as the array that is read into
+void
+read_array (istream& is, double* data, uint64_t len, const char* name) {
+	uint64_t stored;
+	is.read (reinterpret_cast <char*> (&stored), sizeof (stored));
+	if (!is || stored != len) {
+		throw OPM_EXC ("Checkpoint has %lu values for %s, expected %lu",
+		               static_cast <unsigned long> (stored), name,
+		               static_cast <unsigned long> (len));
+	}
+	is.read (reinterpret_cast <char*> (data), len * sizeof (double));
+}
+} // anonymous namespace
+
+void
+VertEqImpl::checkpoint (const TwophaseState& coarseScale,
+                        ostream& os) {
+	TraceScope scope ("checkpoint");
+
+	// identification, so we don't read garbage back later
+	os.write (CHKPT_MAGIC, sizeof (CHKPT_MAGIC));
+	os.write (reinterpret_cast <const char*> (&CHKPT_VERSION), sizeof (uint32_t));
+	os.write (reinterpret_cast <const char*> (&CHKPT_BYTE_ORDER), sizeof (uint32_t));
+
+	// dynamic state of the underlaying simulator
+	write_array (os, &coarseScale.pressure ()[0], coarseScale.pressure ().size ());
+	write_array (os, &coarseScale.facepressure ()[0], coarseScale.facepressure ().size ());
+	write_array (os, &coarseScale.faceflux ()[0], coarseScale.faceflux ().size ());
+	write_array (os, &coarseScale.saturation ()[0], coarseScale.saturation ().size ());
+
+	// history of the plume; everything else in the properties is
+	// computed from the grid and the fine properties
+	write_array (os, pr->max_sat (), ts->number_of_cells);
+
+	if (!os) {
+		throw OPM_EXC ("Unable to write checkpoint");
+	}
+}
+
+void
+VertEqImpl::restore (istream& is,
+                     TwophaseState& coarseScale) {
+	TraceScope scope ("restore");
+
+	// verify that this is a checkpoint that we are able to read
+	char magic[sizeof (CHKPT_MAGIC)];
+	uint32_t version;
+	uint32_t byte_order;
+	is.read (magic, sizeof (magic));
+	is.read (reinterpret_cast <char*> (&version), sizeof (version));
+	is.read (reinterpret_cast <char*> (&byte_order), sizeof (byte_order));
+	if (!is || memcmp (magic, CHKPT_MAGIC, sizeof (magic)) != 0) {
+		throw OPM_EXC ("Stream is not a checkpoint");
+	}
+	if (version != CHKPT_VERSION) {
+		throw OPM_EXC ("Checkpoint has version %u, expected %u",
+		               version, CHKPT_VERSION);
+	}
+	if (byte_order != CHKPT_BYTE_ORDER) {
+		throw OPM_EXC ("Checkpoint was written on a different platform");
+	}
+
+	// dimension state object to the top grid; the sizes of the arrays
+	// in the checkpoint must then match, or it is from another grid
+	coarseScale.init (*ts, pr->numPhases ());
+	read_array (is, &coarseScale.pressure ()[0], coarseScale.pressure ().size (), "pressure");
+	read_array (is, &coarseScale.facepressure ()[0], coarseScale.facepressure ().size (), "facepressure");
+	read_array (is, &coarseScale.faceflux ()[0], coarseScale.faceflux ().size (), "faceflux");
+	read_array (is, &coarseScale.saturation ()[0], coarseScale.saturation ().size (), "saturation");
+
+	// read into a separate array so that the properties are left as they
+	// were if the checkpoint turns out to be truncated
+	vector <double> max_sat (ts->number_of_cells);
+	read_array (is, &max_sat[0], max_sat.size (), "max. saturation");
+	if (!is) {
+		throw OPM_EXC ("Checkpoint is truncated");
+	}
+	pr->max_sat (&max_sat[0]);
+	pl->reset (pr->max_sat ());
+}
+
+void
+VertEqImpl::update_props (const vector <int>& cells) {
+	if (!cells.empty ()) {
+		pr->update (static_cast <int> (cells.size ()), &cells[0]);
+
+		// the transmissibilities depend on the permeability too; find the
+		// columns that the cells are in, each of them only once
+		vector <bool> dirty (ts->number_of_cells, false);
+		vector <int> cols;
+		for (size_t i = 0; i < cells.size (); ++i) {
+			const int col = ts->fine_col[cells[i]];
+			if (!dirty[col]) {
+				dirty[col] = true;
+				cols.push_back (col);
+			}
+		}
+		tr->update (*fine_grid, *ts, fine_props->permeability (),
+		            static_cast <int> (cols.size ()), &cols[0]);
+	}
 }
 
 void
 VertEqImpl::notify (const TwophaseState& coarseScale) {
-	// forward this request to the properties we have stored
-	pr->upd_res_sat (&coarseScale.saturation()[0]);
+	OPM_VERTEQ_TIMED (NOTIFY);
+	TraceScope scope ("notify");
+	const double* sat = &coarseScale.saturation ()[0];
+	const int num_phases = pr->numPhases ();
+
+	// forward this request to the properties we have stored. only the
+	// columns in the plume and its halo can have changed, unless the CO2
+	// has gone further than the halo in a long timestep; then all columns
+	// are checked, and the set is rebuilt from the saturations
+	if (pl->leaked (sat, num_phases, VertEqProps::gas_phase (*pr))) {
+		OPM_VERTEQ_COUNT (bytes, ts->number_of_cells * (num_phases + 1) * sizeof (double));
+		if (local.empty ()) {
+			pr->upd_res_sat (sat);
+		}
+		else {
+			// the saturation is only known in the local columns
+			pr->upd_res_sat (sat, static_cast <int> (local.size ()), &local[0]);
+		}
+		pl->reset (pr->max_sat ());
+	}
+	else {
+		// both lists are sorted, so the local part of the set is found by
+		// walking them side by side
+		const int* cols = pl->cols ();
+		int num_cols = pl->size ();
+		vector <int> local_cols;
+		if (!local.empty ()) {
+			set_intersection (cols, cols + num_cols, local.begin (), local.end (),
+			                  back_inserter (local_cols));
+			num_cols = static_cast <int> (local_cols.size ());
+			cols = local_cols.empty () ? 0 : &local_cols[0];
+		}
+		OPM_VERTEQ_COUNT (bytes, num_cols * (num_phases + 1) * sizeof (double));
+		pr->upd_res_sat (sat, num_cols, cols);
+		pl->update (pr->max_sat ());
+	}
+}
+
+unsigned long
+VertEqImpl::state_bytes () const {
+	// saturation and pressure in every block and in every column
+	const unsigned long num_phases = pr->numPhases ();
+	const unsigned long num_values = (num_phases + 1)
+		* (ts->col_cellpos[ts->number_of_cells] + ts->number_of_cells);
+	return num_values * sizeof (double);
+}
+
+const PerfStats&
+VertEqImpl::perf_stats () {
+	return PerfStats::global ();
 }
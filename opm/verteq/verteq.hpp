@@ -4,6 +4,8 @@
 // Copyright (C) 2013 Uni Research AS
 // This file is licensed under the GNU General Public License v3.0
 
+#include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -18,8 +20,14 @@ struct Wells;
 
 namespace Opm {
 
+class ColumnPartition;
 class IncompPropertiesInterface;
 class TwophaseState;
+class PlumeSet;
+class WellState;
+struct PerfStats;
+struct TopSurf;
+struct TopSurfTrans;
 
 namespace parameter {
 class ParameterGroup;
@@ -57,7 +65,10 @@ public:
 	 *
 	 * @param title Name of the case, gotten from getTITLE().name(); this
 	 *              may be used to set grid-specific properties.
-	 * @param args Parameters
+	 * @param args Parameters. If verteq_compress_layers is true (default
+	 *             false), blocks with the same rock properties are merged
+	 *             into layers when searching for the interfaces; see
+	 *             VertEqProps::compress_layers.
 	 * @param fullGrid Grid obtained elsewhere. This object is not
 	 *        adopted, but is assumed to be live over the lifetime
 	 *        of the upscaling.
@@ -66,9 +77,12 @@ public:
 	 * @param fullSrc List of volumetric source term for each element
 	 *                in the grid.
 	 * @param fullBcs Structure containing a list of boundary conditions
-	 *                (defined in opm/core/pressure/flow_bc.h). Currently,
-	 *                only no-flow boundary conditions are supported (i.e.
-	 *                wells must be the driving force).
+	 *                (defined in opm/core/pressure/flow_bc.h). Pressure
+	 *                and flux conditions may only be on the sides of the
+	 *                columns, and the same side of a column cannot have
+	 *                both kinds. A pressure condition must be on every
+	 *                face of the side, whereas a flux may be on some of
+	 *                them. May be null if all boundaries are closed.
 	 * @param gravity Gravity vector (three-dimensional); must contain
 	 *                three elements, whereas the last is for depth.
 	 *                Usually this is {0., 0., Opm::unit::gravity}.
@@ -84,6 +98,105 @@ public:
 	                       const FlowBoundaryConditions* fullBcs,
 	                       const double* fullGravity);
 
+	/**
+	 * @brief Pseudo-constructor for a model on a top surface which
+	 *        already exists.
+	 *
+	 * Use this when several models are created for the same grid, e.g.
+	 * for different realizations of the rock properties, so that the top
+	 * surface is only computed and stored once.
+	 *
+	 * @param topSurf Top surface created from fullGrid. It is not changed
+	 *                by the model, and is kept alive as long as there
+	 *                are any models referring to it.
+	 *
+	 * The other parameters are the same as for the function above.
+	 *
+	 * @example
+	 * @code{.cpp}
+	 * std::shared_ptr <const TopSurf> ts (TopSurf::create (grid));
+	 * for (int i = 0; i < num_realizations; ++i) {
+	 *   std::unique_ptr <VertEq> ve (VertEq::create (
+	 *     title, args, grid, ts, *props[i], wells, src, bcs, gravity));
+	 *   ...
+	 * }
+	 * @endcode
+	 */
+	static VertEq* create (const std::string& title,
+	                       const Opm::parameter::ParameterGroup& args,
+	                       const UnstructuredGrid& fullGrid,
+	                       std::shared_ptr <const TopSurf> topSurf,
+	                       const IncompPropertiesInterface& fullProps,
+	                       const Wells* fullWells,
+	                       const std::vector<double>& fullSrc,
+	                       const FlowBoundaryConditions* fullBcs,
+	                       const double* fullGravity);
+
+	/**
+	 * @brief Pseudo-constructor for the part of a model that is handled
+	 *        by one process, when the top surface is partitioned.
+	 *
+	 * The upscaled properties and the transmissibilities are only
+	 * computed for the local columns of the part, i.e. the columns that
+	 * it owns and the halo around them. The state is still stored in
+	 * arrays for the whole grid, but upscale() only fills the values for
+	 * the local columns, and downscale() only writes the blocks below the
+	 * columns that are owned. The halo must be updated from the other
+	 * processes after each timestep, e.g. with a HaloExchange.
+	 *
+	 * @param part Partition of the top surface; it is not adopted, and
+	 *             the lists of columns are copied from it.
+	 * @param rank Part of the grid that this model is for, usually the
+	 *             rank of the process.
+	 *
+	 * The other parameters are the same as for the function above.
+	 *
+	 * @example
+	 * @code{.cpp}
+	 * std::shared_ptr <const TopSurf> ts (TopSurf::create (grid));
+	 * ColumnPartition part (*ts, num_procs);
+	 * std::unique_ptr <VertEq> ve (VertEq::create (
+	 *   title, args, grid, ts, props, part, rank, wells, src, bcs, gravity));
+	 * @endcode
+	 */
+	static VertEq* create (const std::string& title,
+	                       const Opm::parameter::ParameterGroup& args,
+	                       const UnstructuredGrid& fullGrid,
+	                       std::shared_ptr <const TopSurf> topSurf,
+	                       const IncompPropertiesInterface& fullProps,
+	                       const ColumnPartition& part,
+	                       int rank,
+	                       const Wells* fullWells,
+	                       const std::vector<double>& fullSrc,
+	                       const FlowBoundaryConditions* fullBcs,
+	                       const double* fullGravity);
+
+	/**
+	 * @brief Pseudo-constructor for an ensemble of models which only
+	 *        differ in the rock and fluid properties.
+	 *
+	 * The upscaled properties of all the realizations are computed in a
+	 * single pass through the columns, which is faster than creating
+	 * each of the models separately.
+	 *
+	 * @param fullProps Properties of each realization. These objects
+	 *                  are not adopted, but must be live over the
+	 *                  lifetime of the models.
+	 *
+	 * @return One new model for each realization, in the same order as
+	 *         fullProps. You are responsible for deleting all of them.
+	 */
+	static std::vector <VertEq*> create (
+		const std::string& title,
+		const Opm::parameter::ParameterGroup& args,
+		const UnstructuredGrid& fullGrid,
+		std::shared_ptr <const TopSurf> topSurf,
+		const std::vector <const IncompPropertiesInterface*>& fullProps,
+		const Wells* fullWells,
+		const std::vector<double>& fullSrc,
+		const FlowBoundaryConditions* fullBcs,
+		const double* fullGravity);
+
 	// virtual destructor, actual functionality relayed to real impl.
 	virtual ~VertEq () {}
 
@@ -99,14 +212,62 @@ public:
 	 */
 	virtual const UnstructuredGrid& grid () = 0;
 
+	/**
+	 * @brief Accessor method for the upscaled grid, including the
+	 *        information about how it maps to the full grid.
+	 *
+	 * This is the same object as returned from grid(), only with the
+	 * columns of the fine grid available as well.
+	 *
+	 * @return Top surface grid. You do NOT own this object!
+	 */
+	virtual const TopSurf& top_surf () = 0;
+
+	/**
+	 * @brief Accessor method for the transmissibilities of the upscaled
+	 *        grid.
+	 *
+	 * These are integrated from the lateral faces of the fine grid when
+	 * the model is created, so that a pressure solver does not have to
+	 * compute them again from the geometry of the upscaled grid and the
+	 * averaged permeability.
+	 *
+	 * @return Half-transmissibilities and transmissibilities for the
+	 *         faces of grid(). You do NOT own this object!
+	 */
+	virtual const TopSurfTrans& trans () = 0;
+
+	/**
+	 * @brief Accessor method for the columns around the plume.
+	 *
+	 * Only the columns in this set can change saturation in the next
+	 * timestep, if it satisfies the CFL condition; the rest of the domain
+	 * holds pure brine. notify() only updates the columns in the set,
+	 * unless it finds CO2 next to it; then all the columns are checked
+	 * and the set is rebuilt, so CO2 that has gone past the halo is still
+	 * picked up. The width of the band around the plume is given by the
+	 * parameter verteq_plume_halo (default 1); a negative value puts every
+	 * column in the set.
+	 *
+	 * @return Set of columns in grid(). You do NOT own this object!
+	 */
+	virtual const PlumeSet& plume () = 0;
+
 	/**
 	 * @brief Accessor method for the list of upscaled wells.
 	 *
 	 * This method is inexpensive; the listis not constructed upon
 	 * every invocation.
 	 *
+	 * The wells are the same, and at the same indices, as the original
+	 * ones, but all the perforations of a well in one column are merged
+	 * into a single connection, whose well index is the sum of theirs.
+	 * Several wells may have a connection to the same column.
+	 *
 	 * @return List of wells that may be passed to other components
 	 *         in the simulator. You do NOT own this object!
+	 *
+	 * @see upscale_wells, downscale_wells
 	 */
 	virtual const Wells* wells () = 0;
 
@@ -140,6 +301,15 @@ public:
 	 * @return A structure containing the boundary conditions on the
 	 *         upscaled grid.
 	 *
+	 * The fluxes through the faces on a side of a column are summed. The
+	 * pressure on each face is referred to the top of the column along
+	 * the hydrostatic gradient of the heavier phase (brine) alone, and
+	 * these are then averaged by area. Unlike the pressure in the interior,
+	 * which is integrated through the CO2 and brine in the column, this
+	 * assumes that the boundary is in the brine; a pressure condition on
+	 * a side that the plume has reached is referred too low at the top.
+	 * A pressure condition must cover all the faces on its side.
+	 *
 	 * @note The lifetime of the returned object is no longer than that
 	 *       of the upscaling object. You do NOT own this object; do not
 	 *       dispose of the pointer.
@@ -150,8 +320,13 @@ public:
 	 * @brief Gravity that should be used in the upscaled, two-
 	 *        dimensional model.
 	 *
-	 * @return Pointer to an array of two double, describing the
-	 *         gravity in x- and y- directions (z has been upscaled away).
+	 * The vertical gravity is projected onto a plane that is fitted to
+	 * the depth of the top surface, so that the CO2 migrates up-dip along
+	 * the caprock also in the two-dimensional model.
+	 *
+	 * @return Pointer to an array of three double; the two first are the
+	 *         gravity in x- and y- directions along the caprock, and the
+	 *         last is the original vertical component.
 	 *
 	 * @note The lifetime of the returned array is no longer than that
 	 *       of the upscaling object. You do NOT own this pointer and
@@ -159,6 +334,22 @@ public:
 	 */
 	virtual const double* gravity () = 0;
 
+	/**
+	 * @brief Gravity potential for each face of each column in the
+	 *        upscaled grid.
+	 *
+	 * This is the gravity times the difference in depth from the top of
+	 * the column to the face, where the depth of the face is interpolated
+	 * from the columns on each side of it. It has the same format as the
+	 * output of compute_gpress in opm-core, and describes a caprock with
+	 * a varying slope better than the single vector from gravity(). The
+	 * difference between the two sides of a face is what drives the
+	 * buoyancy in TransportSolverVE and in StepControl.
+	 *
+	 * @return One value for each entry in the cell_faces array of grid().
+	 */
+	virtual const std::vector<double>& gravity_potential () = 0;
+
 	/**
 	 * Create an upscaled view of the domain state.
 	 *
@@ -208,6 +399,88 @@ public:
 	virtual void downscale (const TwophaseState& coarseScale,
 	                        TwophaseState& fineScale) = 0;
 
+	/**
+	 * Report the fine-scale state of a single column which corresponds
+	 * to the current coarse-scale state.
+	 *
+	 * Use this method instead of downscale() when only a few cells of
+	 * the fine-scale state are of interest.
+	 *
+	 * @param col[in]
+	 *	Index of the column in the upscaled grid.
+	 *
+	 * @param coarseScale[in]
+	 *	State maintained by the underlaying (2D) simulator.
+	 *
+	 * @param rows[in]
+	 *	Position in the output arrays of each block in the column, from
+	 *	the top and downwards.
+	 *
+	 * @param fineSaturation[out]
+	 *	Saturation of each phase for each block, at the given positions.
+	 *
+	 * @param finePressure[out]
+	 *	Pressure for each block, at the given positions.
+	 *
+	 * @see VertEqView, VertEqProps::downscale_column
+	 */
+	virtual void downscale (int col,
+	                        const TwophaseState& coarseScale,
+	                        const int* rows,
+	                        double* fineSaturation,
+	                        double* finePressure) = 0;
+
+	/**
+	 * Recompute the upscaled rock properties after the porosity or the
+	 * permeability of some cells has changed in the fine properties.
+	 *
+	 * The fine properties object passed to create() must have been
+	 * modified in place; only the columns which contain any of the given
+	 * cells are upscaled again. Use this when running several cases where
+	 * only a few regions differ, e.g. in history matching.
+	 *
+	 * Quantities which the simulator derives from the upscaled properties
+	 * (such as the pore volumes and transmissibilities) must be computed
+	 * again by the caller afterwards.
+	 *
+	 * @param cells Indices of cells in the fine grid which have changed.
+	 */
+	virtual void update_props (const std::vector <int>& cells) = 0;
+
+	/**
+	 * Write the state of the upscaled simulation to a binary stream, so
+	 * that it can later be continued with restore().
+	 *
+	 * Besides the coarse state itself, the maximum saturation that has
+	 * been seen in each column is written, since the amount of residual
+	 * CO2 depends on it. The data is written in the native byte order of
+	 * the machine.
+	 *
+	 * @param coarseScale State of the upscaled domain, which has been
+	 *                    notified to this model.
+	 * @param os Stream opened in binary mode.
+	 *
+	 * @see VertEq::restore
+	 */
+	virtual void checkpoint (const TwophaseState& coarseScale,
+	                         std::ostream& os) = 0;
+
+	/**
+	 * Read the state of the upscaled simulation from a binary stream,
+	 * which was written by checkpoint() from a model of the same grid.
+	 *
+	 * This replaces upscale() when restarting a simulation; the model is
+	 * afterwards in the same condition as when the checkpoint was taken.
+	 *
+	 * @param is Stream opened in binary mode.
+	 * @param coarseScale State of the upscaled domain; this is
+	 *                    initialized to the top surface.
+	 *
+	 * @see VertEq::checkpoint
+	 */
+	virtual void restore (std::istream& is,
+	                      TwophaseState& coarseScale) = 0;
+
 	/**
 	 * Update the internal variables based on the state.
 	 *
@@ -225,6 +498,46 @@ public:
 	 * @see VertEqState, VertEq::upscale
 	 */
 	virtual void notify(const TwophaseState& coarseScale) = 0;
+
+	/**
+	 * Transfer the state of the original wells to the upscaled ones.
+	 *
+	 * The bottom-hole pressures are the same, since the wells are. The
+	 * rates of the perforations that are merged into a connection are
+	 * summed, and their pressures averaged by the well index.
+	 *
+	 * @param fineWells[in]
+	 *	State of the wells that were passed to create().
+	 *
+	 * @param coarseWells[out]
+	 *	State that has been initialized with the list from wells().
+	 */
+	virtual void upscale_wells (const WellState& fineWells,
+	                            WellState& coarseWells) = 0;
+
+	/**
+	 * Transfer the state of the upscaled wells back to the original
+	 * ones. The flow of each connection is split among the perforations
+	 * that were merged into it, in proportion to their well index.
+	 *
+	 * @param coarseWells[in]
+	 *	State of the wells from wells(), as updated by the simulator.
+	 *
+	 * @param fineWells[out]
+	 *	State of the wells that were passed to create(); overwritten.
+	 */
+	virtual void downscale_wells (const WellState& coarseWells,
+	                              WellState& fineWells) = 0;
+
+	/**
+	 * Timings and counters of upscale, notify, downscale and of the
+	 * evaluation of the upscaled properties.
+	 *
+	 * These are only collected if the library is compiled with
+	 * instrumentation, and they are shared by all the models in the
+	 * process (see PerfStats).
+	 */
+	virtual const PerfStats& perf_stats () = 0;
 };
 
 } // namespace Opm
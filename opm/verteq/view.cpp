@@ -0,0 +1,105 @@
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+#include <opm/verteq/view.hpp>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/verteq.hpp>
+#include <opm/verteq/utility/exc.hpp>
+#include <opm/verteq/utility/runlen.hpp>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <numeric> // iota
+
+using namespace Opm;
+using namespace std;
+
+VertEqView::VertEqView (VertEq& model,
+                        const TwophaseState& coarseScale)
+	: ve (model)
+	, ts (model.top_surf ())
+	, coarse (coarseScale)
+	, num_phases (coarseScale.numPhases ())
+	, fine_row (ts.col_cellpos[ts.number_of_cells])
+	, rows (ts.max_vert_res)
+	// no column has been reconstructed yet; the first generation is
+	// one so that the initial stamps are all out-of-date
+	, offset (ts.number_of_cells, 0)
+	, stamp (ts.number_of_cells, 0)
+	, generation (1) {
+
+	// invert the column map of the top surface, so that we can find
+	// the position of each cell in the compact column record
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	for (int col = 0; col < col_cells.cols (); ++col) {
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			fine_row[col_cells[col][row]] = row;
+		}
+	}
+
+	// every column is written starting at the beginning of its record
+	iota (rows.begin (), rows.end (), 0);
+}
+
+int
+VertEqView::numCells () const {
+	return static_cast <int> (fine_row.size ());
+}
+
+int
+VertEqView::numPhases () const {
+	return num_phases;
+}
+
+void
+VertEqView::invalidate () {
+	// all stamps are now out-of-date, and the storage they point to can
+	// be reused (without releasing the memory)
+	++generation;
+	pool.clear ();
+}
+
+int
+VertEqView::column (int col) const {
+	// if we have already reconstructed this column, then just return
+	// where it was put
+	if (stamp[col] == generation) {
+		return offset[col];
+	}
+
+	// append a new record at the end of the pool, with room for the
+	// saturations of every block, followed by the pressures
+	const rlw_int col_cells (ts.number_of_cells, ts.col_cellpos, ts.col_cells);
+	const int num_rows = col_cells.size (col);
+	const int start = static_cast <int> (pool.size ());
+	pool.resize (start + num_rows * (num_phases + 1));
+
+	// let the model fill the record; the identity mapping of rows makes
+	// it write the blocks consecutively
+	double* const sat = &pool[start];
+	double* const pres = sat + num_rows * num_phases;
+	ve.downscale (col, coarse, &rows[0], sat, pres);
+
+	// remember that this column is now current
+	offset[col] = start;
+	stamp[col] = generation;
+	return start;
+}
+
+double
+VertEqView::pressure (int cell) const {
+	// find the column record that contains this cell
+	const int col = ts.fine_col[cell];
+	const int start = column (col);
+
+	// pressures are stored after all the saturations in the column
+	const int num_rows = ts.col_cellpos[col+1] - ts.col_cellpos[col];
+	return pool[start + num_rows * num_phases + fine_row[cell]];
+}
+
+double
+VertEqView::saturation (int cell, int phase) const {
+	// find the column record that contains this cell
+	const int col = ts.fine_col[cell];
+	const int start = column (col);
+
+	// saturations are stored as records for each block
+	return pool[start + fine_row[cell] * num_phases + phase];
+}
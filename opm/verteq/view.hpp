@@ -0,0 +1,127 @@
+#ifndef OPM_VERTEQ_VIEW_HPP_INCLUDED
+#define OPM_VERTEQ_VIEW_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+#include <vector>
+
+#ifndef OPM_VERTEQ_VISIBILITY_HPP_INCLUDED
+#include <opm/verteq/visibility.hpp>
+#endif /* OPM_VERTEQ_VISIBILITY_HPP_INCLUDED */
+
+namespace Opm {
+
+// forward declarations
+class TwophaseState;
+class VertEq;
+struct TopSurf;
+
+/**
+ * Read-only view of the fine-scale state that corresponds to a coarse-
+ * scale state.
+ *
+ * Instead of downscaling the entire state into the fine grid, the values
+ * of a column are reconstructed the first time a cell in it is accessed,
+ * and then kept until the view is invalidated. Use this object when you
+ * only read a few cells of the fine-scale state, e.g. at observation
+ * points or at well locations.
+ *
+ * The view refers to the coarse state; it is only valid as long as the
+ * coarse state and the model exist.
+ *
+ * @example
+ * @code{.cpp}
+ * VertEqWrapper <SimulatorIncompTwophase> sim (...);
+ * // in a timestep callback
+ * const double p = sim.view ().pressure (cell);
+ * @endcode
+ *
+ * @see VertEqWrapperBase::view, VertEqWrapperBase::sync
+ */
+class OPM_VERTEQ_PUBLIC VertEqView {
+public:
+	/**
+	 * Create a view of the fine-scale state.
+	 *
+	 * @param model       Vertical equilibrium model which can downscale.
+	 * @param coarseScale State of the upscaled domain which the values
+	 *                    are reconstructed from.
+	 */
+	VertEqView (VertEq& model,
+	            const TwophaseState& coarseScale);
+
+	/**
+	 * Number of cells in the fine grid, i.e. the valid range of indices
+	 * for the accessors.
+	 */
+	int numCells () const;
+
+	/**
+	 * Number of phases for which there are saturations.
+	 */
+	int numPhases () const;
+
+	/**
+	 * Pressure in a block of the fine grid.
+	 *
+	 * @param cell Index of the cell in the fine grid.
+	 */
+	double pressure (int cell) const;
+
+	/**
+	 * Saturation of a phase in a block of the fine grid.
+	 *
+	 * @param cell  Index of the cell in the fine grid.
+	 * @param phase Index of the phase, in the same ordering as in the
+	 *              properties.
+	 */
+	double saturation (int cell, int phase) const;
+
+	/**
+	 * Forget all reconstructed values. The next access to a column will
+	 * downscale it anew from the coarse state. Call this whenever the
+	 * coarse state has changed, i.e. when a timestep is completed.
+	 *
+	 * (The reason this method isn't const is that it is intended to be
+	 * registered as a callback)
+	 */
+	void invalidate ();
+
+private:
+	VertEq& ve;
+	const TopSurf& ts;
+	const TwophaseState& coarse;
+
+	// number of phases in the state
+	const int num_phases;
+
+	// row number of each fine cell in its column; this is the inverse
+	// of the col_cells member of the top surface
+	std::vector <int> fine_row;
+
+	// identity mapping 0, 1, ..., n-1 for a column of n blocks, to get
+	// the downscaled values in compact format
+	std::vector <int> rows;
+
+	// columns that are reconstructed are stored consecutively in this
+	// pool, each as a number of saturation records followed by the
+	// pressures. offset of each column's record, valid only if the stamp
+	// of the column matches the current generation
+	mutable std::vector <double> pool;
+	mutable std::vector <int> offset;
+	mutable std::vector <unsigned> stamp;
+
+	// invalidating all columns is done by starting a new generation
+	unsigned generation;
+
+	/**
+	 * Location in the pool of the record for a column, reconstructing
+	 * the values if they are not already present.
+	 */
+	int column (int col) const;
+};
+
+} /* namespace Opm */
+
+#endif /* OPM_VERTEQ_VIEW_HPP_INCLUDED */
@@ -1,12 +1,23 @@
 #include <opm/verteq/wrapper.hpp>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
 #include <string>
+#include <opm/verteq/multigrid.hpp>
 #include <opm/verteq/verteq.hpp>
 #include <opm/verteq/state.hpp>
+#include <opm/verteq/view.hpp>
 #include <opm/verteq/utility/exc.hpp>
+#include <opm/verteq/utility/trace.hpp>
 #include <opm/core/simulator/SimulatorIncompTwophase.hpp>
 #include <opm/core/simulator/SimulatorReport.hpp>
+#include <opm/core/simulator/SimulatorTimer.hpp>
 #include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/simulator/WellState.hpp>
 #include <opm/core/utility/Event.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-parameter"
@@ -40,7 +51,16 @@ VertEqWrapperBase::VertEqWrapperBase (
 	, timestep_callbacks (new EventSource ())
 	, fineState (0)
 	, coarseState (0)
-	, syncDone (false) {
+	, syncDone (false)
+	, tracing (false)
+	, step_begin (0.) {
+
+	// write a timeline of the simulation, if requested
+	const string trace_file = param.getDefault <string> ("verteq_trace", string (""));
+	if (!trace_file.empty ()) {
+		TraceSink::start (trace_file);
+		tracing = true;
+	}
 
 	// VE model that is injected in between the fine-scale
 	// model that is sent to us, and the simulator
@@ -63,6 +83,22 @@ VertEqWrapperBase::VertEqWrapperBase (
 	// simulator (it cannot be a local here)
 	wells_mgr = new WellsManager (const_cast <Wells*> (ve->wells ()));
 
+	// the upscaled grid is structured, which a specialized solver can
+	// take advantage of
+	const string solver_name = param.getDefault <string> ("verteq_linsolver", string (""));
+	if (solver_name == "multigrid") {
+		coarse_linsolver.reset (new LinearSolverMG (ve->grid (), param));
+	}
+	else if (!solver_name.empty ()) {
+		throw OPM_EXC ("Unknown linear solver \"%s\"", solver_name.c_str ());
+	}
+
+	// the report steps may be divided further, depending on how fast
+	// the plume is moving
+	if (param.getDefault ("verteq_adaptive", false)) {
+		stepper.reset (new StepControl (*ve, param));
+	}
+
     // pass arguments to the underlaying simulator; this is where
     // the smart pointer wrapper will actually create the underlaying
     // simulator instance
@@ -73,8 +109,14 @@ VertEqWrapperBase::VertEqWrapperBase (
                *wells_mgr,
                ve->src (),
                ve->bcs (),
-               linsolver,
+               coarse_linsolver ? *coarse_linsolver : linsolver,
                ve->gravity ());
+
+	// the simulator keeps its callbacks for as long as it lives, so
+	// register only one, which finds the current state when signaled;
+	// then the wrapper can be run several times
+	sim->timestep_completed ()
+	    .add <VertEqWrapperBase, &VertEqWrapperBase::step_completed> (*this);
 }
 
 Event&
@@ -87,9 +129,62 @@ VertEqWrapperBase::resetSyncFlag () {
 	this->syncDone = false;
 }
 
+void
+VertEqWrapperBase::begin_step () {
+	step_begin = TraceSink::now ();
+}
+
+void
+VertEqWrapperBase::end_step () {
+	if (TraceSink::enabled ()) {
+		TraceSink::complete ("coarse step", step_begin);
+	}
+}
+
+void
+VertEqWrapperBase::signal_callbacks () {
+	// this is where the client writes output
+	TraceScope scope ("callbacks");
+	timestep_callbacks->signal ();
+}
+
+void
+VertEqWrapperBase::step_completed () {
+	// the step of the simulator ends when it signals us; this must be
+	// done first so that the others are not counted in it
+	end_step ();
+
+	// make the state "active", so that it push its changes to the
+	// ve model whenever an update is completed and its state is stable
+	if (coarseState) {
+		coarseState->notify ();
+	}
+
+	// values that are reconstructed in the view are stale as soon as the
+	// timestep is completed; this must happen before any of the callbacks
+	// that are signaled below get a chance to read from it
+	if (fineView) {
+		fineView->invalidate ();
+	}
+
+	// notify everyone that has registered at us on behalf of the inner
+	// simulator; this daisy chains the list of callbacks
+	signal_callbacks ();
+
+	// after the other callbacks have been signaled, then reset the sync
+	// flag so that the next timestep it will have to be done again
+	resetSyncFlag ();
+
+	// and then the simulator continues with the next step
+	begin_step ();
+}
+
 VertEqWrapperBase::~VertEqWrapperBase () {
 	delete wells_mgr;
 	delete ve;
+	if (tracing) {
+		TraceSink::stop ();
+	}
 }
 
 SimulatorReport
@@ -101,37 +196,55 @@ VertEqWrapperBase::run(
 	// the state that is passed is for fine-scale; we need to create
 	// a coarse state that matches the grid, for the simulator
 	VertEqState upscaled_state (*ve, state);
+	return run (timer, upscaled_state, state, well_state);
+}
+
+SimulatorReport
+VertEqWrapperBase::restart(
+		istream& checkpoint,
+		SimulatorTimer& timer,
+		TwophaseState& state,
+		WellState& well_state) {
+
+	// the coarse state is read directly, without going through the
+	// fine-scale state that is passed to us
+	VertEqState upscaled_state (*ve, checkpoint);
+	return run (timer, upscaled_state, state, well_state);
+}
+
+SimulatorReport
+VertEqWrapperBase::run(
+		SimulatorTimer& timer,
+		VertEqState& upscaled_state,
+		TwophaseState& state,
+		WellState& well_state) {
 
 	// setup the "current" state so that we can downscale this on
 	// demand for any callbacks in the sync() method
 	this->fineState = &state;
 	this->coarseState = &upscaled_state;
+	this->fineView.reset (new VertEqView (*ve, upscaled_state));
 
-	// make the state "active", so that it push its changes to the
-	// ve model whenever an update is completed and its state is stable
-	sim->timestep_completed ()
-	    .add <VertEqState, &VertEqState::notify> (upscaled_state);
+	// the internal well manager used here contains the same wells at
+	// the same indices as the original, but the perforations in each
+	// column are merged, so the simulator needs a well state of its own
+	// that is translated back and forth
+	WellState upscaled_wells;
+	upscaled_wells.init (ve->wells (), upscaled_state);
+	ve->upscale_wells (well_state, upscaled_wells);
 
-	// add everyone that has registered at us to be notified by the
-	// inner simulator as well (on our behalf); this daisy chains the
-	// list of callbacks
-	sim->timestep_completed ()
-	    .add <EventSource, &EventSource::signal> (*timestep_callbacks);
-
-	// after the other callbacks have been signaled, then reset
-	// the sync flag so that the next timestep it will have to be
-	// done again (this depends on the ordering of the callbacks)
-	sim->timestep_completed ()
-	    .add <VertEqWrapperBase, &VertEqWrapperBase::resetSyncFlag> (*this);
+	// forward the call to the underlaying simulator, either with the
+	// report steps as they are, or one step at a time
+	const PerfStats before = PerfStats::global ();
+	begin_step ();
+	SimulatorReport report = stepper
+	    ? run_adaptive (timer, upscaled_state, upscaled_wells)
+	    : sim->run (timer, upscaled_state, upscaled_wells);
+	ve->downscale_wells (upscaled_wells, well_state);
 
-	// we "reuse" the well state for the three-dimensional grid;
-	// it is a value object which is created once based on the
-	// list of wells. the internal well manager used here contains
-	// the same wells at the same indices as the original, so the
-	// state should work with the clone, too.
-
-	// forward the call to the underlaying simulator
-	SimulatorReport report = sim->run(timer, upscaled_state, well_state);
+	// the counters are global, so keep what was added during this run
+	run_stats = PerfStats::global ();
+	run_stats -= before;
 
 	// clear the state pointers after the simulation has ended; then
 	// there is no "current" state anymore (but the fine state object
@@ -139,10 +252,55 @@ VertEqWrapperBase::run(
 	// of course still valid
 	this->fineState = 0;
 	this->coarseState = 0;
+	this->fineView.reset ();
 
 	return report;
 }
 
+SimulatorReport
+VertEqWrapperBase::run_adaptive (
+		SimulatorTimer& timer,
+		TwophaseState& upscaled_state,
+		WellState& well_state) {
+
+	SimulatorReport report;
+	while (!timer.done ()) {
+		// divide each report step; the length of each part is decided
+		// from the state at the end of the previous one
+		const double length = timer.currentStepLength ();
+		stepper->begin (length);
+		double remaining = length;
+		while (remaining > 0.) {
+			const double step = stepper->next_step (upscaled_state, remaining);
+
+			// the simulator takes its steps from a timer, so give it one
+			// with only this step in it
+			ostringstream days;
+			days << setprecision (17) << step / unit::day;
+			parameter::ParameterGroup step_param;
+			step_param.insertParameter ("num_psteps", string ("1"));
+			step_param.insertParameter ("stepsize_days", days.str ());
+			SimulatorTimer step_timer;
+			step_timer.init (step_param);
+
+			report += sim->run (step_timer, upscaled_state, well_state);
+			remaining -= step;
+		}
+		++timer;
+	}
+	return report;
+}
+
+StepStats
+VertEqWrapperBase::step_stats () const {
+	return stepper ? stepper->stats () : StepStats ();
+}
+
+PerfStats
+VertEqWrapperBase::perf_stats () const {
+	return run_stats;
+}
+
 void
 VertEqWrapperBase::sync () {
 	// if there is no "current" state, then we have been called from
@@ -155,9 +313,28 @@ VertEqWrapperBase::sync () {
 	// to it, based on these two pointers to them, once, and then mark
 	// that we don't need to do that for the rest of this timestep
 	if (!syncDone) {
+		TraceScope scope ("sync");
 		ve->downscale (*coarseState, *fineState);
 		syncDone = true;
 	}
 }
 
+void
+VertEqWrapperBase::checkpoint (ostream& os) {
+	// the coarse state only exists inside run
+	if (!coarseState) {
+		throw OPM_EXC ("checkpoint() called from outside callback!");
+	}
+	ve->checkpoint (*coarseState, os);
+}
+
+const VertEqView&
+VertEqWrapperBase::view () {
+	// the view refers to the coarse state, which only exists inside run
+	if (!fineView) {
+		throw OPM_EXC ("view() called from outside callback!");
+	}
+	return *fineView;
+}
+
 } /* namespace Opm */
@@ -4,6 +4,7 @@
 // Copyright (C) 2013 Uni Research AS
 // This file is licensed under the GNU General Public License v3.0
 
+#include <iosfwd>
 #include <vector>
 #include <memory> // unique_ptr
 
@@ -15,6 +16,14 @@
 #include <opm/verteq/opmfwd.hpp>
 #endif /* OPM_VERTEQ_OPMFWD_HPP_INCLUDED */
 
+#ifndef OPM_VERTEQ_STEPPING_HPP_INCLUDED
+#include <opm/verteq/stepping.hpp>
+#endif /* OPM_VERTEQ_STEPPING_HPP_INCLUDED */
+
+#ifndef OPM_VERTEQ_INSTRUMENT_HPP_INCLUDED
+#include <opm/verteq/utility/instrument.hpp>
+#endif /* OPM_VERTEQ_INSTRUMENT_HPP_INCLUDED */
+
 #ifndef OPM_VERTEQ_SIMULATOR_HPP_INCLUDED
 #include <opm/verteq/simulator.hpp>
 #endif /* OPM_VERTEQ_SIMULATOR_HPP_INCLUDED */
@@ -23,6 +32,8 @@ namespace Opm {
 
 // forward declaration
 class VertEq;
+class VertEqView;
+struct VertEqState;
 
 /**
  * Wrapper that takes fine-scale 3D input, but uses an underlaying
@@ -51,7 +62,18 @@ protected:
 	 * @param well_manager    Well manager, may manage no (null) wells
 	 * @param src             Source terms
 	 * @param bcs             Boundary conditions, treat as all noflow if null
-	 * @param linsolver       Linear solver
+	 * @param linsolver       Linear solver; if the parameter verteq_linsolver
+	 *                        is "multigrid", then LinearSolverMG is used
+	 *                        for the upscaled grid instead of this
+	 *
+	 * If the parameter verteq_adaptive is true, then each report step is
+	 * divided into steps with a StepControl, see there for the rest of the
+	 * parameters.
+	 *
+	 * If the parameter verteq_trace is a file name, then a timeline of the
+	 * steps, the callbacks and the upscaling is written to it, which can be
+	 * viewed in chrome://tracing or Perfetto; see TraceSink. Simulators
+	 * that run at the same time share the trace of the first of them.
 	 * @param gravity         If non-null, gravity vector
 	*/
 	VertEqWrapperBase (
@@ -77,6 +99,18 @@ public:
 	 * This will run succesive timesteps until timer.done() is true. It will
 	 * modify the reservoir and well states.
 	 *
+	 * With adaptive steps, the underlaying simulator is run for one step
+	 * at a time, so timestep_completed() is signaled for every step and not
+	 * only at the end of each report step. The simulator should not write
+	 * output on its own then, since it numbers the steps from zero in
+	 * every run.
+	 *
+	 * The same wrapper may be run several times, e.g. to continue with
+	 * another schedule, or restart()-ed from a checkpoint after a run.
+	 * The history of the plume is kept in the model between the runs,
+	 * so a new run with a state that was not left by the previous one
+	 * should rather go through restart().
+	 *
 	 * @param[in,out] timer       Governs the requested reporting timesteps
 	 * @param[in,out] state       State of reservoir: pressure, fluxes
 	 * @param[in,out] well_state  State of wells: bhp, perforation rates
@@ -87,6 +121,42 @@ public:
 		TwophaseState& state,
 		WellState& well_state);
 
+	/**
+	 * Continue a simulation from a checkpoint.
+	 *
+	 * This is the same as run(), except that the initial state is read
+	 * from the checkpoint instead of being upscaled from the fine-scale
+	 * state. The timer and the well state are not part of the checkpoint;
+	 * the caller must position the timer at the step where the checkpoint
+	 * was taken.
+	 *
+	 * @param[in]     checkpoint  Stream written by checkpoint()
+	 * @param[in,out] timer       Governs the requested reporting timesteps
+	 * @param[in,out] state       Fine-scale state that is written by sync();
+	 *                            must be initialized for the grid
+	 * @param[in,out] well_state  State of wells: bhp, perforation rates
+	 * @return                    Simulation report, with timing data
+	 */
+	virtual SimulatorReport restart (
+		std::istream& checkpoint,
+		SimulatorTimer& timer,
+		TwophaseState& state,
+		WellState& well_state);
+
+	/**
+	 * Write the current coarse-scale state to a stream, from which the
+	 * simulation can later be continued with restart().
+	 *
+	 * Only the upscaled state is written, so this is much faster than
+	 * to sync() and write the fine-scale state. Call this from a callback
+	 * that is registered with timestep_completed().
+	 *
+	 * @param os Stream opened in binary mode.
+	 *
+	 * @see VertEq::checkpoint
+	 */
+	void checkpoint (std::ostream& os);
+
 	/**
 	 * Event that is signaled every time the simulator has completed a
 	 * timestep.
@@ -107,13 +177,59 @@ public:
 	 */
 	void sync ();
 
+	/**
+	 * Read-only view of the fine-scale state that corresponds to the
+	 * current coarse-scale state.
+	 *
+	 * Contrary to sync(), the fine-scale state is not downscaled in its
+	 * entirety; only the columns of the cells that are accessed are
+	 * reconstructed. The values are kept until the next timestep is
+	 * completed.
+	 *
+	 * @return View which is valid for the duration of the callback.
+	 *
+	 * @see VertEqView
+	 */
+	const VertEqView& view ();
+
+	/**
+	 * Statistics of the adaptive steps that has been taken so far. These
+	 * are all zero if the steps are not adaptive.
+	 */
+	StepStats step_stats () const;
+
+	/**
+	 * Time spent in the upscaling during the last call to run() or
+	 * restart(), to be reported together with the SimulatorReport that
+	 * was returned. This is all zero unless the library is compiled with
+	 * instrumentation.
+	 *
+	 * @example
+	 * @code{.cpp}
+	 * SimulatorReport rep = simulator.run (timer, state, well_state);
+	 * rep.report (std::cout);
+	 * simulator.perf_stats ().report (std::cout);
+	 * @endcode
+	 */
+	PerfStats perf_stats () const;
+
 private:
+	// linear solver specific for the upscaled grid, if requested; this
+	// must outlive the simulator, which keeps a reference to it
+	std::unique_ptr <LinearSolverInterface> coarse_linsolver;
+
 	// underlaying simulator to use for 2D
 	std::unique_ptr <Simulator> sim;
 
 	// vertical equilibrium model
 	VertEq* ve;
 
+	// length of the steps inside each report step, if they are adaptive
+	std::unique_ptr <StepControl> stepper;
+
+	// counters of the upscaling for the last run
+	PerfStats run_stats;
+
 	// list of translated wells
 	WellsManager* wells_mgr;
 
@@ -122,11 +238,41 @@ private:
 
 	// current state of any simulation we are doing
 	TwophaseState* fineState;
-	TwophaseState* coarseState;
+	VertEqState* coarseState;
+
+	// lazily reconstructed fine-scale state
+	std::unique_ptr <VertEqView> fineView;
+
+	// run the simulation from an upscaled state which is initialized
+	SimulatorReport run (
+		SimulatorTimer& timer,
+		VertEqState& upscaled_state,
+		TwophaseState& state,
+		WellState& well_state);
+
+	// run with the report steps divided by the step control
+	SimulatorReport run_adaptive (
+		SimulatorTimer& timer,
+		TwophaseState& upscaled_state,
+		WellState& well_state);
 
 	// flag that determines whether we have synced or not
 	bool syncDone;
 	void resetSyncFlag ();
+
+	// if a trace is written (parameter verteq_trace), the time between
+	// the callbacks is recorded as a step of the underlaying simulator
+	bool tracing;
+	double step_begin;
+	void begin_step ();
+	void end_step ();
+
+	// pass the notification on to those that have registered with us
+	void signal_callbacks ();
+
+	// handler that is registered once with the underlaying simulator,
+	// and which passes the notification on to the current state
+	void step_completed ();
 };
 
 /**
@@ -0,0 +1,91 @@
+#ifndef OPM_VERTEQ_TESTS_FIXTURES_HPP_INCLUDED
+#define OPM_VERTEQ_TESTS_FIXTURES_HPP_INCLUDED
+
+// Copyright (C) 2013 Uni Research AS
+// This file is licensed under the GNU General Public License v3.0
+
+// this file is included by a single translation unit in each of the test
+// programs, so the static members can be defined here
+
+#include <opm/core/props/BlackoilPhases.hpp>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+
+#include <vector>
+
+const int GAS = Opm::BlackoilPhases::Liquid;
+const int WAT = Opm::BlackoilPhases::Aqua;
+
+/**
+ * Rock and fluid with residual saturations, and rel.perm. which is
+ * linear between them; the CO2 is the lighter phase, whichever index
+ * it has.
+ *
+ * The rock is homogeneous and isotropic, and the defaults are those of
+ * CO2 and brine in a sandstone, in SI units. Tests can change the rock
+ * of each cell afterwards.
+ */
+struct ResidualProps : public Opm::IncompPropertiesInterface {
+	int num_cells;
+	int gas;
+	int wat;
+	std::vector <double> poro;
+	std::vector <double> perm;
+	double visc[2];
+	double dens[2];
+
+	ResidualProps (int num_cells,
+	               int gas = GAS,
+	               double abs_perm = 1e-13,
+	               double gas_visc = 5e-5,
+	               double wat_visc = 5e-4,
+	               double gas_dens = 700.,
+	               double wat_dens = 1000.)
+		: num_cells (num_cells)
+		, gas (gas)
+		, wat (1 - gas)
+		, poro (num_cells, 0.2)
+		, perm (num_cells * 9, 0.) {
+		for (int cell = 0; cell < num_cells; ++cell) {
+			perm[cell * 9 + 0] = perm[cell * 9 + 4] = perm[cell * 9 + 8] = abs_perm;
+		}
+		visc[gas] = gas_visc; visc[wat] = wat_visc;
+		dens[gas] = gas_dens; dens[wat] = wat_dens;
+	}
+	virtual int numDimensions () const { return 3; }
+	virtual int numCells () const { return num_cells; }
+	virtual const double* porosity () const { return &poro[0]; }
+	virtual const double* permeability () const { return &perm[0]; }
+	virtual int numPhases () const { return 2; }
+	virtual const double* viscosity () const { return visc; }
+	virtual const double* density () const { return dens; }
+	virtual const double* surfaceDensity () const { return dens; }
+	virtual void relperm (const int n, const double* s, const int*,
+	                      double* kr, double* dkrds) const {
+		for (int i = 0; i < n; ++i) {
+			const double sg = (s[i * 2 + gas] - SGR) / (1. - SWR - SGR);
+			kr[i * 2 + gas] = sg < 0. ? 0. : (sg > 1. ? 1. : sg);
+			kr[i * 2 + wat] = 1. - kr[i * 2 + gas];
+			if (dkrds) {
+				for (int j = 0; j < 4; ++j) { dkrds[i * 4 + j] = 0.; }
+			}
+		}
+	}
+	virtual void capPress (const int n, const double*, const int*,
+	                       double* pc, double* dpcds) const {
+		for (int i = 0; i < 2 * n; ++i) { pc[i] = 0.; }
+		if (dpcds) { for (int i = 0; i < 4 * n; ++i) { dpcds[i] = 0.; } }
+	}
+	virtual void satRange (const int n, const int*,
+	                       double* smin, double* smax) const {
+		for (int i = 0; i < n; ++i) {
+			smin[i * 2 + gas] = SGR; smax[i * 2 + gas] = 1. - SWR;
+			smin[i * 2 + wat] = SWR; smax[i * 2 + wat] = 1. - SGR;
+		}
+	}
+	static const double SGR;
+	static const double SWR;
+};
+const double ResidualProps::SGR = 0.1;
+const double ResidualProps::SWR = 0.2;
+
+#endif /* OPM_VERTEQ_TESTS_FIXTURES_HPP_INCLUDED */
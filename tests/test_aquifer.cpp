@@ -0,0 +1,155 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE AquiferTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/aquifer.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+
+#include <cstdlib> // strtod
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
+
+using namespace Opm;
+using namespace std;
+
+/**
+ * Small aquifer with thick layers that vary a lot, so that any mistake
+ * in how the corners are ordered shows up.
+ */
+struct Small : public Aquifer {
+	Small () {
+		shape = DOME;
+		ni = 12;
+		nj = 9;
+		nk = 4;
+		dip = 5.;
+		thickness = 10.;
+		thickness_var = .5;
+		seed = 42;
+	}
+};
+
+BOOST_AUTO_TEST_CASE (rim)
+{
+	Small aq;
+
+	// without a rim, all blocks are in the grid
+	UnstructuredGrid* g = aq.create_grid ();
+	BOOST_CHECK_EQUAL (g->number_of_cells, aq.ni * aq.nj * aq.nk);
+	destroy_grid (g);
+
+	// with a rim, only the columns inside of it are
+	aq.rim = 2;
+	BOOST_CHECK (!aq.active (1, 4));
+	BOOST_CHECK (!aq.active (4, 1));
+	BOOST_CHECK (aq.active (2, 2));
+	BOOST_CHECK (aq.active (aq.ni - 3, aq.nj - 3));
+	BOOST_CHECK (!aq.active (aq.ni - 2, 4));
+	BOOST_CHECK (!aq.active (4, aq.nj - 2));
+	g = aq.create_grid ();
+	BOOST_CHECK_EQUAL (g->number_of_cells,
+	                   (aq.ni - 2 * aq.rim) * (aq.nj - 2 * aq.rim) * aq.nk);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		const int glob = g->global_cell[cell];
+		BOOST_CHECK (aq.active (glob % aq.ni, (glob / aq.ni) % aq.nj));
+	}
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (zcorn)
+{
+	const Small aq;
+
+	// read back the corners from the deck
+	ostringstream os;
+	aq.write_grdecl (os);
+	istringstream is (os.str ());
+	string token;
+	while (is >> token && token != "ZCORN") { }
+	vector <double> zcorn;
+	while (is >> token && token != "/") {
+		zcorn.push_back (strtod (token.c_str (), 0));
+	}
+	BOOST_REQUIRE_EQUAL (zcorn.size (), 8u * aq.ni * aq.nj * aq.nk);
+
+	// the bottom of each block is below its top, at every corner, and
+	// the next layer starts where this one ends
+	for (int k = 0; k < aq.nk; ++k) {
+		for (int j = 0; j < 2 * aq.nj; ++j) {
+			for (int i = 0; i < 2 * aq.ni; ++i) {
+				const int top = ((2 * k + 0) * 2 * aq.nj + j) * 2 * aq.ni + i;
+				const int bot = ((2 * k + 1) * 2 * aq.nj + j) * 2 * aq.ni + i;
+				BOOST_CHECK_GT (zcorn[bot], zcorn[top]);
+				if (k + 1 < aq.nk) {
+					const int next = ((2 * k + 2) * 2 * aq.nj + j) * 2 * aq.ni + i;
+					BOOST_CHECK_CLOSE (zcorn[next], zcorn[bot], 1e-6);
+				}
+			}
+		}
+	}
+
+	// same depths as the pillars are asked for directly
+	BOOST_CHECK_CLOSE (zcorn[0], aq.top (0, 0), 1e-6);
+	const int last = ((2 * aq.nk - 1) * 2 * aq.nj + 2 * aq.nj - 1) * 2 * aq.ni + 2 * aq.ni - 1;
+	BOOST_CHECK_CLOSE (zcorn[last], aq.depth_at (aq.ni, aq.nj, aq.nk), 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE (rock)
+{
+	Small aq;
+	aq.rim = 1;
+	UnstructuredGrid* g = aq.create_grid ();
+
+	// each cell gets the value of its block
+	vector <double> poro, perm;
+	aq.rock (*g, poro, perm);
+	BOOST_REQUIRE_EQUAL (poro.size (), static_cast <size_t> (g->number_of_cells));
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		const int glob = g->global_cell[cell];
+		const int i = glob % aq.ni;
+		const int j = (glob / aq.ni) % aq.nj;
+		const int k = glob / (aq.ni * aq.nj);
+		BOOST_CHECK_EQUAL (poro[cell], aq.poro (i, j, k));
+		BOOST_CHECK_EQUAL (perm[cell * 9 + 0], aq.perm (i, j, k));
+		BOOST_CHECK_EQUAL (perm[cell * 9 + 8], aq.kv_kh * aq.perm (i, j, k));
+	}
+
+	// the same seed gives the same rock, on any number of threads
+	vector <double> poro2, perm2;
+#ifdef _OPENMP
+	const int num_threads = omp_get_max_threads ();
+	omp_set_num_threads (num_threads == 1 ? 3 : 1);
+#endif /* _OPENMP */
+	aq.rock (*g, poro2, perm2);
+#ifdef _OPENMP
+	omp_set_num_threads (num_threads);
+#endif /* _OPENMP */
+	BOOST_CHECK (poro2 == poro);
+	BOOST_CHECK (perm2 == perm);
+
+	// but another seed does not
+	aq.seed = 43;
+	aq.rock (*g, poro2, perm2);
+	BOOST_CHECK (poro2 != poro);
+	BOOST_CHECK (perm2 != perm);
+	destroy_grid (g);
+}
@@ -0,0 +1,221 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE MultigridTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/multigrid.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/verteq/topsurf.hpp>
+
+#include <algorithm> // max, swap, swap_ranges
+#include <cmath>     // fabs, sqrt
+#include <cstring>   // memset
+#include <memory>    // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+/**
+ * Five-point Laplacian on a two-dimensional grid, where the first cell
+ * is pinned to make it non-singular, and with an extra unknown which is
+ * coupled to one of the cells, like a well.
+ */
+struct Poisson {
+	int size;
+	vector <int> ia;
+	vector <int> ja;
+	vector <double> sa;
+
+	Poisson (const UnstructuredGrid& g, int well_cell) {
+		const int ni = g.cartdims[0];
+		const int nj = g.cartdims[1];
+		const int num_cells = g.number_of_cells;
+		size = num_cells + 1;
+
+		// cell at each Cartesian index, if it is in the grid
+		vector <int> cell_at (ni * nj, -1);
+		for (int cell = 0; cell < num_cells; ++cell) {
+			cell_at[g.global_cell[cell]] = cell;
+		}
+
+		ia.push_back (0);
+		for (int cell = 0; cell < num_cells; ++cell) {
+			const int i = g.global_cell[cell] % ni;
+			const int j = g.global_cell[cell] / ni;
+			double diag = (cell == 0) ? 1. : 0.;
+
+			// use a different coefficient in each direction; there is no
+			// coupling to holes in the grid
+			const int w = i > 0      ? cell_at[j * ni + i - 1]   : -1;
+			const int e = i < ni - 1 ? cell_at[j * ni + i + 1]   : -1;
+			const int s = j > 0      ? cell_at[(j - 1) * ni + i] : -1;
+			const int n = j < nj - 1 ? cell_at[(j + 1) * ni + i] : -1;
+			if (w >= 0) { ja.push_back (w); sa.push_back (-1.); diag += 1.; }
+			if (e >= 0) { ja.push_back (e); sa.push_back (-1.); diag += 1.; }
+			if (s >= 0) { ja.push_back (s); sa.push_back (-4.); diag += 4.; }
+			if (n >= 0) { ja.push_back (n); sa.push_back (-4.); diag += 4.; }
+			if (cell == well_cell) {
+				ja.push_back (num_cells); sa.push_back (-2.); diag += 2.;
+			}
+			ja.push_back (cell);
+			sa.push_back (diag);
+			ia.push_back (static_cast <int> (ja.size ()));
+		}
+		ja.push_back (well_cell); sa.push_back (-2.);
+		ja.push_back (num_cells); sa.push_back (3.);
+		ia.push_back (static_cast <int> (ja.size ()));
+	}
+
+	// norm of b - A x
+	double residual (const vector <double>& x, const vector <double>& b) const {
+		double accum = 0.;
+		for (int row = 0; row < size; ++row) {
+			double r = b[row];
+			for (int nz = ia[row]; nz < ia[row + 1]; ++nz) {
+				r -= sa[nz] * x[ja[nz]];
+			}
+			accum += r * r;
+		}
+		return sqrt (accum);
+	}
+
+	// solution by Gaussian elimination with partial pivoting on the dense
+	// matrix, to compare with
+	vector <double> direct (const vector <double>& b) const {
+		vector <double> a (size * size, 0.);
+		for (int row = 0; row < size; ++row) {
+			for (int nz = ia[row]; nz < ia[row + 1]; ++nz) {
+				a[row * size + ja[nz]] += sa[nz];
+			}
+		}
+		vector <double> x (b);
+		for (int k = 0; k < size; ++k) {
+			int piv = k;
+			for (int row = k + 1; row < size; ++row) {
+				if (fabs (a[row * size + k]) > fabs (a[piv * size + k])) {
+					piv = row;
+				}
+			}
+			if (piv != k) {
+				swap_ranges (&a[k * size], &a[(k + 1) * size], &a[piv * size]);
+				swap (x[k], x[piv]);
+			}
+			for (int row = k + 1; row < size; ++row) {
+				const double f = a[row * size + k] / a[k * size + k];
+				if (f != 0.) {
+					for (int col = k; col < size; ++col) {
+						a[row * size + col] -= f * a[k * size + col];
+					}
+					x[row] -= f * x[k];
+				}
+			}
+		}
+		for (int k = size - 1; k >= 0; --k) {
+			for (int col = k + 1; col < size; ++col) {
+				x[k] -= a[k * size + col] * x[col];
+			}
+			x[k] /= a[k * size + k];
+		}
+		return x;
+	}
+};
+
+BOOST_AUTO_TEST_CASE (poisson)
+{
+	// grid which is large enough to get a few levels
+	UnstructuredGrid* g = create_grid_cart3d (37, 23, 1);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const Poisson A (*ts, 100);
+
+	// source in one cell, and a fixed term for the well
+	vector <double> b (A.size, 0.);
+	vector <double> x (A.size, 0.);
+	b[400] = 1.;
+	b[A.size - 1] = 2.;
+
+	parameter::ParameterGroup param;
+	LinearSolverMG solver (*ts, param);
+	solver.setTolerance (1e-10);
+	const LinearSolverInterface::LinearSolverReport rep =
+		solver.solve (A.size, static_cast <int> (A.sa.size ()),
+		              &A.ia[0], &A.ja[0], &A.sa[0], &b[0], &x[0]);
+
+	// residual is relative to the norm of the right-hand side
+	const double norm_b = sqrt (1. * 1. + 2. * 2.);
+	BOOST_REQUIRE (rep.converged);
+	BOOST_REQUIRE_LT (A.residual (x, b), 1e-8 * norm_b);
+
+	// a multigrid preconditioner should not need many iterations
+	BOOST_REQUIRE_LT (rep.iterations, 30);
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (holes)
+{
+	// two-dimensional grid where the corners and a disc in the middle are
+	// cut out of the layout, as for inactive columns; only the fields that
+	// the solver reads are set
+	const int NI = 29;
+	const int NJ = 19;
+	vector <int> global_cell;
+	for (int j = 0; j < NJ; ++j) {
+		for (int i = 0; i < NI; ++i) {
+			const bool corner = i + j < 3 || (NI - 1 - i) + (NJ - 1 - j) < 3;
+			const bool disc = (i - 14) * (i - 14) + (j - 9) * (j - 9) < 16;
+			if (!corner && !disc) {
+				global_cell.push_back (j * NI + i);
+			}
+		}
+	}
+	UnstructuredGrid g;
+	memset (&g, 0, sizeof (g));
+	g.dimensions = 2;
+	g.number_of_cells = static_cast <int> (global_cell.size ());
+	g.global_cell = &global_cell[0];
+	g.cartdims[0] = NI;
+	g.cartdims[1] = NJ;
+	g.cartdims[2] = 1;
+	const Poisson A (g, 200);
+
+	vector <double> b (A.size, 0.);
+	vector <double> x (A.size, 0.);
+	b[300] = 1.;
+	b[A.size - 1] = 2.;
+
+	parameter::ParameterGroup param;
+	LinearSolverMG solver (g, param);
+	solver.setTolerance (1e-12);
+	const LinearSolverInterface::LinearSolverReport rep =
+		solver.solve (A.size, static_cast <int> (A.sa.size ()),
+		              &A.ia[0], &A.ja[0], &A.sa[0], &b[0], &x[0]);
+	BOOST_REQUIRE (rep.converged);
+	BOOST_REQUIRE_LT (rep.iterations, 30);
+
+	// the holes take no part, so the solution is the same as that of a
+	// direct solver on the active cells
+	const vector <double> ref = A.direct (b);
+	double scale = 0.;
+	for (int row = 0; row < A.size; ++row) {
+		scale = max (scale, fabs (ref[row]));
+	}
+	for (int row = 0; row < A.size; ++row) {
+		BOOST_CHECK_SMALL (x[row] - ref[row], 1e-8 * scale);
+	}
+}
@@ -0,0 +1,178 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE PartitionTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/partition.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/verteq/topsurf.hpp>
+
+#include <algorithm> // binary_search, max
+#include <memory>    // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+#if HAVE_MPI
+// the same test program is run both on a single process and with several
+// processes, so MPI must always be initialized
+struct MPIFixture {
+	MPIFixture () {
+		int argc = boost::unit_test::framework::master_test_suite ().argc;
+		char** argv = boost::unit_test::framework::master_test_suite ().argv;
+		MPI_Init (&argc, &argv);
+	}
+	~MPIFixture () {
+		MPI_Finalize ();
+	}
+};
+BOOST_GLOBAL_FIXTURE (MPIFixture);
+#endif /* HAVE_MPI */
+
+/**
+ * Verify that each column is owned by exactly one part, and that the
+ * halo consists of exactly the neighbours owned by someone else.
+ */
+void
+check_lists (const UnstructuredGrid& g, const ColumnPartition& part) {
+	vector <int> count (g.number_of_cells, 0);
+	for (int p = 0; p < part.num_parts (); ++p) {
+		const vector <int>& owned = part.owned (p);
+		const vector <int>& halo = part.halo (p);
+		for (size_t i = 0; i < owned.size (); ++i) {
+			BOOST_REQUIRE_EQUAL (part.owner (owned[i]), p);
+			++count[owned[i]];
+		}
+
+		// find the halo from scratch by looking at the neighbours
+		vector <int> expected;
+		for (int col = 0; col < g.number_of_cells; ++col) {
+			if (part.owner (col) == p) {
+				continue;
+			}
+			for (int pos = g.cell_facepos[col]; pos != g.cell_facepos[col + 1]; ++pos) {
+				const int face = g.cell_faces[pos];
+				const int c0 = g.face_cells[2 * face + 0];
+				const int c1 = g.face_cells[2 * face + 1];
+				if ((c0 >= 0 && part.owner (c0) == p) ||
+				    (c1 >= 0 && part.owner (c1) == p)) {
+					expected.push_back (col);
+					break;
+				}
+			}
+		}
+		BOOST_REQUIRE_EQUAL_COLLECTIONS (halo.begin (), halo.end (),
+		                                 expected.begin (), expected.end ());
+		BOOST_REQUIRE_EQUAL (part.local (p).size (), owned.size () + halo.size ());
+	}
+	for (int col = 0; col < g.number_of_cells; ++col) {
+		BOOST_REQUIRE_EQUAL (count[col], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE (uniform)
+{
+	// every column has the same height, so the number of columns in each
+	// part should be the same when the parts divide the grid evenly
+	UnstructuredGrid* g = create_grid_cart3d (12, 8, 3);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const ColumnPartition part (*ts, 4);
+
+	check_lists (*ts, part);
+	for (int p = 0; p < part.num_parts (); ++p) {
+		BOOST_REQUIRE_EQUAL (part.owned (p).size (), 24u);
+		BOOST_REQUIRE_EQUAL (part.load (p), 24. * 3.);
+	}
+
+	// the parts are compact; a strip of columns would have a halo of
+	// eight or sixteen, whereas a quarter has at most ten
+	for (int p = 0; p < part.num_parts (); ++p) {
+		BOOST_REQUIRE_LE (part.halo (p).size (), 10u);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (weighted)
+{
+	// the columns in the first half are twice as high as the others, so
+	// the parts on that side should get fewer columns
+	UnstructuredGrid* g = create_grid_cart2d (20, 10, 1., 1.);
+	vector <double> height (g->number_of_cells);
+	double total = 0., max_height = 0.;
+	for (int col = 0; col < g->number_of_cells; ++col) {
+		height[col] = (g->cell_centroids[2 * col + 0] < 10.) ? 2. : 1.;
+		total += height[col];
+		max_height = max (max_height, height[col]);
+	}
+	const int num_parts = 3;
+	const ColumnPartition part (*g, &height[0], num_parts);
+
+	check_lists (*g, part);
+
+	// each split is within one column of the target, and there are
+	// at most two splits for each part
+	for (int p = 0; p < num_parts; ++p) {
+		BOOST_REQUIRE_LE (part.load (p), total / num_parts + 2 * max_height);
+		BOOST_REQUIRE_GE (part.load (p), total / num_parts - 2 * max_height);
+	}
+	BOOST_REQUIRE_LT (part.owned (part.owner (0)).size (),
+	                  part.owned (part.owner (g->number_of_cells - 1)).size ());
+
+	destroy_grid (g);
+}
+
+#if HAVE_MPI
+BOOST_AUTO_TEST_CASE (exchange)
+{
+	// partition the grid among all the processes that we are run with
+	int rank, size;
+	MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+	MPI_Comm_size (MPI_COMM_WORLD, &size);
+	UnstructuredGrid* g = create_grid_cart3d (9, 7, 2);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const ColumnPartition part (*ts, size);
+	const HaloExchange halo (part, MPI_COMM_WORLD);
+
+	// only write the values that this process owns, with two values per
+	// column to check the stride
+	const int nc = ts->number_of_cells;
+	vector <double> data (2 * nc, -1.);
+	const vector <int>& owned = part.owned (rank);
+	for (size_t i = 0; i < owned.size (); ++i) {
+		data[2 * owned[i] + 0] = owned[i];
+		data[2 * owned[i] + 1] = rank;
+	}
+	halo.exchange (&data[0], 2);
+
+	// the halo should now have the values from its owners; the rest of
+	// the columns should not have been touched
+	const vector <int>& local = part.local (rank);
+	for (int col = 0; col < nc; ++col) {
+		if (binary_search (local.begin (), local.end (), col)) {
+			BOOST_REQUIRE_EQUAL (data[2 * col + 0], col);
+			BOOST_REQUIRE_EQUAL (data[2 * col + 1], part.owner (col));
+		}
+		else {
+			BOOST_REQUIRE_EQUAL (data[2 * col + 0], -1.);
+		}
+	}
+
+	destroy_grid (g);
+}
+#endif /* HAVE_MPI */
@@ -0,0 +1,83 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE PlumeTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/plume.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+// grid is small enough to enumerate the expected sets by hand
+const int NI = 5;
+const int NJ = 4;
+
+BOOST_AUTO_TEST_CASE (grow)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, NJ, 1., 1.);
+	vector <double> max_sat (NI * NJ, 0.);
+
+	// a single column with CO2 gets its four neighbours as a halo
+	PlumeSet plume (*g, 1);
+	max_sat[1 * NI + 1] = 0.1;
+	plume.reset (&max_sat[0]);
+	const int first[] = { 1, 5, 6, 7, 11 };
+	BOOST_REQUIRE_EQUAL_COLLECTIONS (plume.cols (), plume.cols () + plume.size (),
+	                                 first, first + sizeof (first) / sizeof (int));
+
+	// when it enters the halo, the set grows from there
+	max_sat[1 * NI + 2] = 0.1;
+	plume.update (&max_sat[0]);
+	const int second[] = { 1, 2, 5, 6, 7, 8, 11, 12 };
+	BOOST_REQUIRE_EQUAL_COLLECTIONS (plume.cols (), plume.cols () + plume.size (),
+	                                 second, second + sizeof (second) / sizeof (int));
+
+	BOOST_REQUIRE (!plume.leaked (&max_sat[0], 1, 0));
+
+	// an update only looks at the columns in the set, so CO2 that has
+	// jumped past the halo in a long step is not seen by it
+	max_sat[2 * NI + 2] = max_sat[2 * NI + 3] = max_sat[3 * NI + 3] = 0.1;
+	plume.update (&max_sat[0]);
+	BOOST_REQUIRE (!plume.contains (3 * NI + 3));
+
+	// but it is found next to the set, and then a reset picks it up
+	BOOST_REQUIRE (plume.leaked (&max_sat[0], 1, 0));
+	plume.reset (&max_sat[0]);
+	const int third[] = { 1, 2, 5, 6, 7, 8, 11, 12, 13, 14, 17, 18, 19 };
+	BOOST_REQUIRE_EQUAL_COLLECTIONS (plume.cols (), plume.cols () + plume.size (),
+	                                 third, third + sizeof (third) / sizeof (int));
+	BOOST_REQUIRE (!plume.leaked (&max_sat[0], 1, 0));
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (everything)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, NJ, 1., 1.);
+
+	// without tracking, no column is ever left out
+	PlumeSet plume (*g, -1);
+	BOOST_REQUIRE_EQUAL (plume.size (), NI * NJ);
+	for (int col = 0; col < NI * NJ; ++col) {
+		BOOST_REQUIRE (plume.contains (col));
+	}
+
+	destroy_grid (g);
+}
@@ -0,0 +1,536 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE PropsTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/props.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+#include <opm/verteq/plume.hpp>
+#include <opm/verteq/topsurf.hpp>
+
+// rock and fluid that the tests have in common
+#include "fixtures.hpp"
+
+#include <atomic>
+#include <cstdlib> // malloc, free
+#include <memory>  // unique_ptr
+#include <new>     // bad_alloc
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+// number of allocations done by the entire program; the global operator
+// new is replaced below to count them
+atomic <unsigned long> allocations (0ul);
+
+void*
+operator new (size_t size) {
+	++allocations;
+	void* ptr = malloc (size == 0 ? 1 : size);
+	if (!ptr) {
+		throw bad_alloc ();
+	}
+	return ptr;
+}
+
+void
+operator delete (void* ptr) noexcept {
+	free (ptr);
+}
+
+/**
+ * Fixture with unit values, which makes the expected results easy to
+ * work out by hand.
+ */
+struct UnitProps : public ResidualProps {
+	UnitProps (int num_cells)
+		: ResidualProps (num_cells, GAS, 1., 1., 2., 1., 2.) {
+	}
+};
+
+// a few columns, deep enough that the interfaces are inside them
+const int NI = 4;
+const int NJ = 3;
+const int NK = 10;
+
+/**
+ * Let the porosity and the permeability change down each column, in
+ * layers of two blocks, and from one column to the next, so that every
+ * column has its own tables.
+ */
+void
+layered (ResidualProps& fine, const TopSurf& ts) {
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		for (int pos = ts.col_cellpos[col]; pos != ts.col_cellpos[col + 1]; ++pos) {
+			const int row = pos - ts.col_cellpos[col];
+			const int cell = ts.col_cells[pos];
+			const double k = 1. + 0.1 * (row / 2 % 3) + 0.05 * col;
+			fine.poro[cell] = 0.1 + 0.01 * (row / 2) + 0.002 * col;
+			fine.perm[cell * 9 + 0] = fine.perm[cell * 9 + 4] = k;
+			fine.perm[cell * 9 + 8] = k;
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE (interface_block)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	const double grav[] = { 0., 0., 9.81 };
+	unique_ptr <VertEqProps> props (VertEqProps::create (fine, *ts, grav));
+
+	// CO2 down to the middle of the third block, in the last column, where
+	// the index of each block is far from its row in the column
+	const int col = ts->number_of_cells - 1;
+	const int* ids = &ts->col_cells[ts->col_cellpos[col]];
+	const double max_gas = 1. - ResidualProps::SWR;
+	vector <double> fine_sat (g->number_of_cells * 2);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		fine_sat[cell * 2 + GAS] = 0.;
+		fine_sat[cell * 2 + WAT] = 1.;
+	}
+	const double gas[] = { max_gas, max_gas, 0.5 * max_gas };
+	for (int row = 0; row < 3; ++row) {
+		fine_sat[ids[row] * 2 + GAS] = gas[row];
+		fine_sat[ids[row] * 2 + WAT] = 1. - gas[row];
+	}
+
+	// the interface is placed in the middle of that block, which is then
+	// filled to the same level as it was
+	vector <double> coarse_sat (ts->number_of_cells * 2);
+	props->upscale_saturation (&fine_sat[0], &coarse_sat[0]);
+	props->upd_res_sat (&coarse_sat[0]);
+	vector <double> down_sat (g->number_of_cells * 2);
+	props->downscale_saturation (&coarse_sat[0], &down_sat[0]);
+	for (int row = 0; row < NK; ++row) {
+		BOOST_CHECK_CLOSE (down_sat[ids[row] * 2 + GAS] + 1.,
+		                   fine_sat[ids[row] * 2 + GAS] + 1., 1e-8);
+		BOOST_CHECK_CLOSE (down_sat[ids[row] * 2 + WAT],
+		                   fine_sat[ids[row] * 2 + WAT], 1e-8);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (brine_mobility)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	const double grav[] = { 0., 0., 9.81 };
+	unique_ptr <VertEqProps> props (VertEqProps::create (fine, *ts, grav));
+
+	// the plume has been deeper than it is now, so there is a zone with
+	// residual CO2 under it in every column
+	vector <double> coarse_sat (ts->number_of_cells * 2);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse_sat[col * 2 + GAS] = 0.4;
+		coarse_sat[col * 2 + WAT] = 0.6;
+	}
+	props->upd_res_sat (&coarse_sat[0]);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse_sat[col * 2 + GAS] = 0.1;
+		coarse_sat[col * 2 + WAT] = 0.9;
+	}
+
+	// the brine is fully mobile at the residual CO2 saturation, and the
+	// CO2 is fully mobile at the residual brine saturation, so the rel.perm.
+	// of the brine is what is left over from the plume in every block
+	vector <int> cols (ts->number_of_cells);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		cols[col] = col;
+	}
+	vector <double> kr (ts->number_of_cells * 2);
+	props->relperm (ts->number_of_cells, &coarse_sat[0], &cols[0], &kr[0], 0);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		BOOST_REQUIRE_GT (kr[col * 2 + GAS], 0.);
+		BOOST_CHECK_CLOSE (kr[col * 2 + WAT], 1. - kr[col * 2 + GAS], 1e-8);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (no_allocations)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	layered (fine, *ts);
+	const double grav[] = { 0., 0., 9.81 };
+
+	// search both among the blocks and among the layers; both must end
+	// up with the same state
+	vector <double> by_blocks;
+	for (int compress = 0; compress < 2; ++compress) {
+		unique_ptr <VertEqProps> props (VertEqProps::create (fine, *ts, grav));
+		if (compress) {
+			props->compress_layers ();
+		}
+		PlumeSet plume (*ts, 1);
+
+		// some CO2 under the top in the first columns, and a pressure
+		// which increases downwards
+		vector <double> fine_sat (g->number_of_cells * 2);
+		vector <double> fine_pres (g->number_of_cells);
+		for (int cell = 0; cell < g->number_of_cells; ++cell) {
+			const int col = ts->fine_col[cell];
+			const double sg = (col < NI && cell < 2 * NI * NJ) ? 0.7 : 0.;
+			fine_sat[cell * 2 + GAS] = sg;
+			fine_sat[cell * 2 + WAT] = 1. - sg;
+			fine_pres[cell] = 1. + cell / (NI * NJ);
+		}
+		vector <double> coarse_sat (ts->number_of_cells * 2);
+		vector <double> coarse_pres (ts->number_of_cells);
+
+		// the first round sets up the buffers of each thread
+		props->upscale_saturation (&fine_sat[0], &coarse_sat[0]);
+		props->upd_res_sat (&coarse_sat[0]);
+		plume.reset (props->max_sat ());
+		props->upscale_pressure (&coarse_sat[0], &fine_pres[0], &coarse_pres[0]);
+		props->downscale_saturation (&coarse_sat[0], &fine_sat[0]);
+		props->downscale_pressure (&coarse_sat[0], &coarse_pres[0], &fine_pres[0]);
+		const vector <double> first_sat (fine_sat);
+		const vector <double> first_pres (fine_pres);
+		const vector <double> first_coarse (coarse_sat);
+
+		// after that, notifying the properties and transferring the state
+		// back and forth should only use the buffers that are there already
+		const unsigned long before = allocations;
+		for (int step = 0; step < 3; ++step) {
+			props->upd_res_sat (&coarse_sat[0], plume.size (), plume.cols ());
+			plume.update (props->max_sat ());
+			props->downscale_saturation (&coarse_sat[0], &fine_sat[0]);
+			props->downscale_pressure (&coarse_sat[0], &coarse_pres[0], &fine_pres[0]);
+			props->upscale_saturation (&fine_sat[0], &coarse_sat[0]);
+		}
+		BOOST_REQUIRE_EQUAL (allocations - before, 0ul);
+
+		// the state is the same after the transfers as before them, so
+		// the residual CO2 is still there
+		BOOST_REQUIRE_GT (coarse_sat[0 * 2 + GAS], 0.);
+		for (size_t i = 0; i < coarse_sat.size (); ++i) {
+			BOOST_CHECK_CLOSE (coarse_sat[i] + 1., first_coarse[i] + 1., 1e-8);
+		}
+		for (size_t i = 0; i < fine_sat.size (); ++i) {
+			BOOST_CHECK_CLOSE (fine_sat[i] + 1., first_sat[i] + 1., 1e-8);
+		}
+		for (size_t i = 0; i < fine_pres.size (); ++i) {
+			BOOST_CHECK_CLOSE (fine_pres[i], first_pres[i], 1e-8);
+		}
+		if (!compress) {
+			by_blocks = fine_sat;
+		}
+		for (size_t i = 0; i < fine_sat.size (); ++i) {
+			BOOST_CHECK_CLOSE (fine_sat[i] + 1., by_blocks[i] + 1., 1e-8);
+		}
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (partial_tables)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	layered (fine, *ts);
+	const double grav[] = { 0., 0., 9.81 };
+	unique_ptr <VertEqProps> full (VertEqProps::create (fine, *ts, grav));
+
+	// only the first row of columns is local
+	vector <int> cols (NI);
+	for (int i = 0; i < NI; ++i) {
+		cols[i] = i;
+	}
+	unique_ptr <VertEqProps> part (VertEqProps::create (fine, *ts, grav,
+	                                                    NI, &cols[0]));
+
+	// the other columns have no tables, which is most of the memory
+	BOOST_REQUIRE_LT (part->table_bytes (), full->table_bytes () / 2);
+	BOOST_REQUIRE_EQUAL (part->shared_bytes (), 0u);
+
+	// but the local columns get the same properties as in the full model
+	vector <double> coarse_sat (ts->number_of_cells * 2);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse_sat[col * 2 + GAS] = 0.5;
+		coarse_sat[col * 2 + WAT] = 0.5;
+	}
+	full->upd_res_sat (&coarse_sat[0], NI, &cols[0]);
+	part->upd_res_sat (&coarse_sat[0], NI, &cols[0]);
+	for (int i = 0; i < NI; ++i) {
+		coarse_sat[i * 2 + GAS] = 0.3;
+		coarse_sat[i * 2 + WAT] = 0.7;
+	}
+	vector <double> kr_full (NI * 2), kr_part (NI * 2);
+	full->relperm (NI, &coarse_sat[0], &cols[0], &kr_full[0], 0);
+	part->relperm (NI, &coarse_sat[0], &cols[0], &kr_part[0], 0);
+	BOOST_CHECK_EQUAL_COLLECTIONS (kr_part.begin (), kr_part.end (),
+	                               kr_full.begin (), kr_full.end ());
+	for (int i = 0; i < NI; ++i) {
+		BOOST_CHECK_EQUAL (part->porosity ()[i], full->porosity ()[i]);
+		BOOST_CHECK_EQUAL (part->permeability ()[i * 4], full->permeability ()[i * 4]);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (update_shared)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	const double grav[] = { 0., 0., 9.81 };
+
+	// every column has the same layers, so they all share one table
+	for (int pos = 0; pos < ts->col_cellpos[ts->number_of_cells]; ++pos) {
+		fine.poro[ts->col_cells[pos]] = 0.1 + 0.01 * (pos % NK);
+	}
+	unique_ptr <VertEqProps> props (VertEqProps::create (fine, *ts, grav));
+
+	// change the same block in the owner of the table and in another
+	// column; these two then share a table, and the rest another one
+	const int changed[] = { 0, 5 };
+	vector <int> cells;
+	for (int i = 0; i < 2; ++i) {
+		const int cell = ts->col_cells[ts->col_cellpos[changed[i]] + 3];
+		fine.poro[cell] = 0.3;
+		cells.push_back (cell);
+	}
+	props->update (static_cast <int> (cells.size ()), &cells[0]);
+	unique_ptr <VertEqProps> fresh (VertEqProps::create (fine, *ts, grav));
+	BOOST_REQUIRE_EQUAL (props->table_bytes (), fresh->table_bytes ());
+
+	// the updated properties give the same as ones made from scratch
+	vector <double> coarse_sat (ts->number_of_cells * 2);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse_sat[col * 2 + GAS] = 0.05 * (col % 5 + 1);
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+	props->upd_res_sat (&coarse_sat[0]);
+	fresh->upd_res_sat (&coarse_sat[0]);
+	vector <int> cols (ts->number_of_cells);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		cols[col] = col;
+		coarse_sat[col * 2 + GAS] *= 0.5;
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+	vector <double> kr (ts->number_of_cells * 2), kr_fresh (kr.size ());
+	props->relperm (ts->number_of_cells, &coarse_sat[0], &cols[0], &kr[0], 0);
+	fresh->relperm (ts->number_of_cells, &coarse_sat[0], &cols[0], &kr_fresh[0], 0);
+	BOOST_CHECK_EQUAL_COLLECTIONS (kr.begin (), kr.end (),
+	                               kr_fresh.begin (), kr_fresh.end ());
+	vector <double> fine_sat (g->number_of_cells * 2), fine_fresh (fine_sat.size ());
+	props->downscale_saturation (&coarse_sat[0], &fine_sat[0]);
+	fresh->downscale_saturation (&coarse_sat[0], &fine_fresh[0]);
+	BOOST_CHECK_EQUAL_COLLECTIONS (fine_sat.begin (), fine_sat.end (),
+	                               fine_fresh.begin (), fine_fresh.end ());
+	BOOST_CHECK_EQUAL_COLLECTIONS (props->porosity (), props->porosity () + ts->number_of_cells,
+	                               fresh->porosity (), fresh->porosity () + ts->number_of_cells);
+
+	destroy_grid (g);
+}
+
+/**
+ * Check that properties which have been updated give the same results as
+ * properties created from scratch for the same rock.
+ */
+void
+check_same (VertEqProps& props, VertEqProps& fresh, const TopSurf& ts) {
+	BOOST_CHECK_EQUAL (props.table_bytes (), fresh.table_bytes ());
+	const int num_cols = ts.number_of_cells;
+	vector <double> coarse_sat (num_cols * 2);
+	vector <int> cols (num_cols);
+	for (int col = 0; col < num_cols; ++col) {
+		cols[col] = col;
+		coarse_sat[col * 2 + GAS] = 0.05 * (col % 5 + 1);
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+	props.upd_res_sat (&coarse_sat[0]);
+	fresh.upd_res_sat (&coarse_sat[0]);
+	vector <double> kr (num_cols * 2), kr_fresh (kr.size ());
+	props.relperm (num_cols, &coarse_sat[0], &cols[0], &kr[0], 0);
+	fresh.relperm (num_cols, &coarse_sat[0], &cols[0], &kr_fresh[0], 0);
+	BOOST_CHECK_EQUAL_COLLECTIONS (kr.begin (), kr.end (),
+	                               kr_fresh.begin (), kr_fresh.end ());
+	BOOST_CHECK_EQUAL_COLLECTIONS (props.porosity (), props.porosity () + num_cols,
+	                               fresh.porosity (), fresh.porosity () + num_cols);
+}
+
+BOOST_AUTO_TEST_CASE (update_member)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	UnitProps fine (g->number_of_cells);
+	const double grav[] = { 0., 0., 9.81 };
+	for (int pos = 0; pos < ts->col_cellpos[ts->number_of_cells]; ++pos) {
+		fine.poro[ts->col_cells[pos]] = 0.1 + 0.01 * (pos % NK);
+	}
+	unique_ptr <VertEqProps> props (VertEqProps::create (fine, *ts, grav));
+
+	// a column which shares the table of another gets one of its own
+	// when it is changed, then is changed again in place, and at last
+	// joins the others again when it is changed back
+	const int col = 7;
+	const int cell = ts->col_cells[ts->col_cellpos[col] + 3];
+	const double orig = fine.poro[cell];
+	const double poro[] = { 0.3, 0.35, orig };
+	for (int i = 0; i < 3; ++i) {
+		fine.poro[cell] = poro[i];
+		props->update (1, &cell);
+		unique_ptr <VertEqProps> fresh (VertEqProps::create (fine, *ts, grav));
+		check_same (*props, *fresh, *ts);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (uniform_closed_form)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const double grav[] = { 0., 0., 9.81 };
+
+	// the same rock in every block gives uniform columns without tables
+	UnitProps same (g->number_of_cells);
+	unique_ptr <VertEqProps> uni (VertEqProps::create (same, *ts, grav));
+
+	// every other block has another permeability tensor, but of the same
+	// magnitude, so the rel.perm. weights are the same but the columns
+	// are not uniform and are evaluated from their tables
+	UnitProps split (g->number_of_cells);
+	for (int pos = 0; pos < ts->col_cellpos[ts->number_of_cells]; ++pos) {
+		if (pos % 2) {
+			const int cell = ts->col_cells[pos];
+			split.perm[cell * 9 + 0] = 1.4;
+			split.perm[cell * 9 + 4] = 0.2;
+		}
+	}
+	unique_ptr <VertEqProps> tbl (VertEqProps::create (split, *ts, grav));
+	BOOST_REQUIRE_GT (tbl->table_bytes (), uni->table_bytes ());
+
+	// plumes of different depths, which have been deeper before; none of
+	// the interfaces is in the middle of a block, where the downscaled
+	// pressure flips between the phases on a rounding error
+	vector <double> coarse_sat (ts->number_of_cells * 2);
+	vector <int> cols (ts->number_of_cells);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		cols[col] = col;
+		coarse_sat[col * 2 + GAS] = 0.05 + 0.06 * col;
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+	uni->upd_res_sat (&coarse_sat[0]);
+	tbl->upd_res_sat (&coarse_sat[0]);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse_sat[col * 2 + GAS] *= 1. - 0.3 * (col % 3);
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+
+	// both ways of evaluating give the same properties
+	const int n = ts->number_of_cells;
+	vector <double> kr_uni (n * 2), dkr_uni (n * 4), pc_uni (n * 2), dpc_uni (n * 4);
+	vector <double> kr_tbl (n * 2), dkr_tbl (n * 4), pc_tbl (n * 2), dpc_tbl (n * 4);
+	uni->relperm (n, &coarse_sat[0], &cols[0], &kr_uni[0], &dkr_uni[0]);
+	tbl->relperm (n, &coarse_sat[0], &cols[0], &kr_tbl[0], &dkr_tbl[0]);
+	uni->capPress (n, &coarse_sat[0], &cols[0], &pc_uni[0], &dpc_uni[0]);
+	tbl->capPress (n, &coarse_sat[0], &cols[0], &pc_tbl[0], &dpc_tbl[0]);
+	for (int i = 0; i < n * 2; ++i) {
+		BOOST_CHECK_CLOSE (kr_uni[i] + 1., kr_tbl[i] + 1., 1e-8);
+		BOOST_CHECK_CLOSE (pc_uni[i] + 1., pc_tbl[i] + 1., 1e-8);
+	}
+	for (int i = 0; i < n * 4; ++i) {
+		BOOST_CHECK_CLOSE (dkr_uni[i] + 1., dkr_tbl[i] + 1., 1e-8);
+		BOOST_CHECK_CLOSE (dpc_uni[i] + 1., dpc_tbl[i] + 1., 1e-8);
+	}
+
+	// and put the fluids in the same places in the fine grid
+	const vector <double> coarse_pres (n, 1.);
+	vector <double> sat_uni (g->number_of_cells * 2), sat_tbl (sat_uni.size ());
+	vector <double> pres_uni (g->number_of_cells), pres_tbl (pres_uni.size ());
+	uni->downscale_saturation (&coarse_sat[0], &sat_uni[0]);
+	tbl->downscale_saturation (&coarse_sat[0], &sat_tbl[0]);
+	uni->downscale_pressure (&coarse_sat[0], &coarse_pres[0], &pres_uni[0]);
+	tbl->downscale_pressure (&coarse_sat[0], &coarse_pres[0], &pres_tbl[0]);
+	for (size_t i = 0; i < sat_uni.size (); ++i) {
+		BOOST_CHECK_CLOSE (sat_uni[i] + 1., sat_tbl[i] + 1., 1e-8);
+	}
+	for (size_t i = 0; i < pres_uni.size (); ++i) {
+		BOOST_CHECK_CLOSE (pres_uni[i], pres_tbl[i], 1e-8);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (ensemble)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const double grav[] = { 0., 0., 9.81 };
+
+	// realizations where every column has its own tables, where they all
+	// share one, and something in between
+	UnitProps layers (g->number_of_cells);
+	layered (layers, *ts);
+	UnitProps same (g->number_of_cells);
+	UnitProps some (g->number_of_cells);
+	for (int pos = 0; pos < ts->col_cellpos[ts->number_of_cells]; ++pos) {
+		const int col = pos / NK;
+		some.poro[ts->col_cells[pos]] = 0.1 + 0.01 * (pos % NK) + 0.05 * (col % 2);
+	}
+	vector <const IncompPropertiesInterface*> fine;
+	fine.push_back (&layers);
+	fine.push_back (&same);
+	fine.push_back (&some);
+	vector <VertEqProps*> created = VertEqProps::create (fine, *ts, grav);
+	BOOST_REQUIRE_EQUAL (created.size (), fine.size ());
+
+	// each one is the same as if it had been created by itself
+	const int nc = ts->number_of_cells;
+	vector <int> cols (nc);
+	vector <double> coarse_sat (nc * 2);
+	for (int col = 0; col < nc; ++col) {
+		cols[col] = col;
+		coarse_sat[col * 2 + GAS] = 0.05 * (col % 5 + 1);
+		coarse_sat[col * 2 + WAT] = 1. - coarse_sat[col * 2 + GAS];
+	}
+	for (size_t i = 0; i < fine.size (); ++i) {
+		unique_ptr <VertEqProps> member (created[i]);
+		unique_ptr <VertEqProps> alone (VertEqProps::create (*fine[i], *ts, grav));
+		BOOST_CHECK_EQUAL (member->table_bytes (), alone->table_bytes ());
+		BOOST_CHECK_EQUAL (member->shared_bytes (), alone->shared_bytes ());
+		BOOST_CHECK_EQUAL_COLLECTIONS (member->porosity (), member->porosity () + nc,
+		                               alone->porosity (), alone->porosity () + nc);
+		BOOST_CHECK_EQUAL_COLLECTIONS (member->permeability (), member->permeability () + nc * 4,
+		                               alone->permeability (), alone->permeability () + nc * 4);
+		member->upd_res_sat (&coarse_sat[0]);
+		alone->upd_res_sat (&coarse_sat[0]);
+		vector <double> kr (nc * 2), kr_alone (nc * 2);
+		member->relperm (nc, &coarse_sat[0], &cols[0], &kr[0], 0);
+		alone->relperm (nc, &coarse_sat[0], &cols[0], &kr_alone[0], 0);
+		BOOST_CHECK_EQUAL_COLLECTIONS (kr.begin (), kr.end (),
+		                               kr_alone.begin (), kr_alone.end ());
+		vector <double> fine_sat (g->number_of_cells * 2), fine_alone (fine_sat.size ());
+		member->downscale_saturation (&coarse_sat[0], &fine_sat[0]);
+		alone->downscale_saturation (&coarse_sat[0], &fine_alone[0]);
+		BOOST_CHECK_EQUAL_COLLECTIONS (fine_sat.begin (), fine_sat.end (),
+		                               fine_alone.begin (), fine_alone.end ());
+	}
+
+	destroy_grid (g);
+}
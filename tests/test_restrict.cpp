@@ -0,0 +1,172 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE RestrictTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/restrict.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/upscale.hpp>
+
+#include <memory> // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+// blocks of different heights, so that depth-averaging is not the same
+// as taking the mean of the blocks
+const int NI = 3;
+const int NJ = 2;
+const int NK = 4;
+
+struct LayeredGrid {
+	UnstructuredGrid* g;
+	TopSurf* ts;
+
+	LayeredGrid () {
+		const double x[] = { 0., 1., 2., 3. };
+		const double y[] = { 0., 1., 2. };
+		const double z[] = { 0., 1., 3., 3.5, 6. };
+		g = create_grid_tensor3d (NI, NJ, NK, x, y, z, 0);
+		ts = TopSurf::create (*g);
+	}
+
+	~LayeredGrid () {
+		delete ts;
+		destroy_grid (g);
+	}
+
+	// some value which is different in every block
+	double field (int cell, int fld) const {
+		return 1. + 0.1 * cell + 10. * fld;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE (RestrictTest, LayeredGrid)
+
+BOOST_AUTO_TEST_CASE (apply)
+{
+	const VertEqUpscaler up (*ts);
+	unique_ptr <Restriction> avg (Restriction::depth_avg (*ts));
+	unique_ptr <Restriction> sum (Restriction::sum (*ts));
+
+	// two fields interleaved, as the saturations of two phases
+	const int num_fine = g->number_of_cells;
+	vector <double> fine (num_fine * 2);
+	for (int cell = 0; cell < num_fine; ++cell) {
+		fine[cell * 2 + 0] = field (cell, 0);
+		fine[cell * 2 + 1] = field (cell, 1);
+	}
+
+	// each field restricted by itself is the same as the upscaler gives
+	vector <double> buf (ts->max_vert_res);
+	vector <double> by_avg (ts->number_of_cells), by_sum (ts->number_of_cells);
+	for (int fld = 0; fld < 2; ++fld) {
+		avg->apply (&fine[0], &by_avg[0], 2, fld);
+		sum->apply (&fine[0], &by_sum[0], 2, fld);
+		vector <double> single (num_fine);
+		for (int cell = 0; cell < num_fine; ++cell) {
+			single[cell] = fine[cell * 2 + fld];
+		}
+		for (int col = 0; col < ts->number_of_cells; ++col) {
+			up.gather (col, &buf[0], &fine[0], 2, fld);
+			BOOST_CHECK_CLOSE (by_avg[col], up.dpt_avg (col, &buf[0]), 1e-10);
+			BOOST_CHECK_CLOSE (by_sum[col], up.sum (col, &single[0]), 1e-10);
+		}
+	}
+
+	// and all of them at once give the same as one at a time
+	vector <double> batch (ts->number_of_cells * 2);
+	avg->apply_batch (2, &fine[0], &batch[0]);
+	for (int fld = 0; fld < 2; ++fld) {
+		avg->apply (&fine[0], &by_avg[0], 2, fld);
+		for (int col = 0; col < ts->number_of_cells; ++col) {
+			BOOST_CHECK_CLOSE (batch[col * 2 + fld], by_avg[col], 1e-10);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE (transpose)
+{
+	unique_ptr <Restriction> avg (Restriction::depth_avg (*ts));
+	unique_ptr <Restriction> sum (Restriction::sum (*ts));
+	const rlw_double dz (ts->number_of_cells, ts->col_cellpos, ts->dz);
+	const rlw_int col_cells (ts->number_of_cells, ts->col_cellpos, ts->col_cells);
+
+	vector <double> coarse (ts->number_of_cells);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		coarse[col] = 2. + col;
+	}
+
+	// the transpose of the sum spreads the value of the column, whereas
+	// that of the average scales it with the share of the height
+	vector <double> by_avg (g->number_of_cells), by_sum (g->number_of_cells);
+	avg->apply_trans (&coarse[0], &by_avg[0]);
+	sum->apply_trans (&coarse[0], &by_sum[0]);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			const int cell = col_cells[col][row];
+			BOOST_CHECK_EQUAL (by_sum[cell], coarse[col]);
+			BOOST_CHECK_CLOSE (by_avg[cell],
+			                   coarse[col] * dz[col][row] / ts->h_tot[col], 1e-10);
+		}
+	}
+
+	// it is the adjoint, i.e. <R x, y> = <x, R^T y>
+	vector <double> fine (g->number_of_cells), restricted (ts->number_of_cells);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		fine[cell] = field (cell, 0);
+	}
+	avg->apply (&fine[0], &restricted[0]);
+	double lhs = 0., rhs = 0.;
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		lhs += restricted[col] * coarse[col];
+	}
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		rhs += fine[cell] * by_avg[cell];
+	}
+	BOOST_CHECK_CLOSE (lhs, rhs, 1e-10);
+}
+
+BOOST_AUTO_TEST_CASE (weighted)
+{
+	// with a weight, each block counts with the weight times its height
+	vector <double> weight (g->number_of_cells);
+	vector <double> fine (g->number_of_cells);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		weight[cell] = 0.1 + 0.01 * cell;
+		fine[cell] = field (cell, 0);
+	}
+	unique_ptr <Restriction> R (Restriction::depth_avg (*ts, &weight[0]));
+	vector <double> coarse (ts->number_of_cells);
+	R->apply (&fine[0], &coarse[0]);
+
+	const rlw_double dz (ts->number_of_cells, ts->col_cellpos, ts->dz);
+	const rlw_int col_cells (ts->number_of_cells, ts->col_cellpos, ts->col_cells);
+	for (int col = 0; col < ts->number_of_cells; ++col) {
+		double num = 0., den = 0.;
+		for (int row = 0; row < col_cells.size (col); ++row) {
+			const int cell = col_cells[col][row];
+			num += weight[cell] * dz[col][row] * fine[cell];
+			den += weight[cell] * dz[col][row];
+		}
+		BOOST_CHECK_CLOSE (coarse[col], num / den, 1e-10);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
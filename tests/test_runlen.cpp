@@ -14,6 +14,7 @@
 
 // interface to module we are testing
 #include <opm/verteq/utility/runlen.hpp>
+#include <numeric> // accumulate
 
 #define INVALID -1
 
@@ -115,4 +116,68 @@ BOOST_AUTO_TEST_CASE (deep)
 	}
 }
 
+BOOST_AUTO_TEST_CASE (columns)
+{
+	// iterate through the columns, which know their own index
+	int count = 0;
+	for (Opm::rlw_int::Column c : m.columns ()) {
+		BOOST_REQUIRE_EQUAL (c.index (), count);
+		BOOST_REQUIRE_EQUAL (c.size (), m.size (count));
+		BOOST_REQUIRE_EQUAL (c.begin (), m[count]);
+		BOOST_REQUIRE_EQUAL (c[0], m[count][0]);
+		++count;
+	}
+	BOOST_REQUIRE_EQUAL (count, m.cols ());
+
+	// random access
+	const Opm::rlw_int::ColumnIterator first = m.columns ().begin ();
+	BOOST_REQUIRE_EQUAL (m.columns ().end () - first, 2);
+	BOOST_REQUIRE_EQUAL (first[1].index (), 1);
+	BOOST_REQUIRE_EQUAL ((*(first + 1)).size (), 4);
+}
+
+BOOST_AUTO_TEST_CASE (elements)
+{
+	// flat iteration gives the column and the row of each element
+	const Opm::rlw_int::Range <Opm::rlw_int::ElementIterator> all = m.elements ();
+	BOOST_REQUIRE_EQUAL (all.end () - all.begin (), 7);
+	for (Opm::rlw_int::ElementIterator it = all.begin (); it != all.end (); ++it) {
+		BOOST_REQUIRE_EQUAL (*it, (it.column () + 1) * 10 + (it.row () + 1));
+	}
+
+	// jumping finds the right column, from either direction
+	Opm::rlw_int::ElementIterator it = all.begin () + 4;
+	BOOST_REQUIRE_EQUAL (it.column (), 1);
+	BOOST_REQUIRE_EQUAL (it.row (), 1);
+	it -= 2;
+	BOOST_REQUIRE_EQUAL (it.column (), 0);
+	BOOST_REQUIRE_EQUAL (*it, 13);
+	++it;
+	BOOST_REQUIRE_EQUAL (*it, 21);
+	--it;
+	BOOST_REQUIRE_EQUAL (it.column (), 0);
+
+	// usable with the algorithms of the standard library
+	BOOST_REQUIRE_EQUAL (std::accumulate (all.begin (), all.end (), 0), 126);
+}
+
+BOOST_AUTO_TEST_CASE (empty_columns)
+{
+	// empty columns at the start, in the middle and at the end
+	int pos[] = { 0, 0, 2, 2, 3, 3 };
+	int data[] = { 1, 2, 3 };
+	Opm::rlw_int e (5, pos, data);
+	int cols[] = { 1, 1, 3 };
+	int n = 0;
+	for (Opm::rlw_int::ElementIterator it = e.elements ().begin ();
+	     it != e.elements ().end (); ++it, ++n) {
+		BOOST_REQUIRE_EQUAL (*it, data[n]);
+		BOOST_REQUIRE_EQUAL (it.column (), cols[n]);
+	}
+	BOOST_REQUIRE_EQUAL (n, 3);
+	BOOST_REQUIRE_EQUAL ((e.elements ().begin () + 2).column (), 3);
+	BOOST_REQUIRE_EQUAL ((e.elements ().end () - 1).column (), 3);
+	BOOST_REQUIRE_EQUAL ((e.elements ().end () - 2).column (), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END ()
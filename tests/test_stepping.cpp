@@ -0,0 +1,205 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE SteppingTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/stepping.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/wells.h>
+#include <opm/verteq/verteq.hpp>
+
+// rock and fluid that the tests have in common
+#include "fixtures.hpp"
+
+#include <memory> // unique_ptr
+#include <string>
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+const int NI = 4;
+const int NJ = 3;
+const int NK = 5;
+
+/**
+ * Model of a box without wells, sources or open boundaries, which gets
+ * its steps from a controller.
+ */
+struct Box {
+	UnstructuredGrid* g;
+	ResidualProps fine;
+	Wells* w;
+	vector <double> src;
+	double grav[3];
+	parameter::ParameterGroup param;
+	unique_ptr <VertEq> ve;
+	TwophaseState fine_state;
+	TwophaseState coarse_state;
+
+	Box (int gas = GAS, UnstructuredGrid* grid = 0)
+		: g (grid ? grid : create_grid_cart3d (NI, NJ, NK))
+		, fine (g->number_of_cells, gas)
+		, w (create_wells (2, 0, 0))
+		, src (g->number_of_cells, 0.) {
+		grav[0] = grav[1] = 0.; grav[2] = unit::gravity;
+	}
+
+	~Box () {
+		ve.reset ();
+		destroy_wells (w);
+		destroy_grid (g);
+	}
+
+	// create the model after the parameters have been set; the columns
+	// in the first row have CO2 in their top block
+	void init () {
+		ve = unique_ptr <VertEq> (VertEq::create (
+			"box", param, *g, fine, w, src, 0, grav));
+		fine_state.init (*g, 2);
+		for (int cell = 0; cell < g->number_of_cells; ++cell) {
+			const double s = cell < NI ? 0.5 : 0.;
+			fine_state.saturation ()[cell * 2 + fine.gas] = s;
+			fine_state.saturation ()[cell * 2 + fine.wat] = 1. - s;
+		}
+		coarse_state.init (ve->grid (), 2);
+		ve->upscale (fine_state, coarse_state);
+	}
+
+	// take the steps of a report step, checking that they add up to it
+	vector <double> report_step (StepControl& ctl, double length) {
+		vector <double> steps;
+		ctl.begin (length);
+		double remaining = length;
+		while (remaining > 0. && steps.size () < 1000) {
+			const double step = ctl.next_step (coarse_state, remaining);
+			BOOST_REQUIRE_GT (step, 0.);
+			BOOST_REQUIRE_LE (step, remaining);
+			steps.push_back (step);
+			remaining -= step;
+		}
+		BOOST_REQUIRE_EQUAL (remaining, 0.);
+		return steps;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE (SteppingTest, Box)
+
+BOOST_AUTO_TEST_CASE (growth)
+{
+	param.insertParameter ("verteq_initial_step_days", string ("0.5"));
+	param.insertParameter ("verteq_step_growth", string ("1.5"));
+	param.insertParameter ("verteq_cfl", string ("1e6"));
+	init ();
+	StepControl ctl (*ve, param);
+
+	// the CFL number is so high that only the growth limits the steps
+	const vector <double> steps = report_step (ctl, 30. * unit::day);
+	BOOST_REQUIRE_LE (steps[0], 0.5 * unit::day * (1. + 1e-12));
+	for (size_t i = 1; i < steps.size (); ++i) {
+		BOOST_CHECK_LE (steps[i], 1.5 * steps[i - 1] * (1. + 1e-12));
+	}
+	BOOST_REQUIRE_GT (steps.size (), 1u);
+
+	// the next report step goes on from where the last one ended
+	const vector <double> next = report_step (ctl, 30. * unit::day);
+	BOOST_CHECK_LE (next[0], 1.5 * steps.back () * (1. + 1e-12));
+	BOOST_CHECK_EQUAL (ctl.stats ().report_steps, 2);
+	BOOST_CHECK_EQUAL (ctl.stats ().substeps,
+	                   static_cast <int> (steps.size () + next.size ()));
+}
+
+BOOST_AUTO_TEST_CASE (max_substeps)
+{
+	param.insertParameter ("verteq_initial_step_days", string ("0.01"));
+	param.insertParameter ("verteq_max_substeps", string ("4"));
+	init ();
+	StepControl ctl (*ve, param);
+
+	// the shortest step wins over the growth, so there are never more
+	// steps than allowed
+	const vector <double> steps = report_step (ctl, 10. * unit::day);
+	BOOST_CHECK_LE (steps.size (), 4u);
+	for (size_t i = 0; i < steps.size (); ++i) {
+		BOOST_CHECK_GE (steps[i], 10. * unit::day / 4. * (1. - 1e-12));
+	}
+}
+
+BOOST_AUTO_TEST_CASE (cfl)
+{
+	param.insertParameter ("verteq_initial_step_days", string ("100"));
+	param.insertParameter ("verteq_cfl", string ("0.5"));
+	param.insertParameter ("verteq_max_substeps", string ("1000"));
+	init ();
+	StepControl ctl (*ve, param);
+
+	// the state does not change between the steps here, so all of them
+	// are limited by the same speed; there are enough substeps allowed
+	// that the shortest step does not override it
+	const double speed = ctl.wave_speed (coarse_state);
+	BOOST_REQUIRE_GT (speed, 0.);
+	const vector <double> steps = report_step (ctl, 10. * unit::day);
+	BOOST_REQUIRE_GT (steps.size (), 1u);
+	for (size_t i = 0; i < steps.size (); ++i) {
+		BOOST_CHECK_LE (steps[i] * speed, 0.5 * (1. + 1e-12));
+	}
+	BOOST_CHECK_LE (ctl.stats ().max_cfl, 0.5 * (1. + 1e-12));
+}
+
+BOOST_AUTO_TEST_CASE (swapped)
+{
+	init ();
+	StepControl ctl (*ve, param);
+	Box other (WAT);
+	other.init ();
+	StepControl other_ctl (*other.ve, other.param);
+
+	// the CO2 is found from the densities, so the speed does not depend
+	// on the order of the phases
+	const double speed = ctl.wave_speed (coarse_state);
+	BOOST_REQUIRE_GT (speed, 0.);
+	BOOST_CHECK_CLOSE (other_ctl.wave_speed (other.coarse_state), speed, 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE (ridge)
+{
+	init ();
+	StepControl ctl (*ve, param);
+
+	// a caprock which is highest in the middle; the plane that fits it
+	// is flat, but the slope on each side still drives the CO2
+	const double x[] = { 0., 1., 2., 3., 4. };
+	const double y[] = { 0., 1., 2., 3. };
+	const double z[] = { 0., 1., 2., 3., 4., 5. };
+	vector <double> depthz ((NI + 1) * (NJ + 1));
+	for (int j = 0; j <= NJ; ++j) {
+		for (int i = 0; i <= NI; ++i) {
+			depthz[j * (NI + 1) + i] = 0.1 * (i < 2 ? 2 - i : i - 2);
+		}
+	}
+	Box ridge (GAS, create_grid_tensor3d (NI, NJ, NK, x, y, z, &depthz[0]));
+	ridge.init ();
+	StepControl ridge_ctl (*ridge.ve, ridge.param);
+	BOOST_CHECK_SMALL (ridge.ve->gravity ()[0], 1e-12);
+	BOOST_CHECK_GT (ridge_ctl.wave_speed (ridge.coarse_state),
+	                ctl.wave_speed (coarse_state));
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
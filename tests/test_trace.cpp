@@ -0,0 +1,66 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE TraceTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/utility/trace.hpp>
+
+#include <cstdio> // remove
+#include <fstream>
+#include <iterator> // istreambuf_iterator
+#include <string>
+
+using namespace Opm;
+using namespace std;
+
+string
+contents (const char* file_name) {
+	ifstream is (file_name);
+	return string (istreambuf_iterator <char> (is), istreambuf_iterator <char> ());
+}
+
+BOOST_AUTO_TEST_CASE (shared)
+{
+	const char* const first = "test_trace_first.json";
+	const char* const second = "test_trace_second.json";
+	remove (first);
+	remove (second);
+
+	// the second start joins the trace of the first one, instead of
+	// cutting it off
+	TraceSink::start (first);
+	TraceSink::start (second);
+	{
+		TraceScope scope ("inner");
+	}
+	TraceSink::stop ();
+	BOOST_REQUIRE (TraceSink::enabled ());
+	{
+		TraceScope scope ("outer");
+	}
+
+	// the file is only complete when both have stopped
+	TraceSink::stop ();
+	BOOST_REQUIRE (!TraceSink::enabled ());
+	const string text = contents (first);
+	BOOST_CHECK_NE (text.find ("\"inner\""), string::npos);
+	BOOST_CHECK_NE (text.find ("\"outer\""), string::npos);
+	BOOST_CHECK_EQUAL (text.substr (text.size () - 3), "\n]\n");
+	BOOST_CHECK (!ifstream (second));
+
+	// stopping once more does nothing
+	TraceSink::stop ();
+	BOOST_CHECK_EQUAL (contents (first), text);
+	remove (first);
+}
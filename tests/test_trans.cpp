@@ -0,0 +1,100 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE TransTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/trans.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/verteq/topsurf.hpp>
+
+#include <memory> // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+// two columns next to each other, with three layers of different height
+// and permeability; the second column is twice as permeable
+const int NI = 2;
+const int NK = 3;
+const double DX = 2.;
+const double DY = 1.5;
+const double Z[NK + 1] = { 0., 1., 3., 6. };
+const double K[NK] = { 100., 10., 1. };
+
+// sides of the column, by their tag
+const int LEFT = 0;
+const int RIGHT = 1;
+
+BOOST_AUTO_TEST_CASE (layered)
+{
+	const double x[] = { 0., DX, 2. * DX };
+	const double y[] = { 0., DY };
+	UnstructuredGrid* g = create_grid_tensor3d (NI, 1, NK, x, y, Z, 0);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+
+	// isotropic permeability which varies by layer
+	vector <double> perm (g->number_of_cells * 9, 0.);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		const int i = cell % NI;
+		const int k = cell / NI;
+		const double kk = K[k] * (i + 1);
+		perm[cell * 9 + 0] = perm[cell * 9 + 4] = perm[cell * 9 + 8] = kk;
+	}
+	TopSurfTrans T (*g, *ts, &perm[0]);
+
+	// each side is the sum of the faces of the blocks, A k / (dx/2), per
+	// unit height of the column, which is the same as using the average
+	// of the permeability weighted by the height of the layers
+	double k_avg = 0.;
+	for (int k = 0; k < NK; ++k) {
+		k_avg += K[k] * (Z[k + 1] - Z[k]);
+	}
+	k_avg /= Z[NK];
+	const double shape = DY / (DX / 2.);
+	vector <double> half (NI);
+	for (int col = 0; col < NI; ++col) {
+		half[col] = shape * k_avg * (col + 1);
+		const int pos = ts->cell_facepos[col];
+		BOOST_CHECK_CLOSE (T.htrans[pos + LEFT], half[col], 1e-10);
+		BOOST_CHECK_CLOSE (T.htrans[pos + RIGHT], half[col], 1e-10);
+	}
+
+	// the face between the columns combines them harmonically, whereas the
+	// faces on the boundary only get the half of their column
+	const int inner = ts->cell_faces[ts->cell_facepos[0] + RIGHT];
+	BOOST_REQUIRE_EQUAL (ts->cell_faces[ts->cell_facepos[1] + LEFT], inner);
+	BOOST_CHECK_CLOSE (T.trans[inner], 1. / (1. / half[0] + 1. / half[1]), 1e-10);
+	const int outer = ts->cell_faces[ts->cell_facepos[0] + LEFT];
+	BOOST_CHECK_CLOSE (T.trans[outer], half[0], 1e-10);
+
+	// updating a column gives the same as computing from scratch
+	for (int cell = 0; cell < g->number_of_cells; cell += NI) {
+		perm[cell * 9 + 0] = perm[cell * 9 + 4] *= 3.;
+	}
+	const int first = 0;
+	T.update (*g, *ts, &perm[0], 1, &first);
+	TopSurfTrans fresh (*g, *ts, &perm[0]);
+	for (size_t i = 0; i < T.htrans.size (); ++i) {
+		BOOST_CHECK_CLOSE (T.htrans[i], fresh.htrans[i], 1e-10);
+	}
+	for (size_t i = 0; i < T.trans.size (); ++i) {
+		BOOST_CHECK_CLOSE (T.trans[i], fresh.trans[i], 1e-10);
+	}
+
+	destroy_grid (g);
+}
@@ -0,0 +1,292 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE TransportTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/transport.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/props/BlackoilPhases.hpp>
+#include <opm/core/props/IncompPropertiesInterface.hpp>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/verteq/plume.hpp>
+
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+const int GAS = BlackoilPhases::Liquid;
+const int WAT = BlackoilPhases::Aqua;
+
+/**
+ * Linear relative permeabilities, which is what a VE model with a
+ * sharp interface and no residual saturations gives. The CO2 is the
+ * lighter phase, whichever index it has.
+ */
+struct LinearProps : public IncompPropertiesInterface {
+	int num_cells;
+	int gas;
+	int wat;
+	double visc[2];
+	double dens[2];
+	LinearProps (int num_cells, int gas = GAS)
+		: num_cells (num_cells)
+		, gas (gas)
+		, wat (1 - gas) {
+		visc[gas] = 1.; visc[wat] = 2.;
+		dens[gas] = 1.; dens[wat] = 2.;
+	}
+	virtual int numDimensions () const { return 2; }
+	virtual int numCells () const { return num_cells; }
+	virtual const double* porosity () const { return 0; }
+	virtual const double* permeability () const { return 0; }
+	virtual int numPhases () const { return 2; }
+	virtual const double* viscosity () const { return visc; }
+	virtual const double* density () const { return dens; }
+	virtual const double* surfaceDensity () const { return dens; }
+	virtual void relperm (const int n, const double* s, const int*,
+	                      double* kr, double* dkrds) const {
+		for (int i = 0; i < n; ++i) {
+			kr[i * 2 + gas] = s[i * 2 + gas];
+			kr[i * 2 + wat] = 1. - s[i * 2 + gas];
+			if (dkrds) {
+				dkrds[i * 4 + 2 * gas + gas] =  1.;
+				dkrds[i * 4 + 2 * gas + wat] = -1.;
+				dkrds[i * 4 + 2 * wat + gas] = -1.;
+				dkrds[i * 4 + 2 * wat + wat] =  1.;
+			}
+		}
+	}
+	virtual void capPress (const int n, const double*, const int*,
+	                       double* pc, double* dpcds) const {
+		for (int i = 0; i < 2 * n; ++i) { pc[i] = 0.; }
+		if (dpcds) { for (int i = 0; i < 4 * n; ++i) { dpcds[i] = 0.; } }
+	}
+	virtual void satRange (const int n, const int*,
+	                       double* smin, double* smax) const {
+		for (int i = 0; i < 2 * n; ++i) { smin[i] = 0.; smax[i] = 1.; }
+	}
+};
+
+// a row of cells, so that the expected direction is obvious
+const int NI = 20;
+
+// volume of CO2 in the domain
+double
+gas_volume (const TwophaseState& state, const vector <double>& pv) {
+	double vol = 0.;
+	for (int cell = 0; cell < NI; ++cell) {
+		vol += pv[cell] * state.saturation ()[cell * 2 + GAS];
+	}
+	return vol;
+}
+
+// gravity potential of each face relative to its column, for a caprock
+// at depth z0 and faces halfway between the columns
+vector <double>
+potential (const UnstructuredGrid& g, const vector <double>& z0, double grav) {
+	vector <double> gpot (g.cell_facepos[g.number_of_cells], 0.);
+	for (int cell = 0; cell < g.number_of_cells; ++cell) {
+		for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+			const int face = g.cell_faces[pos];
+			const int other = g.face_cells[2 * face + 0] == cell
+			                ? g.face_cells[2 * face + 1]
+			                : g.face_cells[2 * face + 0];
+			if (other >= 0) {
+				gpot[pos] = grav * 0.5 * (z0[other] - z0[cell]);
+			}
+		}
+	}
+	return gpot;
+}
+
+BOOST_AUTO_TEST_CASE (injection)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, 1, 1., 1.);
+	LinearProps props (NI);
+	const vector <double> trans (g->number_of_faces, 1.);
+	const vector <double> gpot (potential (*g, vector <double> (NI, 0.), 10.));
+	const vector <double> pv (NI, 1.);
+
+	// inject in the first cell and produce from the last one, with the
+	// total flux going from left to right in between
+	const double q = 0.1;
+	vector <double> src (NI, 0.);
+	src[0] = q;
+	src[NI - 1] = -q;
+	TwophaseState state;
+	state.init (*g, 2);
+	for (int cell = 0; cell < NI; ++cell) {
+		state.saturation ()[cell * 2 + GAS] = 0.;
+		state.saturation ()[cell * 2 + WAT] = 1.;
+	}
+	for (int face = 0; face < g->number_of_faces; ++face) {
+		const int c1 = g->face_cells[2 * face + 0];
+		const int c2 = g->face_cells[2 * face + 1];
+		state.faceflux ()[face] = (c1 < 0 || c2 < 0) ? 0. : (c1 < c2 ? q : -q);
+	}
+
+	TransportSolverVE solver (*g, props, &trans[0], &gpot[0]);
+	const double dt = 1.;
+	for (int step = 0; step < 5; ++step) {
+		solver.solve (&pv[0], &src[0], dt, state);
+	}
+
+	// the flow has a single direction, so every cell is solved by itself
+	BOOST_REQUIRE_EQUAL (solver.num_components (), NI);
+	BOOST_REQUIRE_EQUAL (solver.max_component (), 1);
+
+	// (almost) nothing has reached the producer yet, so everything that
+	// was injected is still there, and the front is near the injector
+	BOOST_REQUIRE_CLOSE (gas_volume (state, pv), 5 * q * dt, 1e-4);
+	BOOST_REQUIRE_GT (state.saturation ()[0 * 2 + GAS], state.saturation ()[1 * 2 + GAS]);
+	BOOST_REQUIRE_LT (state.saturation ()[(NI - 1) * 2 + GAS], 1e-6);
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (migration)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, 1, 1., 1.);
+	LinearProps props (NI);
+	const vector <double> trans (g->number_of_faces, 1.);
+	const vector <double> pv (NI, 1.);
+	const vector <double> src (NI, 0.);
+
+	// the caprock slopes upwards to the left, and there is CO2 in the
+	// middle of the domain, but no flow through it
+	vector <double> z0 (NI);
+	for (int cell = 0; cell < NI; ++cell) {
+		z0[cell] = 0.01 * cell;
+	}
+	const vector <double> gpot (potential (*g, z0, 10.));
+	TwophaseState state;
+	state.init (*g, 2);
+	for (int cell = 0; cell < NI; ++cell) {
+		const double s = (cell >= 10 && cell < 13) ? 0.5 : 0.;
+		state.saturation ()[cell * 2 + GAS] = s;
+		state.saturation ()[cell * 2 + WAT] = 1. - s;
+	}
+	for (int face = 0; face < g->number_of_faces; ++face) {
+		state.faceflux ()[face] = 0.;
+	}
+	const double before = gas_volume (state, pv);
+
+	TransportSolverVE solver (*g, props, &trans[0], &gpot[0]);
+	solver.solve (&pv[0], &src[0], 1., state);
+
+	// CO2 goes up-dip and brine down-dip, so there is a component where
+	// the cells depend on each other
+	BOOST_REQUIRE_GT (solver.max_component (), 1);
+
+	// the CO2 is conserved, and has moved to the left
+	BOOST_REQUIRE_CLOSE (gas_volume (state, pv), before, 1e-4);
+	BOOST_REQUIRE_GT (state.saturation ()[9 * 2 + GAS], 0.);
+	BOOST_REQUIRE_EQUAL (state.saturation ()[14 * 2 + GAS], 0.);
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (swapped)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, 1, 1., 1.);
+	const vector <double> trans (g->number_of_faces, 1.);
+	const vector <double> pv (NI, 1.);
+	vector <double> src (NI, 0.);
+	src[NI - 1] = 0.1;
+	vector <double> z0 (NI);
+	for (int cell = 0; cell < NI; ++cell) {
+		z0[cell] = 0.01 * cell;
+	}
+	const vector <double> gpot (potential (*g, z0, 10.));
+
+	// the same migration, with the CO2 first and with the brine first
+	vector <double> gas_sat[2];
+	for (int gas = 0; gas < 2; ++gas) {
+		LinearProps props (NI, gas);
+		TwophaseState state;
+		state.init (*g, 2);
+		for (int cell = 0; cell < NI; ++cell) {
+			const double s = (cell >= 10 && cell < 13) ? 0.5 : 0.;
+			state.saturation ()[cell * 2 + gas] = s;
+			state.saturation ()[cell * 2 + 1 - gas] = 1. - s;
+		}
+		for (int face = 0; face < g->number_of_faces; ++face) {
+			state.faceflux ()[face] = 0.;
+		}
+		TransportSolverVE solver (*g, props, &trans[0], &gpot[0]);
+		for (int step = 0; step < 3; ++step) {
+			solver.solve (&pv[0], &src[0], 1., state);
+		}
+		for (int cell = 0; cell < NI; ++cell) {
+			gas_sat[gas].push_back (state.saturation ()[cell * 2 + gas]);
+		}
+	}
+
+	// the solver finds the CO2 from the densities, so the results are
+	// the same whichever order the phases are in
+	BOOST_REQUIRE_GT (gas_sat[0][9], 0.);
+	for (int cell = 0; cell < NI; ++cell) {
+		BOOST_CHECK_CLOSE (gas_sat[0][cell], gas_sat[1][cell], 1e-10);
+	}
+
+	destroy_grid (g);
+}
+
+BOOST_AUTO_TEST_CASE (plume)
+{
+	UnstructuredGrid* g = create_grid_cart2d (NI, 1, 1., 1.);
+	LinearProps props (NI);
+	const vector <double> trans (g->number_of_faces, 1.);
+	const vector <double> pv (NI, 1.);
+	const vector <double> src (NI, 0.);
+	vector <double> z0 (NI);
+	for (int cell = 0; cell < NI; ++cell) {
+		z0[cell] = 0.01 * cell;
+	}
+	const vector <double> gpot (potential (*g, z0, 10.));
+
+	// the same migration as above, with the search for cells that may
+	// get CO2 starting from all cells, and from the plume only
+	vector <double> max_sat (NI, 0.);
+	TwophaseState state[2];
+	for (int k = 0; k < 2; ++k) {
+		state[k].init (*g, 2);
+		for (int cell = 0; cell < NI; ++cell) {
+			const double s = (cell >= 10 && cell < 13) ? 0.5 : 0.;
+			state[k].saturation ()[cell * 2 + GAS] = s;
+			state[k].saturation ()[cell * 2 + WAT] = 1. - s;
+			max_sat[cell] = s;
+		}
+		for (int face = 0; face < g->number_of_faces; ++face) {
+			state[k].faceflux ()[face] = 0.;
+		}
+	}
+	PlumeSet plume (*g, 1);
+	plume.reset (&max_sat[0]);
+	TransportSolverVE all (*g, props, &trans[0], &gpot[0]);
+	TransportSolverVE some (*g, props, &trans[0], &gpot[0], 1e-9, 30, &plume);
+	all.solve (&pv[0], &src[0], 1., state[0]);
+	some.solve (&pv[0], &src[0], 1., state[1]);
+
+	// the cells that can get CO2 are found from the plume as well, so
+	// the result is the same
+	BOOST_CHECK_EQUAL (some.num_components (), all.num_components ());
+	BOOST_CHECK (state[1].saturation () == state[0].saturation ());
+
+	destroy_grid (g);
+}
@@ -0,0 +1,100 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE UpscaleTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/upscale.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/verteq/topsurf.hpp>
+#include <opm/verteq/utility/runlen.hpp>
+
+#include <memory> // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+// a single column with blocks of different heights; the integrand has a
+// layer of three blocks, one of a single block, and one of four blocks
+// which goes down to the bottom
+const int NK = 8;
+const double Z[NK + 1] = { 0., 1., 3., 4., 4.5, 6., 7., 8.5, 10. };
+const double VAL[NK] = { .3, .3, .3, .1, .2, .2, .2, .2 };
+
+// position of an elevation counted in blocks; the bottom of one block is
+// the same as the top of the next, whichever of the two is returned
+double
+depth (const Elevation& zeta) {
+	return zeta.block () + zeta.fraction ();
+}
+
+BOOST_AUTO_TEST_CASE (layers)
+{
+	const double x[] = { 0., 1. };
+	const double y[] = { 0., 1. };
+	UnstructuredGrid* g = create_grid_tensor3d (1, 1, NK, x, y, Z, 0);
+	unique_ptr <TopSurf> ts (TopSurf::create (*g));
+	const VertEqUpscaler up (*ts);
+	const int col = 0;
+
+	// integrate the property down the column, for every block
+	RunLenData <double> val (ts->number_of_cells, ts->col_cellpos);
+	RunLenData <double> dpt (ts->number_of_cells, ts->col_cellpos);
+	copy (VAL, VAL + NK, val[col]);
+	up.wgt_dpt (col, val[col], dpt);
+
+	// the blocks are merged where the integrand is the same
+	vector <const RunLenView <double>*> props (1, &val);
+	ColumnLayers lyr (*ts, props);
+	const int ends[] = { 3, 4, 8 };
+	BOOST_REQUIRE_EQUAL_COLLECTIONS (lyr.layer_end.begin (), lyr.layer_end.end (),
+	                                 ends, ends + sizeof (ends) / sizeof (int));
+	RunLenData <double> res (ts->number_of_cells, &lyr.col_layerpos[0]);
+	lyr.compress (dpt, res);
+
+	// searching in the layers finds the same elevation as in the blocks,
+	// both inside the layers (e.g. in the middle block of the first) and
+	// on their boundaries, down to the bottom of the column
+	const double bot = dpt[col][NK - 1];
+	const int STEPS = 40;
+	for (int i = 0; i <= STEPS; ++i) {
+		const double target = bot * i / STEPS;
+		const Elevation by_blocks = up.find (col, dpt[col], target);
+		const Elevation by_layers = up.find (col, lyr, res[col], target);
+		BOOST_CHECK_CLOSE (depth (by_layers), depth (by_blocks), 1e-10);
+	}
+	for (int row = 0; row < NK; ++row) {
+		const double target = dpt[col][row];
+		const Elevation by_blocks = up.find (col, dpt[col], target);
+		const Elevation by_layers = up.find (col, lyr, res[col], target);
+		BOOST_CHECK_CLOSE (depth (by_layers), depth (by_blocks), 1e-10);
+	}
+
+	// and evaluating the integral at any elevation gives the same value
+	for (int row = 0; row < NK; ++row) {
+		for (int quarter = 0; quarter < 4; ++quarter) {
+			const Elevation zeta (row, 0.25 * quarter);
+			BOOST_CHECK_CLOSE (up.eval (col, lyr, res, zeta) + 1.,
+			                   up.eval (col, dpt, zeta) + 1., 1e-10);
+		}
+	}
+	BOOST_CHECK_CLOSE (up.eval (col, lyr, res, up.bottom (col)),
+	                   up.eval (col, dpt, up.bottom (col)), 1e-10);
+	BOOST_CHECK_CLOSE (up.eval (col, dpt, up.bottom (col)), bot, 1e-10);
+
+	destroy_grid (g);
+}
@@ -0,0 +1,440 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE VertEqTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/plume.hpp>
+#include <opm/verteq/verteq.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/pressure/flow_bc.h>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/simulator/WellState.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/wells.h>
+
+// rock and fluid that the tests have in common
+#include "fixtures.hpp"
+
+#include <cstdint>    // uint32_t, uint64_t
+#include <cstring>    // memcpy
+#include <exception>
+#include <memory>     // unique_ptr
+#include <sstream>
+#include <string>
+#include <utility>    // pair
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+const int NI = 4;
+const int NJ = 3;
+const int NK = 2;
+
+/**
+ * Upscaled model of a grid that is created by each test, without
+ * sources, and with the boundary conditions that the test adds.
+ */
+struct Model {
+	UnstructuredGrid* g;
+	unique_ptr <ResidualProps> fine;
+	Wells* w;
+	vector <double> src;
+	FlowBoundaryConditions* bc;
+	double grav[3];
+	parameter::ParameterGroup param;
+	unique_ptr <VertEq> ve;
+
+	Model ()
+		: g (0)
+		, w (create_wells (2, 0, 0))
+		, bc (flow_conditions_construct (0)) {
+		grav[0] = grav[1] = 0.; grav[2] = unit::gravity;
+	}
+
+	~Model () {
+		ve.reset ();
+		flow_conditions_destroy (bc);
+		destroy_wells (w);
+		if (g) {
+			destroy_grid (g);
+		}
+	}
+
+	// create a model of this grid, which is adopted
+	void init (UnstructuredGrid* grid) {
+		g = grid;
+		fine.reset (new ResidualProps (g->number_of_cells));
+		src.assign (g->number_of_cells, 0.);
+		ve = unique_ptr <VertEq> (VertEq::create (
+			"model", param, *g, *fine, w, src, bc, grav));
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE (VertEqTest, Model)
+
+BOOST_AUTO_TEST_CASE (dip)
+{
+	// caprock which goes down along x and up along y, with the same
+	// slope at every depth
+	const double DIP_X = 0.05;
+	const double DIP_Y = -0.02;
+	const double x[] = { 0., 10., 20., 30., 40. };
+	const double y[] = { 0., 15., 30., 45. };
+	const double z[] = { 0., 2., 5. };
+	vector <double> depthz ((NI + 1) * (NJ + 1));
+	for (int j = 0; j <= NJ; ++j) {
+		for (int i = 0; i <= NI; ++i) {
+			depthz[j * (NI + 1) + i] = 100. + DIP_X * x[i] + DIP_Y * y[j];
+		}
+	}
+	init (create_grid_tensor3d (NI, NJ, NK, x, y, z, &depthz[0]));
+
+	// the plane fits the caprock exactly, so the gravity along it is
+	// the vertical gravity times the slope
+	const double* gr = ve->gravity ();
+	BOOST_CHECK_CLOSE (gr[0], unit::gravity * DIP_X, 1e-8);
+	BOOST_CHECK_CLOSE (gr[1], unit::gravity * DIP_Y, 1e-8);
+	BOOST_CHECK_EQUAL (gr[2], unit::gravity);
+
+	// and the potential of each face is the gravity times the distance
+	// to it along the slope, whether it is interpolated between columns
+	// or extrapolated on the boundary
+	const UnstructuredGrid& ts = ve->grid ();
+	const vector <double>& pot = ve->gravity_potential ();
+	for (int col = 0; col < ts.number_of_cells; ++col) {
+		for (int pos = ts.cell_facepos[col]; pos != ts.cell_facepos[col + 1]; ++pos) {
+			const int face = ts.cell_faces[pos];
+			const double dx = ts.face_centroids[2 * face + 0] - ts.cell_centroids[2 * col + 0];
+			const double dy = ts.face_centroids[2 * face + 1] - ts.cell_centroids[2 * col + 1];
+			BOOST_CHECK_CLOSE (pot[pos] + 1., gr[0] * dx + gr[1] * dy + 1., 1e-8);
+		}
+	}
+}
+
+// restore a checkpoint into a fresh model of the same grid as m, so that
+// nothing but the stream is carried over
+void
+restore (Model& m, const string& chkpt, TwophaseState& coarse) {
+	unique_ptr <VertEq> other (VertEq::create (
+		"other", m.param, *m.g, *m.fine, m.w, m.src, 0, m.grav));
+	istringstream is (chkpt);
+	other->restore (is, coarse);
+}
+
+BOOST_AUTO_TEST_CASE (checkpoint)
+{
+	init (create_grid_cart3d (NI, NJ, NK));
+	const int nc = NI * NJ;
+
+	// CO2 in the top of every other column
+	TwophaseState fine_state;
+	fine_state.init (*g, 2);
+	for (int col = 0; col < nc; col += 2) {
+		fine_state.saturation ()[col * 2 + GAS] = 0.7;
+		fine_state.saturation ()[col * 2 + WAT] = 0.3;
+	}
+	TwophaseState coarse_state;
+	coarse_state.init (ve->grid (), 2);
+	ve->upscale (fine_state, coarse_state);
+
+	// take a step where the plume has retreated from some of the columns,
+	// so that the maximum saturation is not the current one
+	for (int col = 0; col < nc; ++col) {
+		double* sat = &coarse_state.saturation ()[col * 2];
+		if (col % 4 == 0) {
+			sat[GAS] *= 0.25;
+			sat[WAT] = 1. - sat[GAS];
+		}
+		coarse_state.pressure ()[col] = 1e7 + 1234.5 * col;
+	}
+	for (size_t face = 0; face < coarse_state.faceflux ().size (); ++face) {
+		coarse_state.faceflux ()[face] = 1e-6 * (face % 7);
+	}
+	ve->notify (coarse_state);
+	ostringstream os;
+	ve->checkpoint (coarse_state, os);
+	const string chkpt = os.str ();
+
+	// the restored model has the same state, and its own checkpoint is
+	// the same bit for bit, so the maximum saturation is the same too
+	TwophaseState restored;
+	unique_ptr <VertEq> other (VertEq::create (
+		"other", param, *g, *fine, w, src, 0, grav));
+	istringstream is (chkpt);
+	other->restore (is, restored);
+	BOOST_CHECK (restored.pressure () == coarse_state.pressure ());
+	BOOST_CHECK (restored.saturation () == coarse_state.saturation ());
+	BOOST_CHECK (restored.faceflux () == coarse_state.faceflux ());
+	ostringstream again;
+	other->checkpoint (restored, again);
+	BOOST_CHECK (again.str () == chkpt);
+
+	// the residual CO2 which is left where the plume has been depends on
+	// the maximum saturation, so it must be the same when downscaled
+	TwophaseState fine_orig, fine_rest;
+	fine_orig.init (*g, 2);
+	fine_rest.init (*g, 2);
+	ve->downscale (coarse_state, fine_orig);
+	other->downscale (restored, fine_rest);
+	BOOST_CHECK (fine_rest.saturation () == fine_orig.saturation ());
+	BOOST_CHECK (fine_rest.pressure () == fine_orig.pressure ());
+}
+
+BOOST_AUTO_TEST_CASE (bad_checkpoint)
+{
+	init (create_grid_cart3d (NI, NJ, NK));
+	TwophaseState fine_state;
+	fine_state.init (*g, 2);
+	TwophaseState coarse_state;
+	coarse_state.init (ve->grid (), 2);
+	ve->upscale (fine_state, coarse_state);
+	ostringstream os;
+	ve->checkpoint (coarse_state, os);
+	const string chkpt = os.str ();
+
+	// the header is the magic, the version and the byte order, and then
+	// the length of the first array
+	const size_t VERSION_POS = 8;
+	const size_t LENGTH_POS = 16;
+	TwophaseState restored;
+	BOOST_CHECK_NO_THROW (restore (*this, chkpt, restored));
+
+	string bad_magic = chkpt;
+	bad_magic[0] = 'X';
+	BOOST_CHECK_THROW (restore (*this, bad_magic, restored), std::exception);
+
+	string bad_version = chkpt;
+	const uint32_t version = 99;
+	memcpy (&bad_version[VERSION_POS], &version, sizeof (version));
+	BOOST_CHECK_THROW (restore (*this, bad_version, restored), std::exception);
+
+	string bad_length = chkpt;
+	const uint64_t length = NI * NJ + 1;
+	memcpy (&bad_length[LENGTH_POS], &length, sizeof (length));
+	BOOST_CHECK_THROW (restore (*this, bad_length, restored), std::exception);
+
+	const string truncated = chkpt.substr (0, chkpt.size () - sizeof (double));
+	BOOST_CHECK_THROW (restore (*this, truncated, restored), std::exception);
+
+	// a checkpoint of another grid has arrays of other lengths
+	Model small;
+	small.init (create_grid_cart3d (NI - 1, NJ, NK));
+	BOOST_CHECK_THROW (restore (small, chkpt, restored), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE (plume)
+{
+	init (create_grid_cart3d (NI, NJ, NK));
+	const int nc = NI * NJ;
+
+	// CO2 in the corner column only; its neighbours make up the halo
+	TwophaseState fine_state;
+	fine_state.init (*g, 2);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		const double s = cell == 0 ? 0.7 : 0.;
+		fine_state.saturation ()[cell * 2 + GAS] = s;
+		fine_state.saturation ()[cell * 2 + WAT] = 1. - s;
+	}
+	TwophaseState coarse_state;
+	coarse_state.init (ve->grid (), 2);
+	ve->upscale (fine_state, coarse_state);
+	BOOST_REQUIRE (ve->plume ().contains (1));
+	BOOST_REQUIRE (!ve->plume ().contains (2));
+
+	// a short step takes the CO2 into the halo, and the set grows from
+	// there without looking at the rest of the columns
+	double* sat = &coarse_state.saturation ()[0];
+	sat[1 * 2 + GAS] = 0.1;
+	sat[1 * 2 + WAT] = 0.9;
+	ve->notify (coarse_state);
+	BOOST_CHECK (ve->plume ().contains (2));
+	BOOST_CHECK (!ve->plume ().contains (3));
+
+	// a long step takes it past the halo; this is found at the edge of
+	// the set, and then every column is looked at again
+	for (int col = 2; col < NI; ++col) {
+		sat[col * 2 + GAS] = 0.1;
+		sat[col * 2 + WAT] = 0.9;
+	}
+	ve->notify (coarse_state);
+	for (int col = 0; col < nc; ++col) {
+		BOOST_CHECK_EQUAL (ve->plume ().contains (col), col < 2 * NI);
+	}
+
+	// the downscaled state has CO2 in the columns the set was grown to
+	TwophaseState fine_next;
+	fine_next.init (*g, 2);
+	ve->downscale (coarse_state, fine_next);
+	BOOST_CHECK_GT (fine_next.saturation ()[(NI - 1) * 2 + GAS], 0.);
+}
+
+BOOST_AUTO_TEST_CASE (wells)
+{
+	// two wells which both go through column 5; the first one has two
+	// perforations there and one in column 6, the second has a single
+	// perforation in column 5, and two in column 9 without any index
+	const int nc = NI * NJ;
+	const double comp[] = { 0., 1. };
+	const int cells_a[] = { 5, 6 + nc, 5 + nc };
+	const double wi_a[] = { 1., 4., 2. };
+	const int cells_b[] = { 5 + nc, 9, 9 + nc };
+	const double wi_b[] = { 3., 0., 0. };
+	add_well (INJECTOR, 0., 3, comp, cells_a, wi_a, "A", w);
+	add_well (INJECTOR, 0., 3, comp, cells_b, wi_b, "B", w);
+	init (create_grid_cart3d (NI, NJ, NK));
+
+	// the perforations in each column are merged into one connection per
+	// well, in the order they are first seen, with the sum of the index
+	const Wells* cw = ve->wells ();
+	BOOST_REQUIRE_EQUAL (cw->number_of_wells, 2);
+	const int connpos[] = { 0, 2, 4 };
+	const int conn_cells[] = { 5, 6, 5, 9 };
+	const double conn_wi[] = { 3., 4., 3., 0. };
+	BOOST_CHECK_EQUAL_COLLECTIONS (cw->well_connpos, cw->well_connpos + 3,
+	                               connpos, connpos + 3);
+	BOOST_CHECK_EQUAL_COLLECTIONS (cw->well_cells, cw->well_cells + 4,
+	                               conn_cells, conn_cells + 4);
+	BOOST_CHECK_EQUAL_COLLECTIONS (cw->WI, cw->WI + 4, conn_wi, conn_wi + 4);
+
+	// the wells that were passed are left as they were
+	BOOST_CHECK_EQUAL (w->well_connpos[2], 6);
+	BOOST_CHECK_EQUAL (w->well_cells[1], 6 + nc);
+	BOOST_CHECK_EQUAL (w->WI[1], 4.);
+
+	// rates which are split by the index, or evenly where there is none,
+	// are summed in the connection and then split back the same way
+	TwophaseState fine_state;
+	fine_state.init (*g, 2);
+	TwophaseState coarse_state;
+	coarse_state.init (ve->grid (), 2);
+	ve->upscale (fine_state, coarse_state);
+	WellState fine_wells, coarse_wells, back;
+	fine_wells.init (w, fine_state);
+	back.init (w, fine_state);
+	coarse_wells.init (cw, coarse_state);
+	const double rates[] = { 1e-3, 4e-3, 2e-3, 6e-3, 5e-4, 5e-4 };
+	const double conn_rates[] = { 3e-3, 4e-3, 6e-3, 1e-3 };
+	fine_wells.perfRates ().assign (rates, rates + 6);
+	fine_wells.bhp ()[0] = 2e7;
+	fine_wells.bhp ()[1] = 3e7;
+	ve->upscale_wells (fine_wells, coarse_wells);
+	for (int conn = 0; conn < 4; ++conn) {
+		BOOST_CHECK_CLOSE (coarse_wells.perfRates ()[conn], conn_rates[conn], 1e-10);
+	}
+	ve->downscale_wells (coarse_wells, back);
+	for (int i = 0; i < 6; ++i) {
+		BOOST_CHECK_CLOSE (back.perfRates ()[i], rates[i], 1e-10);
+	}
+	BOOST_CHECK (back.bhp () == fine_wells.bhp ());
+}
+
+// faces of the blocks in a column of a Cartesian grid which have a tag
+vector <int>
+column_faces (const UnstructuredGrid& g, int col, int tag) {
+	const int nc = NI * NJ;
+	vector <int> faces;
+	for (int cell = col; cell < g.number_of_cells; cell += nc) {
+		for (int pos = g.cell_facepos[cell]; pos != g.cell_facepos[cell + 1]; ++pos) {
+			if (g.cell_facetag[pos] == tag) {
+				faces.push_back (g.cell_faces[pos]);
+			}
+		}
+	}
+	return faces;
+}
+
+// the condition on a side of a column in the top surface; a pair of
+// the type and the value, or no-flow if there is none
+pair <FlowBCType, double>
+side_cond (VertEq& ve, int col, int tag) {
+	const UnstructuredGrid& ts = ve.grid ();
+	const int face = ts.cell_faces[ts.cell_facepos[col] + tag];
+	const FlowBoundaryConditions* bc = ve.bcs ();
+	for (size_t i = 0; i < bc->nbc; ++i) {
+		for (size_t j = bc->cond_pos[i]; j != bc->cond_pos[i + 1]; ++j) {
+			if (bc->face[j] == face) {
+				return make_pair (bc->type[i], bc->value[i]);
+			}
+		}
+	}
+	return make_pair (BC_NOFLOW, 0.);
+}
+
+// tags of the sides of the blocks
+const int XMIN = 0;
+const int XMAX = 1;
+const int ZMIN = 4;
+
+BOOST_AUTO_TEST_CASE (bcs)
+{
+	// the layers are of unit height, starting at the surface
+	UnstructuredGrid* grid = create_grid_cart3d (NI, NJ, NK);
+
+	// a flux through the west side of the first two columns, which is
+	// split among them by area, and one through part of the west side of
+	// the third, which is the flux through the whole side
+	const double Q = 1e-3;
+	const double Q_PART = 2e-4;
+	vector <int> west = column_faces (*grid, 0, XMIN);
+	const vector <int> west_next = column_faces (*grid, NI, XMIN);
+	west.insert (west.end (), west_next.begin (), west_next.end ());
+	flow_conditions_append_multi (BC_FLUX_TOTVOL, west.size (), &west[0], Q, bc);
+	const vector <int> west_last = column_faces (*grid, 2 * NI, XMIN);
+	flow_conditions_append (BC_FLUX_TOTVOL, west_last.back (), Q_PART, bc);
+
+	// a pressure on the whole east side of the first column, which is
+	// referred to the top along the gradient of the brine
+	const double P = 2e7;
+	const vector <int> east = column_faces (*grid, NI - 1, XMAX);
+	flow_conditions_append_multi (BC_PRESSURE, east.size (), &east[0], P, bc);
+	init (grid);
+
+	BOOST_CHECK (side_cond (*ve, 0, XMIN) == make_pair (BC_FLUX_TOTVOL, Q / 2.));
+	BOOST_CHECK (side_cond (*ve, NI, XMIN) == make_pair (BC_FLUX_TOTVOL, Q / 2.));
+	BOOST_CHECK (side_cond (*ve, 2 * NI, XMIN) == make_pair (BC_FLUX_TOTVOL, Q_PART));
+	const pair <FlowBCType, double> p = side_cond (*ve, NI - 1, XMAX);
+	BOOST_CHECK_EQUAL (p.first, BC_PRESSURE);
+	const double brine = fine->density ()[WAT];
+	double ref = 0.;
+	for (int k = 0; k < NK; ++k) {
+		ref += P - unit::gravity * brine * (k + 0.5);
+	}
+	BOOST_CHECK_CLOSE (p.second, ref / NK, 1e-10);
+	BOOST_CHECK (side_cond (*ve, 2 * NI - 1, XMAX).first == BC_NOFLOW);
+
+	// a pressure on a part of a side cannot be upscaled
+	{
+		Model m;
+		UnstructuredGrid* part = create_grid_cart3d (NI, NJ, NK);
+		const vector <int> faces = column_faces (*part, NI - 1, XMAX);
+		flow_conditions_append (BC_PRESSURE, faces.front (), P, m.bc);
+		BOOST_CHECK_THROW (m.init (part), std::exception);
+	}
+
+	// and neither can a condition on the top of the column
+	{
+		Model m;
+		UnstructuredGrid* top = create_grid_cart3d (NI, NJ, NK);
+		const vector <int> faces = column_faces (*top, 0, ZMIN);
+		flow_conditions_append (BC_FLUX_TOTVOL, faces.front (), Q, m.bc);
+		BOOST_CHECK_THROW (m.init (top), std::exception);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END ()
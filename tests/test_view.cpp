@@ -0,0 +1,106 @@
+#ifdef HAVE_CONFIG_H
+#  if HAVE_CONFIG_H
+#    include <config.h>
+#  endif
+#endif /* HAVE_CONFIG_H */
+#ifdef HAVE_DYNAMIC_BOOST_TEST
+#  if HAVE_DYNAMIC_BOOST_TEST
+#    define BOOST_TEST_DYN_LINK
+#  endif
+#endif /* HAVE_DYNAMIC_BOOST_TEST */
+
+#define BOOST_TEST_MODULE ViewTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_tools.hpp>
+
+// interface to module we are testing
+#include <opm/verteq/view.hpp>
+
+// utility modules (to setup grid)
+#include <opm/core/grid.h>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/simulator/TwophaseState.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/core/utility/Units.hpp>
+#include <opm/core/wells.h>
+#include <opm/verteq/verteq.hpp>
+
+// rock and fluid that the tests have in common
+#include "fixtures.hpp"
+
+#include <memory> // unique_ptr
+#include <vector>
+
+using namespace Opm;
+using namespace std;
+
+const int NI = 4;
+const int NJ = 3;
+const int NK = 5;
+
+BOOST_AUTO_TEST_CASE (same_as_downscale)
+{
+	UnstructuredGrid* g = create_grid_cart3d (NI, NJ, NK);
+	ResidualProps fine (g->number_of_cells);
+	Wells* w = create_wells (2, 0, 0);
+	const vector <double> src (g->number_of_cells, 0.);
+	const double grav[] = { 0., 0., unit::gravity };
+	parameter::ParameterGroup param;
+	unique_ptr <VertEq> ve (VertEq::create (
+		"view", param, *g, fine, w, src, 0, grav));
+
+	// plume of a different thickness in each column, with some pressure
+	// that varies across the surface
+	const int nc = NI * NJ;
+	TwophaseState fine_state;
+	fine_state.init (*g, 2);
+	for (int col = 0; col < nc; ++col) {
+		for (int k = 0; k < col % NK; ++k) {
+			const int cell = k * nc + col;
+			fine_state.saturation ()[cell * 2 + GAS] = 0.6;
+			fine_state.saturation ()[cell * 2 + WAT] = 0.4;
+		}
+	}
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		fine_state.pressure ()[cell] = 1e7 + 1e3 * (cell % nc);
+	}
+	TwophaseState coarse_state;
+	coarse_state.init (ve->grid (), 2);
+	ve->upscale (fine_state, coarse_state);
+
+	// the view reconstructs the same values as downscaling everything,
+	// whichever order the cells are accessed in
+	VertEqView view (*ve, coarse_state);
+	BOOST_REQUIRE_EQUAL (view.numCells (), g->number_of_cells);
+	BOOST_REQUIRE_EQUAL (view.numPhases (), 2);
+	TwophaseState full;
+	full.init (*g, 2);
+	ve->downscale (coarse_state, full);
+	for (int cell = g->number_of_cells - 1; cell >= 0; --cell) {
+		BOOST_CHECK_CLOSE (view.pressure (cell), full.pressure ()[cell], 1e-10);
+		for (int phase = 0; phase < 2; ++phase) {
+			BOOST_CHECK_CLOSE (view.saturation (cell, phase) + 1.,
+			                   full.saturation ()[cell * 2 + phase] + 1., 1e-10);
+		}
+	}
+
+	// after the coarse state has changed, the view must be invalidated
+	// to pick up the new values
+	for (int col = 0; col < nc; ++col) {
+		coarse_state.pressure ()[col] += 5e4;
+	}
+	ve->notify (coarse_state);
+	view.invalidate ();
+	ve->downscale (coarse_state, full);
+	for (int cell = 0; cell < g->number_of_cells; ++cell) {
+		BOOST_CHECK_CLOSE (view.pressure (cell), full.pressure ()[cell], 1e-10);
+		for (int phase = 0; phase < 2; ++phase) {
+			BOOST_CHECK_CLOSE (view.saturation (cell, phase) + 1.,
+			                   full.saturation ()[cell * 2 + phase] + 1., 1e-10);
+		}
+	}
+
+	ve.reset ();
+	destroy_wells (w);
+	destroy_grid (g);
+}